@@ -0,0 +1,410 @@
+#ifndef DISTILLATION_HPP
+#define DISTILLATION_HPP
+
+/* This file provides the ingredients required to compute correlation functions
+ * using distillation (arXiv:0905.2160). There are three parts:
+ *
+ * - DistillationBasis, which holds the lowest modes of the 3D gauge covariant
+ *   Laplacian on each timeslice;
+ * - Perambulator, which holds the propagator projected onto this basis in a
+ *   compact, contiguous dense format;
+ * - compute_perambulator and meson_correlator, which compute a perambulator
+ *   using a user supplied multiple right-hand side solver and contract it to
+ *   form two-point functions using only small dense matrices.
+ *
+ * The Laplacian is never formed as a matrix. Its low modes are found with
+ * Chebyshev filtered subspace iteration (Zhou et al., J. Comput. Phys. 219
+ * (2006) 172), which only needs the action of the Laplacian on a block of
+ * vectors. A block of num_vecs vectors plus a few guard vectors is repeatedly
+ * multiplied by a Chebyshev polynomial of the operator that damps the upper
+ * part of the spectrum, then orthonormalised and rotated onto the Ritz vectors
+ * of the block. The upper end of the spectrum, which the filter needs, is
+ * estimated with a few steps of Lanczos. A block method is used rather than
+ * Lanczos itself as the Laplacian on smooth gauge fields has highly degenerate
+ * low modes, which a single Krylov sequence can't resolve.
+ *
+ * The solver holds four blocks of N * timeslice_volume by about
+ * 1.25 * num_vecs complex numbers at once, e.g. 3.4 GB for a 48^3 timeslice
+ * with 128 vectors, and each iteration costs
+ * O(num_vecs^2 * N * timeslice_volume) operations besides the applications of
+ * the Laplacian. Small timeslices, where the block would be a sizeable
+ * fraction of the space, are diagonalised densely.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <core/array.hpp>
+#include <core/lattice.hpp>
+#include <core/matrix_array.hpp>
+#include <linear_operators/laplacian.hpp>
+#include <utils/macros.hpp>
+#include <utils/matrices.hpp>
+
+
+namespace pyQCD
+{
+  template <int N, typename T = double>
+  class DistillationBasis
+  {
+  public:
+    typedef typename Laplacian<N, T>::GaugeField GaugeField;
+    typedef typename Laplacian<N, T>::DenseMatrix DenseMatrix;
+    typedef Eigen::Matrix<T, Eigen::Dynamic, 1> RealVector;
+
+    // The eigenvectors are converged until the residual |(-del^2 - lambda) v|
+    // of each is below tolerance times the largest eigenvalue of -del^2
+    DistillationBasis(const GaugeField& links, const unsigned int num_vecs,
+                      const T tolerance = 1.0e-10);
+
+    // Matrix of shape (N * timeslice_volume, num_vecs) whose columns are the
+    // eigenvectors on timeslice t, in order of increasing eigenvalue of -del^2
+    const DenseMatrix& eigenvectors(const unsigned int t) const
+    { return eigenvectors_[t]; }
+    const RealVector& eigenvalues(const unsigned int t) const
+    { return eigenvalues_[t]; }
+
+    unsigned int num_vecs() const { return num_vecs_; }
+    unsigned int num_timeslices() const { return eigenvectors_.size(); }
+    unsigned int timeslice_volume() const { return timeslice_volume_; }
+    const Layout* layout() const { return layout_; }
+
+  private:
+    const Layout* layout_;
+    unsigned int num_vecs_, timeslice_volume_;
+    std::vector<DenseMatrix> eigenvectors_;
+    std::vector<RealVector> eigenvalues_;
+  };
+
+
+  template <typename T = double>
+  class Perambulator
+  {
+  public:
+    typedef Eigen::Matrix<std::complex<T>, Eigen::Dynamic, Eigen::Dynamic>
+      DenseMatrix;
+
+    Perambulator(const unsigned int num_timeslices,
+                 const unsigned int num_spins, const unsigned int num_vecs,
+                 const unsigned int source_timeslice)
+      : num_timeslices_(num_timeslices), num_spins_(num_spins),
+        num_vecs_(num_vecs), source_timeslice_(source_timeslice),
+        data_(num_timeslices * block_size() * block_size())
+    { }
+
+    // The perambulator tau(t, t0) as a (num_spins * num_vecs) square matrix,
+    // with row index alpha * num_vecs + i and column index
+    // beta * num_vecs + j.
+    Eigen::Map<DenseMatrix> operator[](const unsigned int t)
+    {
+      return Eigen::Map<DenseMatrix>(&data_[t * block_size() * block_size()],
+                                     block_size(), block_size());
+    }
+    Eigen::Map<const DenseMatrix> operator[](const unsigned int t) const
+    {
+      return Eigen::Map<const DenseMatrix>(
+        &data_[t * block_size() * block_size()], block_size(), block_size());
+    }
+
+    unsigned int num_timeslices() const { return num_timeslices_; }
+    unsigned int num_spins() const { return num_spins_; }
+    unsigned int num_vecs() const { return num_vecs_; }
+    unsigned int source_timeslice() const { return source_timeslice_; }
+    unsigned int block_size() const { return num_spins_ * num_vecs_; }
+
+  private:
+    unsigned int num_timeslices_, num_spins_, num_vecs_, source_timeslice_;
+    std::vector<std::complex<T> > data_;
+  };
+
+
+  namespace detail
+  {
+    template <typename Block, typename Fn>
+    typename Block::RealScalar spectral_upper_bound(
+      Fn apply, const long dim, const unsigned int num_steps = 20)
+    {
+      // Estimate an upper bound on the spectrum of the Hermitian operator
+      // apply with a few steps of Lanczos: the largest Ritz value plus the
+      // magnitude of the last off-diagonal element of the tridiagonal matrix.
+      typedef typename Block::RealScalar T;
+      typedef Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> RealMatrix;
+
+      const unsigned int max_steps = std::min<long>(num_steps, dim);
+      RealMatrix tridiag = RealMatrix::Zero(max_steps, max_steps);
+      Block v = Block::Random(dim, 1);
+      v /= v.norm();
+      Block v_prev = Block::Zero(dim, 1), w;
+      T beta = 0.0;
+      unsigned int steps = 0;
+
+      while (steps < max_steps) {
+        apply(v, w);
+        const T alpha = std::real(v.col(0).dot(w.col(0)));
+        w -= alpha * v + beta * v_prev;
+        tridiag(steps, steps) = alpha;
+        beta = w.norm();
+        ++steps;
+        if (beta < 1.0e-12 * std::abs(alpha) or steps == max_steps) {
+          break;
+        }
+        tridiag(steps, steps - 1) = tridiag(steps - 1, steps) = beta;
+        v_prev = v;
+        v = w / beta;
+      }
+
+      Eigen::SelfAdjointEigenSolver<RealMatrix> solver(
+        tridiag.topLeftCorner(steps, steps), Eigen::EigenvaluesOnly);
+      return solver.eigenvalues().maxCoeff() + beta;
+    }
+
+
+    template <typename Block, typename Fn, typename T>
+    void chebyshev_filter(Fn apply, Block& x, const unsigned int degree,
+                          const T lowest, const T lower, const T upper)
+    {
+      // Replace x with p(A) x, where p is the Chebyshev polynomial of the given
+      // degree that is bounded on [lower, upper] and grows rapidly below it.
+      // The polynomial is scaled so that p(lowest) = 1 to avoid overflow.
+      const T half_width = (upper - lower) / 2.0;
+      const T centre = (upper + lower) / 2.0;
+      T sigma = half_width / (lowest - centre);
+      const T tau = 2.0 / sigma;
+
+      Block y, y_next;
+      apply(x, y);
+      y = (y - centre * x) * (sigma / half_width);
+      for (unsigned int i = 1; i < degree; ++i) {
+        const T sigma_next = 1.0 / (tau - sigma);
+        apply(y, y_next);
+        y_next = (y_next - centre * y) * (2.0 * sigma_next / half_width)
+          - (sigma * sigma_next) * x;
+        x.swap(y);
+        y.swap(y_next);
+        sigma = sigma_next;
+      }
+      x.swap(y);
+    }
+
+
+    template <typename Block, typename Fn, typename T>
+    void lowest_eigenpairs(
+      Fn apply, const long dim, const long num_vecs, const T tolerance,
+      Eigen::Matrix<std::complex<T>, Eigen::Dynamic, Eigen::Dynamic>& vecs,
+      Eigen::Matrix<T, Eigen::Dynamic, 1>& vals,
+      const unsigned int max_iterations = 1000)
+    {
+      // Compute the num_vecs lowest eigenpairs of the Hermitian operator
+      // apply, which acts on a Block of vectors of length dim (one per
+      // column), in order of increasing eigenvalue. See the comment at the top
+      // of this file.
+      typedef Eigen::Matrix<std::complex<T>, Eigen::Dynamic, Eigen::Dynamic>
+        DenseMatrix;
+      long block_size = std::min(dim, num_vecs + std::max(num_vecs / 4, 8l));
+
+      if (dim <= 2 * block_size) {
+        Block matrix;
+        apply(Block::Identity(dim, dim), matrix);
+        Eigen::SelfAdjointEigenSolver<DenseMatrix> solver(matrix);
+        vecs = solver.eigenvectors().leftCols(num_vecs);
+        vals = solver.eigenvalues().head(num_vecs);
+        return;
+      }
+
+      const T upper = spectral_upper_bound<Block>(apply, dim);
+      Block x = Block::Random(dim, block_size), ax;
+      Eigen::Matrix<T, Eigen::Dynamic, 1> ritz_vals;
+      bool filter = false;
+
+      for (unsigned int iter = 0; iter < max_iterations; ++iter) {
+        if (filter) {
+          // Dampen everything above the top of the current block
+          chebyshev_filter(apply, x, 20, ritz_vals(0),
+                           ritz_vals(block_size - 1), upper);
+        }
+        // Orthonormalise the block and rotate it onto its Ritz vectors
+        const Eigen::HouseholderQR<Block> qr(x);
+        x = qr.householderQ() * Block::Identity(dim, block_size);
+        apply(x, ax);
+        const DenseMatrix projected = x.adjoint() * ax;
+        const Eigen::SelfAdjointEigenSolver<DenseMatrix> solver(
+          0.5 * (projected + projected.adjoint()));
+        x = x * solver.eigenvectors();
+        ax = ax * solver.eigenvectors();
+        ritz_vals = solver.eigenvalues();
+
+        const T max_residual
+          = (ax.leftCols(num_vecs)
+             - x.leftCols(num_vecs) * ritz_vals.head(num_vecs).asDiagonal())
+          .colwise().norm().maxCoeff();
+        if (max_residual <= tolerance * upper) {
+          vecs = x.leftCols(num_vecs);
+          vals = ritz_vals.head(num_vecs);
+          return;
+        }
+
+        // The filter can only separate the wanted vectors from the rest of
+        // the block if there's a gap between them, which a degenerate cluster
+        // straddling the top of the block closes. Add random vectors to the
+        // block until the cluster fits inside it.
+        const T gap = ritz_vals(block_size - 1) - ritz_vals(num_vecs - 1);
+        filter = gap > 1.0e-2 * (ritz_vals(block_size - 1) - ritz_vals(0))
+          or block_size == dim;
+        if (not filter) {
+          const long new_size = std::min(dim, block_size + num_vecs / 2 + 8);
+          x.conservativeResize(dim, new_size);
+          x.rightCols(new_size - block_size)
+            = Block::Random(dim, new_size - block_size);
+          block_size = new_size;
+        }
+      }
+
+      throw std::runtime_error("lowest_eigenpairs: eigenvectors did not "
+                               "converge");
+    }
+  }
+
+
+  template <int N, typename T>
+  DistillationBasis<N, T>::DistillationBasis(const GaugeField& links,
+                                             const unsigned int num_vecs,
+                                             const T tolerance)
+    : layout_(links.layout()), num_vecs_(num_vecs)
+  {
+    Laplacian<N, T> laplacian(links);
+    timeslice_volume_ = laplacian.timeslice_volume();
+    pyQCDassert ((num_vecs <= N * timeslice_volume_),
+                 std::out_of_range("DistillationBasis: num_vecs too large"));
+
+    eigenvectors_.resize(laplacian.num_timeslices());
+    eigenvalues_.resize(laplacian.num_timeslices());
+
+    for (unsigned int t = 0; t < laplacian.num_timeslices(); ++t) {
+      // -del^2 is positive semi-definite, so its low modes are the lowest
+      // eigenvectors.
+      typedef typename Laplacian<N, T>::VectorBlock VectorBlock;
+      auto apply = [&laplacian, t] (const VectorBlock& in, VectorBlock& out) {
+        laplacian.apply(t, in, out);
+        out = -out;
+      };
+      detail::lowest_eigenpairs<VectorBlock>(
+        apply, N * timeslice_volume_, num_vecs, tolerance, eigenvectors_[t],
+        eigenvalues_[t]);
+    }
+  }
+
+
+  template <int N, typename T, typename Fn>
+  Perambulator<T> compute_perambulator(const DistillationBasis<N, T>& basis,
+                                       const unsigned int source_timeslice,
+                                       const unsigned int num_spins,
+                                       Fn solve)
+  {
+    // Compute the perambulator tau(t, t0) = V^dag(t) M^-1(t, t0) V(t0).
+    //
+    // The solve argument should be a callable that accepts a
+    // std::vector<Lattice<MatrixArray<N, 1, T> > > of sources, one for each
+    // spin-eigenvector pair, and returns the solutions in a vector of the same
+    // length. This allows the caller to use a multiple right-hand side solver.
+    typedef MatrixArray<N, 1, T> Spinor;
+    typedef Lattice<Spinor> FermionField;
+    typedef typename Perambulator<T>::DenseMatrix DenseMatrix;
+
+    const Layout& layout = *basis.layout();
+    const unsigned int num_vecs = basis.num_vecs();
+    const unsigned int ts_volume = basis.timeslice_volume();
+
+    const Spinor zero_spinor(num_spins, Eigen::Matrix<std::complex<T>, N, 1>
+      ::Zero());
+    std::vector<FermionField> sources(num_spins * num_vecs,
+                                      FermionField(layout, zero_spinor));
+
+    const DenseMatrix& source_vecs = basis.eigenvectors(source_timeslice);
+    for (unsigned int beta = 0; beta < num_spins; ++beta) {
+      for (unsigned int j = 0; j < num_vecs; ++j) {
+        FermionField& source = sources[beta * num_vecs + j];
+        for (unsigned int s = 0; s < ts_volume; ++s) {
+          const unsigned int site = source_timeslice * ts_volume + s;
+          source[layout.get_array_index(site)][beta]
+            = source_vecs.template block<N, 1>(N * s, j);
+        }
+      }
+    }
+
+    const std::vector<FermionField> solutions = solve(sources);
+    pyQCDassert ((solutions.size() == sources.size()),
+                 std::out_of_range("compute_perambulator: solutions.size()"));
+
+    Perambulator<T> ret(basis.num_timeslices(), num_spins, num_vecs,
+                        source_timeslice);
+    // Gather each solution spin component on each timeslice into a single
+    // dense vector so the projection onto the basis is a single product.
+    Eigen::Matrix<std::complex<T>, Eigen::Dynamic, 1> phi(N * ts_volume);
+
+    for (unsigned int t = 0; t < basis.num_timeslices(); ++t) {
+      const DenseMatrix& sink_vecs = basis.eigenvectors(t);
+      auto tau = ret[t];
+
+      for (unsigned int col = 0; col < solutions.size(); ++col) {
+        for (unsigned int alpha = 0; alpha < num_spins; ++alpha) {
+          for (unsigned int s = 0; s < ts_volume; ++s) {
+            const unsigned int site = t * ts_volume + s;
+            phi.template segment<N>(N * s)
+              = solutions[col][layout.get_array_index(site)][alpha];
+          }
+          tau.block(alpha * num_vecs, col, num_vecs, 1)
+            = sink_vecs.adjoint() * phi;
+        }
+      }
+    }
+
+    return ret;
+  }
+
+
+  template <typename T>
+  Array<std::complex<T> > meson_correlator(const Perambulator<T>& tau,
+                                           const SpinMatrix& gamma_sink,
+                                           const SpinMatrix& gamma_source)
+  {
+    // Compute the local meson two-point function
+    //   C(t) = Tr[Gamma_snk tau(t, t0) Gamma_src gamma5 tau^dag(t, t0) gamma5]
+    // using gamma5 hermiticity to obtain the backward propagator. Only small
+    // (num_spins * num_vecs) square matrices are involved. The result is
+    // indexed by absolute timeslice.
+    typedef typename Perambulator<T>::DenseMatrix DenseMatrix;
+    pyQCDassert ((tau.num_spins() == 4),
+                 std::invalid_argument("meson_correlator: num_spins != 4"));
+
+    const unsigned int num_vecs = tau.num_vecs();
+    auto spin_dilute = [num_vecs] (const SpinMatrix& spin_mat) {
+      // Compute spin_mat (x) identity in distillation space
+      DenseMatrix ret = DenseMatrix::Zero(4 * num_vecs, 4 * num_vecs);
+      for (unsigned int alpha = 0; alpha < 4; ++alpha) {
+        for (unsigned int beta = 0; beta < 4; ++beta) {
+          ret.block(alpha * num_vecs, beta * num_vecs, num_vecs, num_vecs)
+            .diagonal().setConstant(std::complex<T>(spin_mat(alpha, beta)));
+        }
+      }
+      return ret;
+    };
+    const DenseMatrix sink = spin_dilute(gamma_sink);
+    const DenseMatrix source = spin_dilute(gamma_source * gamma5());
+    const DenseMatrix g5 = spin_dilute(gamma5());
+
+    Array<std::complex<T> > ret(tau.num_timeslices(), std::complex<T>(0.0));
+    for (unsigned int t = 0; t < tau.num_timeslices(); ++t) {
+      const DenseMatrix fwd = sink * tau[t];
+      const DenseMatrix bwd = source * tau[t].adjoint() * g5;
+      ret[t] = (fwd * bwd).trace();
+    }
+    return ret;
+  }
+}
+
+#endif
@@ -0,0 +1,324 @@
+#ifndef SU3_HPP
+#define SU3_HPP
+
+/* This file provides kernels for SU(3) matrices that are needed by HMC,
+ * stout smearing and gradient flow:
+ *
+ * - exp_i, which computes exp(iQ) for traceless Hermitian Q using the
+ *   Cayley-Hamilton theorem, exp(iQ) = f0 + f1 Q + f2 Q^2, with the
+ *   coefficients computed in closed form as in Morningstar and Peardon
+ *   (hep-lat/0311018);
+ * - compute_exp_coefficients, which also provides the derivatives of the
+ *   coefficients, b1j = df_j / dc1 and b2j = df_j / dc0, where
+ *   c0 = det(Q) = tr(Q^3) / 3 and c1 = tr(Q^2) / 2, as used in the stout force;
+ * - reunitarize, which restores unitarity using Gram-Schmidt on the rows;
+ * - project_su3, which projects an arbitrary matrix onto SU(3) using the polar
+ *   decomposition, U = M (M^dag M)^(-1/2), followed by removal of the phase of
+ *   the determinant.
+ *
+ * The closed form expressions lose precision as Q -> 0, so for small c1 the
+ * coefficients are instead computed by summing the exponential series, using
+ * Q^3 = c1 Q + c0 to reduce each power of Q.
+ *
+ * Each of the matrix functions can be applied to a single matrix or to any
+ * nested container of 3x3 matrices, e.g. MatrixArray<3, 3>, Lattice<Matrix3cd>
+ * or a gauge field of type Lattice<MatrixArray<3, 3> >, in which case the
+ * result is written to a second container of the same shape. Input and output
+ * may be the same object. For a Lattice the sites are divided between the
+ * threads of the thread pool (see parallel.hpp).
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <stdexcept>
+
+#include <Eigen/Dense>
+
+#include <core/detail/matrix_kernels.hpp>
+#include <core/lattice.hpp>
+#include <utils/macros.hpp>
+#include <utils/parallel.hpp>
+#include <utils/profiling.hpp>
+
+
+namespace pyQCD
+{
+  template <typename T>
+  using SU3Matrix = Eigen::Matrix<std::complex<T>, 3, 3>;
+
+
+  template <typename T = double>
+  struct ExpCoefficients
+  {
+    std::complex<T> f[3];
+    // Only computed if requested
+    std::complex<T> b1[3], b2[3];
+  };
+
+
+  namespace detail
+  {
+    // Below this value of c1 the exponential series is summed instead
+    const double exp_series_threshold = 1.0e-2;
+
+
+    template <typename T>
+    ExpCoefficients<T> exp_coefficients_series(const T c0, const T c1,
+                                               const bool derivatives)
+    {
+      // Write Q^n = a + b Q + c Q^2 and accumulate i^n Q^n / n!, along with the
+      // derivatives of a, b and c with respect to c0 and c1
+      typedef std::complex<T> Complex;
+      ExpCoefficients<T> ret;
+      T coeffs[3] = {1.0, 0.0, 0.0};
+      T d0[3] = {0.0, 0.0, 0.0}, d1[3] = {0.0, 0.0, 0.0};
+      for (unsigned int j = 0; j < 3; ++j) {
+        ret.f[j] = coeffs[j];
+        ret.b1[j] = 0.0;
+        ret.b2[j] = 0.0;
+      }
+
+      Complex factor = 1.0;
+      for (unsigned int n = 1; n < 100; ++n) {
+        const T a = coeffs[0], b = coeffs[1], c = coeffs[2];
+        coeffs[0] = c * c0;
+        coeffs[1] = a + c * c1;
+        coeffs[2] = b;
+        if (derivatives) {
+          const T da0 = d0[0], db0 = d0[1], dc0 = d0[2];
+          d0[0] = c + c0 * dc0;
+          d0[1] = da0 + c1 * dc0;
+          d0[2] = db0;
+          const T da1 = d1[0], db1 = d1[1], dc1 = d1[2];
+          d1[0] = c0 * dc1;
+          d1[1] = da1 + c + c1 * dc1;
+          d1[2] = db1;
+        }
+        factor *= Complex(0.0, 1.0 / n);
+
+        T max_term = 0.0;
+        for (unsigned int j = 0; j < 3; ++j) {
+          ret.f[j] += factor * coeffs[j];
+          max_term = std::max(max_term, std::abs(coeffs[j]));
+          if (derivatives) {
+            ret.b2[j] += factor * d0[j];
+            ret.b1[j] += factor * d1[j];
+            max_term = std::max(max_term, std::abs(d0[j]));
+            max_term = std::max(max_term, std::abs(d1[j]));
+          }
+        }
+        if (n > 3 and std::abs(factor) * max_term
+            < std::numeric_limits<T>::epsilon()) {
+          break;
+        }
+      }
+      return ret;
+    }
+
+
+    template <typename T, typename Fn>
+    void transform_matrices(const SU3Matrix<T>& in, SU3Matrix<T>& out, Fn fn)
+    { out = fn(in); }
+
+
+    // The output is taken by forwarding reference so that the views returned
+    // when indexing a Lattice of Arrays can be passed as output
+    template <typename In, typename Out, typename Fn>
+    void transform_matrices(const In& in, Out&& out, Fn fn)
+    {
+      pyQCDassert((in.size() == out.size()),
+        std::out_of_range("transform_matrices: in.size() != out.size()"));
+      for (unsigned int i = 0; i < in.size(); ++i) {
+        transform_matrices(in[i], out[i], fn);
+      }
+    }
+
+
+    template <typename T, template <typename> class Alloc, typename Fn>
+    void transform_matrices(const Lattice<T, Alloc>& in, Lattice<T, Alloc>& out,
+                            Fn fn)
+    {
+      pyQCDassert((in.size() == out.size()),
+        std::out_of_range("transform_matrices: in.size() != out.size()"));
+      PYQCD_PROFILE_SCOPE("transform_matrices");
+      out.prepare_write();
+      // Each site only reads its own matrices, so in and out may be the same
+      parallel_for(0, in.size(), [&] (const unsigned long i) {
+        transform_matrices(in[i], out[i], fn);
+      }, 64);
+      out.touch();
+    }
+  }
+
+
+  template <typename T>
+  ExpCoefficients<T> compute_exp_coefficients(const SU3Matrix<T>& Q,
+                                              const bool derivatives = false)
+  {
+    typedef std::complex<T> Complex;
+    SU3Matrix<T> Q2;
+    multiply(Q, Q, Q2);
+    // tr(Q^3) without forming Q^3
+    const T c0 = Q.cwiseProduct(Q2.transpose()).sum().real() / 3.0;
+    const T c1 = Q2.trace().real() / 2.0;
+    if (c1 < detail::exp_series_threshold) {
+      return detail::exp_coefficients_series(c0, c1, derivatives);
+    }
+
+    // The expressions below assume c0 >= 0. For c0 < 0 we use the symmetry
+    // f_j(-c0) = (-1)^j f_j(c0)^* and b_ij(-c0) = (-1)^(i+j+1) b_ij(c0)^*
+    const bool negative = c0 < 0.0;
+    const T c0_max = 2.0 * std::pow(c1 / 3.0, 1.5);
+    const T theta = std::acos(std::min(std::abs(c0) / c0_max, T(1.0)));
+    const T u = std::sqrt(c1 / 3.0) * std::cos(theta / 3.0);
+    const T w = std::sqrt(c1) * std::sin(theta / 3.0);
+    const T u2 = u * u, w2 = w * w;
+    const T cos_w = std::cos(w);
+    // xi0(w) = sin(w) / w, using its Taylor series for small w
+    const T xi0 = std::abs(w) < 0.05
+      ? 1.0 - w2 / 6.0 * (1.0 - w2 / 20.0 * (1.0 - w2 / 42.0))
+      : std::sin(w) / w;
+
+    const Complex I(0.0, 1.0);
+    const Complex e2iu = std::polar(T(1.0), 2.0 * u);
+    const Complex emiu = std::polar(T(1.0), -u);
+
+    const Complex h[3] = {
+      (u2 - w2) * e2iu
+        + emiu * (8.0 * u2 * cos_w + 2.0 * I * u * (3.0 * u2 + w2) * xi0),
+      2.0 * u * e2iu - emiu * (2.0 * u * cos_w - I * (3.0 * u2 - w2) * xi0),
+      e2iu - emiu * (cos_w + 3.0 * I * u * xi0)
+    };
+    const T denom = 9.0 * u2 - w2;
+
+    ExpCoefficients<T> ret;
+    for (unsigned int j = 0; j < 3; ++j) {
+      ret.f[j] = h[j] / denom;
+    }
+
+    if (derivatives) {
+      const T xi1 = std::abs(w) < 0.05
+        ? -(1.0 - w2 / 10.0 * (1.0 - w2 / 28.0 * (1.0 - w2 / 54.0))) / 3.0
+        : cos_w / w2 - std::sin(w) / (w2 * w);
+
+      const Complex r1[3] = {
+        2.0 * (u + I * (u2 - w2)) * e2iu
+          + 2.0 * emiu * (4.0 * u * (2.0 - I * u) * cos_w
+          + I * xi0 * (9.0 * u2 + w2 - I * u * (3.0 * u2 + w2))),
+        2.0 * (1.0 + 2.0 * I * u) * e2iu
+          + emiu * (-2.0 * (1.0 - I * u) * cos_w
+          + I * xi0 * (6.0 * u + I * (w2 - 3.0 * u2))),
+        2.0 * I * e2iu + I * emiu * (cos_w - 3.0 * (1.0 - I * u) * xi0)
+      };
+      const Complex r2[3] = {
+        -2.0 * e2iu + 2.0 * I * u * emiu
+          * (cos_w + (1.0 + 4.0 * I * u) * xi0 + 3.0 * u2 * xi1),
+        -I * emiu * (cos_w + (1.0 + 2.0 * I * u) * xi0 - 3.0 * u2 * xi1),
+        emiu * (xi0 - 3.0 * I * u * xi1)
+      };
+
+      const T denom2 = 2.0 * denom * denom;
+      for (unsigned int j = 0; j < 3; ++j) {
+        ret.b1[j] = (2.0 * u * r1[j] + (3.0 * u2 - w2) * r2[j]
+          - 2.0 * (15.0 * u2 + w2) * ret.f[j]) / denom2;
+        ret.b2[j] = (r1[j] - 3.0 * u * r2[j] - 24.0 * u * ret.f[j]) / denom2;
+      }
+    }
+
+    if (negative) {
+      for (unsigned int j = 0; j < 3; ++j) {
+        const T sign = j % 2 == 0 ? 1.0 : -1.0;
+        ret.f[j] = sign * std::conj(ret.f[j]);
+        if (derivatives) {
+          ret.b1[j] = sign * std::conj(ret.b1[j]);
+          ret.b2[j] = -sign * std::conj(ret.b2[j]);
+        }
+      }
+    }
+    return ret;
+  }
+
+
+  template <typename T>
+  SU3Matrix<T> exp_i(const SU3Matrix<T>& Q)
+  {
+    // Compute exp(iQ) for traceless Hermitian Q
+    const ExpCoefficients<T> coeffs = compute_exp_coefficients(Q);
+    SU3Matrix<T> Q2;
+    multiply(Q, Q, Q2);
+    SU3Matrix<T> ret = coeffs.f[1] * Q + coeffs.f[2] * Q2;
+    ret.diagonal().array() += coeffs.f[0];
+    return ret;
+  }
+
+
+  template <typename T>
+  SU3Matrix<T> reunitarize(const SU3Matrix<T>& matrix)
+  {
+    SU3Matrix<T> ret = matrix;
+    MatrixKernel<std::complex<T>, 3, 3>::reunitarize(ret);
+    return ret;
+  }
+
+
+  template <typename T>
+  SU3Matrix<T> project_su3(const SU3Matrix<T>& matrix)
+  {
+    // U = M (M^dag M)^(-1/2), then divide out the cube root of det(U)
+    Eigen::SelfAdjointEigenSolver<SU3Matrix<T> > eigensolver;
+    eigensolver.computeDirect(matrix.adjoint() * matrix);
+    const SU3Matrix<T> inv_sqrt = eigensolver.eigenvectors()
+      * eigensolver.eigenvalues().cwiseSqrt().cwiseInverse().asDiagonal()
+      * eigensolver.eigenvectors().adjoint();
+    SU3Matrix<T> ret;
+    multiply(matrix, inv_sqrt, ret);
+    ret *= std::polar(T(1.0), -std::arg(ret.determinant()) / 3.0);
+    return ret;
+  }
+
+
+  namespace detail
+  {
+    struct ExpI
+    {
+      template <typename T>
+      SU3Matrix<T> operator()(const SU3Matrix<T>& mat) const
+      { return exp_i(mat); }
+    };
+
+
+    struct Reunitarize
+    {
+      template <typename T>
+      SU3Matrix<T> operator()(const SU3Matrix<T>& mat) const
+      { return reunitarize(mat); }
+    };
+
+
+    struct ProjectSU3
+    {
+      template <typename T>
+      SU3Matrix<T> operator()(const SU3Matrix<T>& mat) const
+      { return project_su3(mat); }
+    };
+  }
+
+
+  template <typename Container>
+  void exp_i(const Container& Q, Container& out)
+  { detail::transform_matrices(Q, out, detail::ExpI()); }
+
+
+  template <typename Container>
+  void reunitarize(const Container& matrices, Container& out)
+  { detail::transform_matrices(matrices, out, detail::Reunitarize()); }
+
+
+  template <typename Container>
+  void project_su3(const Container& matrices, Container& out)
+  { detail::transform_matrices(matrices, out, detail::ProjectSU3()); }
+}
+
+#endif
@@ -8,55 +8,72 @@
 
 
 template <typename T, template <typename> class Alloc = std::allocator>
-void profile_for_type(const T& elem, const std::string& type,
-  const int add_flops, const int multiply_flops)
+void profile_for_type(const T& elem, const std::string& type)
 {
-  std::cout << "Profiling for array type " << type << "." << std::endl;
   int n = 100;
   pyQCD::Array<T, Alloc> array1(n, elem);
   decltype(array1) array2(n, elem);
   decltype(array1) array3(n, elem);
   decltype(array1) result(n, elem);
 
-  std::cout << "Profiling f(x, y, z) = x + y + z:" << std::endl;
-  benchmark([&] () {
+  benchmark("f(x, y, z) = x + y + z [" + type + "]", [&] () {
     result = array1 + array2 + array3;
-  }, 2 * add_flops * n, 1000000);
+  }, pyQCD::expression_cost(array1 + array2 + array3));
 
-  std::cout << "Profiling f(x, y) = 5.0 * x + y:" << std::endl;
-  benchmark([&] () {
+  benchmark("f(x, y) = 5.0 * x + y [" + type + "]", [&] () {
     result = 5.0 * array1 + array2;
-  }, 2 * add_flops * n, 1000000);
+  }, pyQCD::expression_cost(5.0 * array1 + array2));
 
-  std::cout << "Profiling f(x, y, z) = x * y + z:" << std::endl;
-  benchmark([&] () {
+  benchmark("f(x, y) = x * y [" + type + "]", [&] () {
+    result = array1 * array2;
+  }, pyQCD::expression_cost(array1 * array2));
+
+  benchmark("f(x, y, z) = x * y + z [" + type + "]", [&] () {
     result = array1 * array2 + array3;
-  }, (add_flops + multiply_flops) * n, 1000000);
-  
-  std::cout << std::endl;
+  }, pyQCD::expression_cost(array1 * array2 + array3));
+}
+
+
+template <typename T>
+void profile_construction(const T& elem, const std::string& type)
+{
+  // Compare constructing the result of an expression directly, where each
+  // element is written once, with zero-filling the result first
+  const int n = 1 << 22;
+  pyQCD::Array<T> array1(n, elem);
+  decltype(array1) array2(n, elem);
+  const long num_bytes = 3 * n * sizeof(T);
+
+  benchmark("f(x, y) = x + y, value-initialised result [" + type + "]", [&] () {
+    decltype(array1) result(n, T());
+    result = array1 + array2;
+  }, 0, num_bytes);
+
+  benchmark("f(x, y) = x + y, constructed result [" + type + "]", [&] () {
+    decltype(array1) result = array1 + array2;
+  }, 0, num_bytes);
+
+  benchmark("f(x, y) = x + y, uninitialised result [" + type + "]", [&] () {
+    decltype(array1) result(n, pyQCD::Uninitialized());
+    result = array1 + array2;
+  }, 0, num_bytes);
 }
 
 
 int main(int argc, char* argv[])
 {
-  profile_for_type(1.0, "double", 2, 2);
-  profile_for_type(std::complex<double>(1.0, 0.0), "std::complex<double>",
-                   4, 12);
+  init_benchmarks(argc, argv);
+  profile_for_type(1.0, "double");
+  profile_for_type(std::complex<double>(1.0, 0.0), "std::complex<double>");
   profile_for_type<Eigen::Matrix2d, Eigen::aligned_allocator>(
-    Eigen::Matrix2d::Random(), "Eigen::Matrix2d",
-    matadd_flops(2, false, 2), matmul_flops(2, false, 2)
-  );
+    Eigen::Matrix2d::Random(), "Eigen::Matrix2d");
   profile_for_type<Eigen::Matrix4d, Eigen::aligned_allocator>(
-    Eigen::Matrix4d::Random(), "Eigen::Matrix4d",
-    matadd_flops(4, false, 2), matmul_flops(4, false, 2)
-  );
+    Eigen::Matrix4d::Random(), "Eigen::Matrix4d");
   profile_for_type<Eigen::Matrix2cd, Eigen::aligned_allocator>(
-    Eigen::Matrix2cd::Random(), "Eigen::Matrix2cd",
-    matadd_flops(2, true, 2), matmul_flops(2, true, 2)
-  );
+    Eigen::Matrix2cd::Random(), "Eigen::Matrix2cd");
   profile_for_type<Eigen::Matrix3cd, Eigen::aligned_allocator>(
-    Eigen::Matrix3cd::Random(), "Eigen::Matrix3cd",
-    matadd_flops(3, true, 2), matmul_flops(3, true, 2)
-  );
-  return 0;
+    Eigen::Matrix3cd::Random(), "Eigen::Matrix3cd");
+  profile_construction(1.0, "double");
+  profile_construction(std::complex<double>(1.0, 0.0), "std::complex<double>");
+  return finish_benchmarks();
 }
@@ -0,0 +1,51 @@
+/* Benchmark for runtime CPU dispatch, comparing the evaluation of array
+ * expressions compiled for each instruction set the CPU supports. */
+
+#include <Eigen/Dense>
+
+#include "helpers.hpp"
+
+#include <core/array.hpp>
+#include <utils/cpu_dispatch.hpp>
+
+
+typedef Eigen::Matrix3cd SU3Matrix;
+typedef pyQCD::Array<SU3Matrix, Eigen::aligned_allocator> MatrixArray;
+
+
+int main(int argc, char* argv[])
+{
+  init_benchmarks(argc, argv);
+  const unsigned int size = 100000;
+  MatrixArray a(size, SU3Matrix::Zero()), b(a), c(a), r(a);
+  for (unsigned int i = 0; i < size; ++i) {
+    a[i] = SU3Matrix::Random();
+    b[i] = SU3Matrix::Random();
+    c[i] = SU3Matrix::Random();
+  }
+
+  std::cout << "Detected instruction set: "
+            << pyQCD::simd_level_name(pyQCD::detected_simd_level())
+            << std::endl;
+
+  for (auto level : {pyQCD::SimdLevel::generic, pyQCD::SimdLevel::avx2,
+                     pyQCD::SimdLevel::avx512}) {
+    if (static_cast<int>(level)
+        > static_cast<int>(pyQCD::detected_simd_level())) {
+      break;
+    }
+    const std::string name = pyQCD::simd_level_name(level);
+    benchmark("r = a * b + c [" + name + "]", [&] () {
+      pyQCD::dispatch(level, [&] () {
+        pyQCD::assign_elements(&r[0], a * b + c, 0, size);
+      });
+    }, pyQCD::expression_cost(a * b + c));
+
+    benchmark("r = 5.0 * a + b [" + name + "]", [&] () {
+      pyQCD::dispatch(level, [&] () {
+        pyQCD::assign_elements(&r[0], 5.0 * a + b, 0, size);
+      });
+    }, pyQCD::expression_cost(5.0 * a + b));
+  }
+  return finish_benchmarks();
+}
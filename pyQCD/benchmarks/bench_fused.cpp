@@ -0,0 +1,54 @@
+/* Benchmark for fused evaluation, comparing the vector updates of a conjugate
+ * gradient iteration evaluated one statement at a time with the same updates
+ * evaluated in a single sweep. */
+
+#include <Eigen/Dense>
+
+#include "helpers.hpp"
+
+#include <core/fused.hpp>
+#include <core/lattice.hpp>
+
+
+typedef Eigen::Vector3cd ColourVector;
+typedef pyQCD::Lattice<ColourVector, Eigen::aligned_allocator> Field;
+
+
+int main(int argc, char* argv[])
+{
+  init_benchmarks(argc, argv);
+  pyQCD::LexicoLayout layout(std::vector<unsigned int>{24, 24, 24, 24});
+  Field x(layout), r(layout), p(layout), Ap(layout);
+  for (unsigned int i = 0; i < layout.volume(); ++i) {
+    x[i] = ColourVector::Random();
+    r[i] = ColourVector::Random();
+    p[i] = ColourVector::Random();
+    Ap[i] = ColourVector::Random();
+  }
+  // alpha is real in CG on a Hermitian operator. It's small to keep the values
+  // bounded over the trials.
+  const double alpha = 1.0e-6;
+
+  const unsigned int volume = layout.volume();
+  // Two real axpys and a squared norm per site
+  const long flops = volume * (2 * 3 * 4 + 3 * 4);
+  const long size = volume * sizeof(ColourVector);
+
+  double rr = 0.0;
+  benchmark("separate assignments", [&] () {
+    x = x + alpha * p;
+    r = r - alpha * Ap;
+    rr = 0.0;
+    for (auto& vec : r) {
+      rr += vec.squaredNorm();
+    }
+  }, flops, 7 * size);
+
+  benchmark("fused assignments", [&] () {
+    rr = pyQCD::fused_sum(
+      [&] (const unsigned long i) { return r[i].squaredNorm(); },
+      pyQCD::output(x) += alpha * p, pyQCD::output(r) -= alpha * Ap);
+  }, flops, 6 * size);
+  std::cout << "(" << rr << ")" << std::endl;
+  return finish_benchmarks();
+}
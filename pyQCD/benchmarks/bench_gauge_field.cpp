@@ -0,0 +1,126 @@
+/* Benchmark for full, compressed and double-stored gauge field storage.
+ *
+ * The full and compressed fields are compared on gauge action kernels, which
+ * only read forward links. The double-stored field is compared with the full
+ * field on the backward hop sum_mu U_mu^dag(x - mu) psi(x - mu), which is the
+ * part of a hopping term that it's designed to speed up.
+ */
+
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "helpers.hpp"
+
+#include <core/compressed_gauge_field.hpp>
+#include <core/double_stored_gauge_field.hpp>
+#include <gauge_actions/wilson_action.hpp>
+
+
+typedef pyQCD::MatrixArray<3, 3> GaugeLinks;
+typedef pyQCD::Lattice<GaugeLinks> GaugeField;
+
+
+template <typename Links>
+void profile_for_links(const Links& links,
+                       const pyQCD::WilsonGaugeAction<3>& action,
+                       const std::string& type, const long link_bytes)
+{
+  const long num_links = links.size() * 4;
+  // Each link is read from memory at least once per sweep
+  const long sweep_bytes = num_links * link_bytes;
+  const long matmul_flops
+    = Multiplies::flops<Eigen::Matrix3cd, Eigen::Matrix3cd>();
+  // Six plaquettes per site, each costing three matrix products and a trace
+  const long plaquette_flops = links.size() * 6 * (3 * matmul_flops + 6);
+
+  double plaquette = 0.0;
+  benchmark("average plaquette [" + type + "]", [&] () {
+    plaquette += action.average_plaquette(links);
+  }, plaquette_flops, sweep_bytes);
+
+  Eigen::Matrix3cd total = Eigen::Matrix3cd::Zero();
+  benchmark("staple sweep [" + type + "]", [&] () {
+    for (unsigned int i = 0; i < links.size(); ++i) {
+      for (unsigned int mu = 0; mu < 4; ++mu) {
+        total += action.compute_staples(links, i, mu);
+      }
+    }
+  }, num_links * 6 * 2 * matmul_flops, sweep_bytes);
+
+  // Prevent the results being optimised away
+  std::cout << "(" << plaquette << ", " << total.norm() << ")" << std::endl;
+}
+
+
+void profile_backward_hop(const GaugeField& links,
+                          const pyQCD::DoubleStoredGaugeField<3>& double_stored)
+{
+  typedef std::vector<Eigen::Vector3cd,
+                      Eigen::aligned_allocator<Eigen::Vector3cd> > Field;
+  const pyQCD::Layout& layout = *links.layout();
+  const unsigned int volume = links.volume();
+  Field psi(volume), out(volume);
+  for (auto& elem : psi) {
+    elem = Eigen::Vector3cd::Random();
+  }
+
+  // Per site and direction: a 3x3 by 3x1 product and the accumulation
+  const long hop_flops = volume * 4 * (9 * 6 + 6 * 2 + 3 * 2);
+  // Per site and direction: a link, a neighbouring vector and its index,
+  // plus the result written once per site
+  const long hop_bytes = volume * (4 * (sizeof(Eigen::Matrix3cd)
+    + sizeof(Eigen::Vector3cd) + sizeof(unsigned int))
+    + sizeof(Eigen::Vector3cd));
+
+  benchmark("backward hop [Lattice<MatrixArray<3, 3> >]", [&] () {
+    for (unsigned int site = 0; site < volume; ++site) {
+      Eigen::Vector3cd result = Eigen::Vector3cd::Zero();
+      for (unsigned int mu = 0; mu < 4; ++mu) {
+        const unsigned int bwd = layout.get_array_index(
+          layout.compute_neighbour_index(site, mu, -1));
+        result.noalias() += links[bwd][mu].adjoint() * psi[bwd];
+      }
+      out[layout.get_array_index(site)] = result;
+    }
+  }, hop_flops, hop_bytes);
+
+  benchmark("backward hop [DoubleStoredGaugeField]", [&] () {
+    for (unsigned int index = 0; index < volume; ++index) {
+      Eigen::Vector3cd result = Eigen::Vector3cd::Zero();
+      for (unsigned int mu = 0; mu < 4; ++mu) {
+        result.noalias() += double_stored.backward(index, mu)
+          * psi[double_stored.bwd_neighbour(index, mu)];
+      }
+      out[index] = result;
+    }
+  }, hop_flops, hop_bytes);
+
+  // Prevent the results being optimised away
+  std::cout << "(" << out[0].norm() << ")" << std::endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+  init_benchmarks(argc, argv);
+  pyQCD::LexicoLayout layout(std::vector<unsigned int>{16, 16, 16, 16});
+  GaugeField links(layout, GaugeLinks(4, Eigen::Matrix3cd::Identity()));
+  for (auto& site_links : links) {
+    for (auto& link : site_links) {
+      Eigen::HouseholderQR<Eigen::Matrix3cd> qr(Eigen::Matrix3cd::Random());
+      link = qr.householderQ();
+      link /= std::pow(link.determinant(), 1.0 / 3.0);
+    }
+  }
+  pyQCD::CompressedGaugeField<> compressed(links);
+  pyQCD::DoubleStoredGaugeField<3> double_stored(links, layout);
+  pyQCD::WilsonGaugeAction<3> action(5.5, layout);
+
+  profile_for_links(links, action, "Lattice<MatrixArray<3, 3> >",
+                    sizeof(Eigen::Matrix3cd));
+  profile_for_links(compressed, action, "CompressedGaugeField",
+                    pyQCD::CompressedGaugeField<>::num_reals * sizeof(double));
+  profile_backward_hop(links, double_stored);
+  return finish_benchmarks();
+}
@@ -0,0 +1,120 @@
+/* Benchmark for Lattice expression evaluation, assignment between layouts and
+ * nested (MatrixArray) site storage. The lattice volume is swept from a size
+ * that fits in L1 to production volumes, so that both cache-resident and
+ * memory-bound behaviour is visible. */
+
+#include <Eigen/Dense>
+
+#include "helpers.hpp"
+
+#include <core/lattice.hpp>
+#include <core/matrix_array.hpp>
+
+
+typedef Eigen::Vector3cd ColourVector;
+typedef Eigen::Matrix3cd ColourMatrix;
+typedef pyQCD::Lattice<ColourVector, Eigen::aligned_allocator> ColourField;
+typedef pyQCD::Lattice<ColourMatrix, Eigen::aligned_allocator> MatrixField;
+typedef pyQCD::MatrixArray<3, 3> GaugeLinks;
+typedef pyQCD::Lattice<GaugeLinks> GaugeField;
+
+
+void profile_expressions(const pyQCD::Layout& layout,
+                         const std::string& suffix)
+{
+  const long volume = layout.volume();
+  if (not fits_in_memory(volume * (3 * sizeof(ColourVector)
+                                   + sizeof(ColourMatrix)))) {
+    return;
+  }
+  ColourField x(layout, ColourVector::Ones());
+  ColourField y(layout, ColourVector::Ones());
+  ColourField result(layout, ColourVector::Zero());
+  MatrixField links(layout, ColourMatrix::Identity());
+
+  benchmark("r = x + y" + suffix, [&] () {
+    result = x + y;
+  }, pyQCD::expression_cost(x + y));
+
+  benchmark("r = 5.0 * x + y" + suffix, [&] () {
+    result = 5.0 * x + y;
+  }, pyQCD::expression_cost(5.0 * x + y));
+
+  benchmark("r = U * x" + suffix, [&] () {
+    result = links * x;
+  }, pyQCD::expression_cost(links * x));
+}
+
+
+void profile_cross_layout(const pyQCD::Layout& lexico_layout,
+                          const pyQCD::Layout& even_odd_layout,
+                          const std::string& suffix)
+{
+  // Assignment from a lattice with a different layout goes through the site
+  // index tables, whereas assignment between identical layouts is a copy
+  const long volume = lexico_layout.volume();
+  if (not fits_in_memory(volume * 3 * sizeof(ColourVector))) {
+    return;
+  }
+  ColourField lexico(lexico_layout, ColourVector::Ones());
+  ColourField lexico_copy(lexico_layout, ColourVector::Zero());
+  ColourField even_odd(even_odd_layout, ColourVector::Ones());
+  const long bytes = volume * 2 * sizeof(ColourVector);
+
+  benchmark("same-layout assignment" + suffix, [&] () {
+    lexico_copy = lexico;
+  }, 0, bytes);
+
+  benchmark("lexicographic to even-odd assignment" + suffix, [&] () {
+    even_odd = lexico;
+  }, 0, bytes);
+
+  benchmark("even-odd to lexicographic assignment" + suffix, [&] () {
+    lexico = even_odd;
+  }, 0, bytes);
+}
+
+
+void profile_nested(const pyQCD::Layout& layout, const std::string& suffix)
+{
+  // Compare a lattice of MatrixArrays, stored as one contiguous buffer and
+  // accessed through views, with a flat Array of the same matrices
+  const long num_links = 4 * static_cast<long>(layout.volume());
+  if (not fits_in_memory(num_links * 2 * sizeof(ColourMatrix))) {
+    return;
+  }
+  const long flops
+    = num_links * Multiplies::flops<ColourMatrix, ColourMatrix>();
+  const long bytes = num_links * 3 * sizeof(ColourMatrix);
+  {
+    GaugeField links(layout, GaugeLinks(4, ColourMatrix::Identity()));
+    GaugeField product(layout, GaugeLinks(4, ColourMatrix::Zero()));
+    benchmark("nested U * U" + suffix, [&] () {
+      product = links * links;
+    }, flops, bytes);
+  }
+  {
+    pyQCD::Array<ColourMatrix, Eigen::aligned_allocator> links(
+      num_links, ColourMatrix::Identity());
+    decltype(links) product(num_links, ColourMatrix::Zero());
+    benchmark("flat U * U" + suffix, [&] () {
+      product = links * links;
+    }, flops, bytes);
+  }
+}
+
+
+int main(int argc, char* argv[])
+{
+  init_benchmarks(argc, argv);
+  for (auto& shape : benchmark_shapes()) {
+    const std::string suffix = " [" + shape_name(shape) + "]";
+    const pyQCD::LexicoLayout lexico_layout(shape);
+    const pyQCD::EvenOddLayout even_odd_layout(shape);
+
+    profile_expressions(lexico_layout, suffix);
+    profile_cross_layout(lexico_layout, even_odd_layout, suffix);
+    profile_nested(lexico_layout, suffix);
+  }
+  return finish_benchmarks();
+}
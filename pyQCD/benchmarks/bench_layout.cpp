@@ -0,0 +1,71 @@
+/* Benchmark for Layout index lookups, comparing access to the sites of a
+ * Lattice in array order (operator[]) with access by lexicographic site index
+ * and by coordinates (operator()), which go through the layout's index table.
+ * The lattice volume is swept from a size that fits in L1 to production
+ * volumes. */
+
+#include <Eigen/Dense>
+
+#include "helpers.hpp"
+
+#include <core/lattice.hpp>
+
+
+typedef Eigen::Vector3cd ColourVector;
+typedef pyQCD::Lattice<ColourVector, Eigen::aligned_allocator> Field;
+
+
+void profile_for_layout(const pyQCD::Layout& layout, const std::string& type)
+{
+  const std::string suffix
+    = " [" + type + ", " + shape_name(layout.shape()) + "]";
+  const unsigned int volume = layout.volume();
+  Field field(layout, ColourVector::Ones());
+  // One complex multiply-add per colour component
+  const long flops = volume * 3 * 8;
+  const long bytes = volume * sizeof(ColourVector);
+  std::complex<double> total = 0.0;
+
+  benchmark("operator[](array_index)" + suffix, [&] () {
+    for (unsigned int i = 0; i < volume; ++i) {
+      total += field[i].dot(field[i]);
+    }
+  }, flops, bytes);
+
+  benchmark("operator()(site_index)" + suffix, [&] () {
+    for (unsigned int i = 0; i < volume; ++i) {
+      total += field(i).dot(field(i));
+    }
+  }, flops, bytes);
+
+  std::vector<unsigned int> coords(layout.num_dims());
+  benchmark("operator()(coords)" + suffix, [&] () {
+    for (unsigned int i = 0; i < volume; ++i) {
+      layout.compute_site_coords(i, coords);
+      total += field(coords).dot(field(coords));
+    }
+  }, flops, bytes);
+
+  // Prevent the results being optimised away
+  std::cout << "(" << total << ")" << std::endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+  init_benchmarks(argc, argv);
+  for (auto& shape : benchmark_shapes()) {
+    unsigned long volume = 1;
+    for (auto extent : shape) {
+      volume *= extent;
+    }
+    // The field plus the layout's two index tables
+    if (not fits_in_memory(
+          volume * (sizeof(ColourVector) + 2 * sizeof(unsigned int)))) {
+      continue;
+    }
+    profile_for_layout(pyQCD::LexicoLayout(shape), "LexicoLayout");
+    profile_for_layout(pyQCD::EvenOddLayout(shape), "EvenOddLayout");
+  }
+  return finish_benchmarks();
+}
@@ -0,0 +1,75 @@
+/* Benchmark for the generated small-matrix kernels (see
+ * core/detail/matrix_kernels.hpp), comparing each with the equivalent Eigen
+ * expression. The operands are cycled through arrays of matrices so that the
+ * compiler can't hoist the work out of the timing loop. */
+
+#include <complex>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "helpers.hpp"
+
+#include <core/detail/matrix_kernels.hpp>
+
+
+template <int N>
+void profile_for_size(const std::string& type)
+{
+  typedef Eigen::Matrix<std::complex<double>, N, N> Matrix;
+  typedef Eigen::Matrix<std::complex<double>, N, 1> Vector;
+  typedef pyQCD::MatrixKernel<std::complex<double>, N, N> Kernel;
+  const unsigned int n = 256;
+  std::vector<Matrix, Eigen::aligned_allocator<Matrix> > a(n), b(n), c(n);
+  std::vector<Vector, Eigen::aligned_allocator<Vector> > x(n), y(n);
+  for (unsigned int i = 0; i < n; ++i) {
+    a[i] = Matrix::Random();
+    b[i] = Matrix::Random();
+    x[i] = Vector::Random();
+  }
+  const long product_flops = n * 8 * N * N * N;
+  const long vector_flops = n * 8 * N * N;
+
+  benchmark("c = a * b, kernel [" + type + "]", [&] () {
+    for (unsigned int i = 0; i < n; ++i) {
+      Kernel::multiply(a[i], b[(i + 1) % n], c[i]);
+    }
+  }, product_flops);
+  benchmark("c = a * b, Eigen [" + type + "]", [&] () {
+    for (unsigned int i = 0; i < n; ++i) {
+      c[i].noalias() = a[i] * b[(i + 1) % n];
+    }
+  }, product_flops);
+
+  benchmark("c = a * b^dag, kernel [" + type + "]", [&] () {
+    for (unsigned int i = 0; i < n; ++i) {
+      Kernel::multiply_adjoint(a[i], b[(i + 1) % n], c[i]);
+    }
+  }, product_flops);
+  benchmark("c = a * b^dag, Eigen [" + type + "]", [&] () {
+    for (unsigned int i = 0; i < n; ++i) {
+      c[i].noalias() = a[i] * b[(i + 1) % n].adjoint();
+    }
+  }, product_flops);
+
+  benchmark("y = a * x, kernel [" + type + "]", [&] () {
+    for (unsigned int i = 0; i < n; ++i) {
+      Kernel::multiply(a[i], x[(i + 1) % n], y[i]);
+    }
+  }, vector_flops);
+  benchmark("y = a * x, Eigen [" + type + "]", [&] () {
+    for (unsigned int i = 0; i < n; ++i) {
+      y[i].noalias() = a[i] * x[(i + 1) % n];
+    }
+  }, vector_flops);
+}
+
+
+int main(int argc, char* argv[])
+{
+  init_benchmarks(argc, argv);
+  profile_for_size<3>("3x3");
+  profile_for_size<12>("12x12");
+  return finish_benchmarks();
+}
@@ -0,0 +1,101 @@
+/* Benchmark for Stencil, comparing the gauge covariant Laplacian with
+ * equivalent hand-written loops. */
+
+#include <Eigen/Dense>
+
+#include "helpers.hpp"
+
+#include <core/lattice.hpp>
+#include <core/matrix_array.hpp>
+#include <core/stencil.hpp>
+
+
+typedef Eigen::Vector3cd ColourVector;
+typedef pyQCD::Lattice<ColourVector, Eigen::aligned_allocator> Field;
+typedef pyQCD::MatrixArray<3, 3> GaugeLinks;
+typedef pyQCD::Lattice<GaugeLinks> GaugeField;
+
+
+int main(int argc, char* argv[])
+{
+  init_benchmarks(argc, argv);
+  pyQCD::LexicoLayout layout(std::vector<unsigned int>{16, 16, 16, 16});
+  GaugeField links(layout, GaugeLinks(4, Eigen::Matrix3cd::Identity()));
+  for (auto& site_links : links) {
+    for (auto& link : site_links) {
+      Eigen::HouseholderQR<Eigen::Matrix3cd> qr(Eigen::Matrix3cd::Random());
+      link = qr.householderQ();
+    }
+  }
+  Field psi(layout), out(layout);
+  for (auto& vec : psi) {
+    vec = ColourVector::Random();
+  }
+
+  const unsigned int volume = layout.volume();
+  // Eight matrix-vector products and nine vector additions per site
+  const long flops = volume * (8 * 66 + 9 * 6);
+  // One vector in and out per site, plus the eight links
+  const long bytes = volume * (2 * sizeof(ColourVector)
+                               + 8 * sizeof(Eigen::Matrix3cd));
+
+  benchmark("hand-written loop", [&] () {
+    for (unsigned int site = 0; site < volume; ++site) {
+      ColourVector result = -8.0 * psi[site];
+      for (unsigned int mu = 0; mu < 4; ++mu) {
+        const unsigned int fwd = layout.compute_neighbour_index(site, mu, 1);
+        const unsigned int bwd = layout.compute_neighbour_index(site, mu, -1);
+        result += links[site][mu] * psi[fwd];
+        result += links[bwd][mu].adjoint() * psi[bwd];
+      }
+      out[site] = result;
+    }
+  }, flops, bytes);
+
+  std::vector<unsigned int> neighbours(8 * volume);
+  for (unsigned int site = 0; site < volume; ++site) {
+    for (unsigned int mu = 0; mu < 4; ++mu) {
+      neighbours[8 * site + 2 * mu]
+        = layout.compute_neighbour_index(site, mu, 1);
+      neighbours[8 * site + 2 * mu + 1]
+        = layout.compute_neighbour_index(site, mu, -1);
+    }
+  }
+  benchmark("hand-written loop with neighbour table", [&] () {
+    for (unsigned int site = 0; site < volume; ++site) {
+      ColourVector result = -8.0 * psi[site];
+      for (unsigned int mu = 0; mu < 4; ++mu) {
+        const unsigned int fwd = neighbours[8 * site + 2 * mu];
+        const unsigned int bwd = neighbours[8 * site + 2 * mu + 1];
+        result += links[site][mu] * psi[fwd];
+        result += links[bwd][mu].adjoint() * psi[bwd];
+      }
+      out[site] = result;
+    }
+  }, flops, bytes);
+
+  std::vector<pyQCD::StencilTerm<double> > terms{
+    pyQCD::shift_term(-8.0, 0, 0)};
+  for (unsigned int mu = 0; mu < 4; ++mu) {
+    terms.push_back(pyQCD::shift_term(1.0, mu, 1));
+    terms.push_back(pyQCD::shift_term(1.0, mu, -1));
+  }
+  pyQCD::Stencil<double> laplacian(layout, terms);
+
+  benchmark("Stencil::apply", [&] () {
+    laplacian.apply(links, psi, out);
+  }, flops, bytes);
+
+  benchmark("Stencil expression", [&] () {
+    out = laplacian(links, psi);
+  }, flops, bytes);
+
+  // As the Wilson operator, psi - kappa * hopping(links, psi)
+  benchmark("Stencil in a compound expression", [&] () {
+    out = psi - 0.1 * laplacian(links, psi);
+  }, flops + volume * 12, bytes);
+
+  // Prevent the results being optimised away
+  std::cout << "(" << out[0].norm() << ")" << std::endl;
+  return finish_benchmarks();
+}
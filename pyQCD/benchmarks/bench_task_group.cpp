@@ -0,0 +1,96 @@
+/* Benchmark for work-stealing loops, comparing the static partition of
+ * parallel_for with parallel_for_dynamic on workloads where the cost per item
+ * varies. As well as the time taken, the load imbalance is reported: the work
+ * done by the busiest thread divided by the mean work per thread. */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "helpers.hpp"
+
+#include <utils/parallel.hpp>
+#include <utils/task_group.hpp>
+
+
+double burn(const unsigned long cost)
+{
+  // Some arithmetic that takes time proportional to cost
+  double ret = 0.0;
+  for (unsigned long i = 0; i < cost; ++i) {
+    ret += std::sqrt(static_cast<double>(i + 1));
+  }
+  return ret;
+}
+
+
+template <typename Loop>
+void profile(const std::string& workload, const std::string& name,
+             Loop loop, const std::vector<unsigned long>& costs)
+{
+  std::vector<std::thread::id> ids(costs.size());
+  std::vector<double> results(costs.size());
+  auto body = [&] (const unsigned long i) {
+    results[i] = burn(costs[i]);
+    ids[i] = std::this_thread::get_id();
+  };
+
+  benchmark(workload + " [" + name + "]", [&] () { loop(body); });
+
+  std::map<std::thread::id, double> work;
+  double total = 0.0;
+  for (unsigned long i = 0; i < costs.size(); ++i) {
+    work[ids[i]] += costs[i];
+    total += costs[i];
+  }
+  double max_work = 0.0;
+  for (auto& entry : work) {
+    max_work = std::max(max_work, entry.second);
+  }
+  std::cout << "  load imbalance "
+            << max_work / (total / pyQCD::num_threads()) << std::endl;
+}
+
+
+void profile_workload(const std::string& name,
+                      const std::vector<unsigned long>& costs)
+{
+  const unsigned long n = costs.size();
+  profile(name, "parallel_for", [&] (std::function<void(unsigned long)> body) {
+    pyQCD::parallel_for(0, n, body);
+  }, costs);
+  profile(name, "parallel_for_dynamic", [&] (
+      std::function<void(unsigned long)> body) {
+    pyQCD::parallel_for_dynamic(0, n, body);
+  }, costs);
+}
+
+
+int main(int argc, char* argv[])
+{
+  pyQCD::set_num_threads(
+    std::max(std::thread::hardware_concurrency(), 4u));
+  init_benchmarks(argc, argv);
+
+  // Wilson loops of size R x T for R, T = 1, ..., 16, where the cost is
+  // proportional to the area
+  std::vector<unsigned long> wilson_loops;
+  for (unsigned long r = 1; r <= 16; ++r) {
+    for (unsigned long t = 1; t <= 16; ++t) {
+      wilson_loops.push_back(2000 * r * t);
+    }
+  }
+  profile_workload("Wilson loops", wilson_loops);
+
+  // Timeslice eigensolves where a few timeslices converge slowly
+  std::vector<unsigned long> eigensolves(32, 200000);
+  eigensolves[0] = eigensolves[1] = eigensolves[2] = 4000000;
+  profile_workload("timeslice eigensolves", eigensolves);
+
+  // Uniform work, for which work stealing should cost little
+  profile_workload("uniform", std::vector<unsigned long>(1024, 10000));
+  return finish_benchmarks();
+}
@@ -1,48 +1,349 @@
 #ifndef HELPERS_HPP
 #define HELPERS_HPP
 
-/* Utilities to facilitate benchmarking */
+/* Utilities to facilitate benchmarking.
+ *
+ * benchmark(name, fn, flops, bytes) times calls of fn using a steady clock and
+ * reports statistics of the time per call. fn is first called repeatedly for a
+ * warm-up period, which also estimates its cost. The timed calls are then
+ * grouped into samples, each of which makes enough calls to last a reasonable
+ * fraction of the total time, so that fast kernels aren't swamped by the
+ * resolution of the clock. Samples are collected until both a minimum time and
+ * a minimum number of samples have been reached. The median time per call is
+ * reported, along with the 10th and 90th percentiles and, where flops and
+ * bytes per call are given, the corresponding throughputs. For array
+ * expressions these can be derived from the expression type with
+ * pyQCD::expression_cost (see core/expr_cost.hpp) and passed in its place.
+ *
+ * Benchmark executables should call init_benchmarks(argc, argv) first and
+ * return finish_benchmarks() from main. The following arguments are accepted:
+ *
+ *   --json FILE         Write the results to FILE as JSON
+ *   --filter TEXT       Only run benchmarks whose names contain TEXT
+ *   --min-time SECONDS  Minimum time spent on each benchmark (default 1)
+ *   --min-samples N     Minimum number of samples (default 5)
+ *   --max-samples N     Maximum number of samples (default 1000)
+ *   --max-memory GB     Skip problem sizes needing more memory (default 4)
+ *
+ * Benchmarks that sweep the lattice volume use benchmark_shapes(), skipping
+ * shapes for which fits_in_memory() is false.
+ *
+ * Benchmarks are built and run through pyqcd_add_benchmark (see
+ * cmake/PyQCDBenchmarks.cmake).
+ */
 
-#include <iostream>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <core/expr_cost.hpp>
+#include <utils/cpu_dispatch.hpp>
+#include <utils/thread_pool.hpp>
+
 
-unsigned int matmul_flops(
-  const unsigned int n, const bool complex, const unsigned int float_width)
+struct BenchmarkResult
 {
-  const unsigned int mul_flops = complex ? 6 : 1;
-  const unsigned int add_flops = complex ? 2 : 1;
-  return (n * mul_flops + (n - 1) * add_flops) * n * n * float_width;
+  std::string name;
+  long num_flops, num_bytes;
+  unsigned long num_samples, calls_per_sample;
+  // Statistics of the time per call, in seconds
+  double median, p10, p90, min, mean, stddev;
+};
+
+
+struct BenchmarkOptions
+{
+  BenchmarkOptions()
+    : min_time(1.0), max_memory(4.0e9), min_samples(5), max_samples(1000)
+  { }
+
+  std::string executable, json_file, filter;
+  double min_time, max_memory;
+  unsigned long min_samples, max_samples;
+  // Recorded when the benchmarks start, as the thread pool may not be
+  // available when the results are written
+  unsigned int num_threads;
+  std::string simd_level, date;
+};
+
+
+namespace detail
+{
+  inline BenchmarkOptions& benchmark_options()
+  {
+    static BenchmarkOptions ret;
+    return ret;
+  }
+
+
+  inline std::vector<BenchmarkResult>& benchmark_results()
+  {
+    static std::vector<BenchmarkResult> ret;
+    return ret;
+  }
+
+
+  inline double percentile(const std::vector<double>& sorted, const double q)
+  {
+    // Linear interpolation between the closest ranks
+    const double rank = q * (sorted.size() - 1);
+    const unsigned long lower = static_cast<unsigned long>(rank);
+    const unsigned long upper = std::min(lower + 1, sorted.size() - 1);
+    return sorted[lower] + (rank - lower) * (sorted[upper] - sorted[lower]);
+  }
+
+
+  inline std::string format_time(const double seconds)
+  {
+    std::ostringstream ss;
+    ss << std::setprecision(4);
+    if (seconds >= 1.0) {
+      ss << seconds << " s";
+    }
+    else if (seconds >= 1.0e-3) {
+      ss << seconds * 1.0e3 << " ms";
+    }
+    else if (seconds >= 1.0e-6) {
+      ss << seconds * 1.0e6 << " us";
+    }
+    else {
+      ss << seconds * 1.0e9 << " ns";
+    }
+    return ss.str();
+  }
+
+
+  inline std::string json_string(const std::string& value)
+  {
+    std::string ret = "\"";
+    for (char c : value) {
+      if (c == '"' or c == '\\') {
+        ret += '\\';
+      }
+      ret += c;
+    }
+    return ret + "\"";
+  }
 }
 
 
-unsigned int matadd_flops(
-  const unsigned int n, const bool complex, const unsigned int float_width)
+inline void init_benchmarks(int argc, char* argv[])
 {
-  return n * n * float_width * (complex ? 2 : 1);
+  BenchmarkOptions& options = detail::benchmark_options();
+  const std::string path = argc > 0 ? argv[0] : "";
+  options.executable = path.substr(path.find_last_of('/') + 1);
+
+  for (int i = 1; i < argc; ++i) {
+    const bool has_value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--json") == 0 and has_value) {
+      options.json_file = argv[++i];
+    }
+    else if (std::strcmp(argv[i], "--filter") == 0 and has_value) {
+      options.filter = argv[++i];
+    }
+    else if (std::strcmp(argv[i], "--min-time") == 0 and has_value) {
+      options.min_time = std::atof(argv[++i]);
+    }
+    else if (std::strcmp(argv[i], "--max-memory") == 0 and has_value) {
+      options.max_memory = std::atof(argv[++i]) * 1.0e9;
+    }
+    else if (std::strcmp(argv[i], "--min-samples") == 0 and has_value) {
+      options.min_samples = std::max(std::atol(argv[++i]), 1l);
+    }
+    else if (std::strcmp(argv[i], "--max-samples") == 0 and has_value) {
+      options.max_samples = std::max(std::atol(argv[++i]), 1l);
+    }
+    else {
+      std::cerr << "Ignoring unrecognised argument " << argv[i] << std::endl;
+    }
+  }
+  options.max_samples = std::max(options.max_samples, options.min_samples);
+
+  options.num_threads = pyQCD::num_threads();
+  options.simd_level = pyQCD::simd_level_name(pyQCD::simd_level());
+  const std::time_t now = std::time(nullptr);
+  char date[32];
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+  options.date = date;
+
+  std::cout << "Running " << options.executable << " with "
+            << options.num_threads << " threads and " << options.simd_level
+            << " kernels." << std::endl;
 }
 
 
 template <typename Fn>
-void benchmark(Fn func, const long num_flops = 0, const int num_trials = 100)
+void benchmark(const std::string& name, Fn func, const long num_flops = 0,
+               const long num_bytes = 0)
 {
-  auto start = std::chrono::system_clock::now();
-  for (int i = 0; i < num_trials; ++i) {
+  typedef std::chrono::steady_clock Clock;
+  auto seconds_since = [] (const Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  };
+  const BenchmarkOptions& options = detail::benchmark_options();
+  if (name.find(options.filter) == std::string::npos) {
+    return;
+  }
+
+  // Warm up caches, page tables, the thread pool and the clock frequency,
+  // and estimate the time per call
+  const double warm_up_time = 0.1 * options.min_time;
+  unsigned long warm_up_calls = 0;
+  const auto warm_up_start = Clock::now();
+  double elapsed = 0.0;
+  do {
     func();
+    ++warm_up_calls;
+    elapsed = seconds_since(warm_up_start);
+  } while (elapsed < warm_up_time);
+
+  // Aim for at least min_samples samples per min_time, and a sample length
+  // well above the clock resolution
+  const double sample_time
+    = std::max(options.min_time / (4 * options.min_samples), 1.0e-3);
+  const double call_time = elapsed / warm_up_calls;
+  const unsigned long calls_per_sample
+    = std::max(static_cast<unsigned long>(sample_time / call_time), 1ul);
+
+  std::vector<double> times;
+  double total = 0.0;
+  while (times.size() < options.max_samples
+         and (times.size() < options.min_samples or total < options.min_time)) {
+    const auto start = Clock::now();
+    for (unsigned long i = 0; i < calls_per_sample; ++i) {
+      func();
+    }
+    const double sample = seconds_since(start);
+    total += sample;
+    times.push_back(sample / calls_per_sample);
   }
-  auto end = std::chrono::system_clock::now();
 
-  std::chrono::duration<double> elapsed_seconds = end - start;
-  double elapsed = elapsed_seconds.count();
-  std::cout << "Performed " << num_flops * num_trials << " flops in " << elapsed
-    << " seconds";
+  BenchmarkResult result;
+  result.name = name;
+  result.num_flops = num_flops;
+  result.num_bytes = num_bytes;
+  result.num_samples = times.size();
+  result.calls_per_sample = calls_per_sample;
+  std::sort(times.begin(), times.end());
+  result.median = detail::percentile(times, 0.5);
+  result.p10 = detail::percentile(times, 0.1);
+  result.p90 = detail::percentile(times, 0.9);
+  result.min = times.front();
+  result.mean = total / (calls_per_sample * times.size());
+  double variance = 0.0;
+  for (auto time : times) {
+    variance += (time - result.mean) * (time - result.mean);
+  }
+  result.stddev = std::sqrt(variance / std::max(times.size() - 1, 1ul));
+  detail::benchmark_results().push_back(result);
 
+  std::cout << name << ":\n  median " << detail::format_time(result.median)
+            << " (p10 " << detail::format_time(result.p10) << ", p90 "
+            << detail::format_time(result.p90) << ", min "
+            << detail::format_time(result.min) << "), " << result.num_samples
+            << " samples of " << calls_per_sample << " calls" << std::endl;
   if (num_flops > 0) {
-    std::cout << " => " << num_trials * num_flops / elapsed / 1000000.0
-      << " Mflops." << std::endl;
+    std::cout << "  " << num_flops / result.median / 1.0e9 << " Gflop/s"
+              << std::endl;
+  }
+  if (num_bytes > 0) {
+    std::cout << "  " << num_bytes / result.median / 1.0e9 << " GB/s"
+              << std::endl;
   }
-  else {
-    std::cout << "." << std::endl;
+}
+
+
+template <typename Fn>
+void benchmark(const std::string& name, Fn func, const pyQCD::ExprCost& cost)
+{ benchmark(name, func, cost.flops, cost.bytes); }
+
+
+inline std::vector<std::vector<unsigned int> > benchmark_shapes()
+{
+  // Lattice shapes from a volume that fits in L1 up to production volumes
+  // that are far larger than the last-level cache
+  return std::vector<std::vector<unsigned int> >{
+    {4, 4, 4, 4}, {8, 8, 8, 8}, {12, 12, 12, 12}, {16, 16, 16, 16},
+    {24, 24, 24, 24}, {32, 32, 32, 32}, {48, 48, 48, 96}};
+}
+
+
+inline std::string shape_name(const std::vector<unsigned int>& shape)
+{
+  std::ostringstream ss;
+  for (unsigned int i = 0; i < shape.size(); ++i) {
+    ss << (i > 0 ? "x" : "") << shape[i];
+  }
+  return ss.str();
+}
+
+
+inline bool fits_in_memory(const double num_bytes)
+{
+  // Whether a problem needing num_bytes of memory should be run
+  const double max_memory = detail::benchmark_options().max_memory;
+  if (num_bytes > max_memory) {
+    std::cout << "Skipping problem needing " << num_bytes / 1.0e9
+              << " GB (> " << max_memory / 1.0e9 << " GB)." << std::endl;
+    return false;
+  }
+  return true;
+}
+
+
+inline int finish_benchmarks()
+{
+  // Write the results as JSON if requested, returning the exit status
+  const BenchmarkOptions& options = detail::benchmark_options();
+  if (options.json_file.empty()) {
+    return 0;
+  }
+
+  std::ofstream file(options.json_file);
+  if (not file) {
+    std::cerr << "Unable to open " << options.json_file << std::endl;
+    return 1;
+  }
+  file << std::setprecision(9);
+  file << "{\n  \"executable\": " << detail::json_string(options.executable)
+       << ",\n  \"context\": {\"date\": " << detail::json_string(options.date)
+       << ", \"num_threads\": " << options.num_threads
+       << ", \"simd_level\": " << detail::json_string(options.simd_level)
+       << ", \"min_time\": " << options.min_time
+       << ", \"min_samples\": " << options.min_samples << "},\n"
+       << "  \"benchmarks\": [";
+
+  const auto& results = detail::benchmark_results();
+  for (unsigned long i = 0; i < results.size(); ++i) {
+    const BenchmarkResult& result = results[i];
+    file << (i > 0 ? ",\n" : "\n")
+         << "    {\"name\": " << detail::json_string(result.name)
+         << ", \"samples\": " << result.num_samples
+         << ", \"calls_per_sample\": " << result.calls_per_sample
+         << ", \"median\": " << result.median
+         << ", \"p10\": " << result.p10
+         << ", \"p90\": " << result.p90
+         << ", \"min\": " << result.min
+         << ", \"mean\": " << result.mean
+         << ", \"stddev\": " << result.stddev
+         << ", \"flops\": " << result.num_flops
+         << ", \"bytes\": " << result.num_bytes
+         << ", \"gflops_per_second\": "
+         << result.num_flops / result.median / 1.0e9
+         << ", \"gbytes_per_second\": "
+         << result.num_bytes / result.median / 1.0e9 << "}";
   }
+  file << "\n  ]\n}\n";
+  return file ? 0 : 1;
 }
 
 #endif
@@ -0,0 +1,34 @@
+# Registration of benchmarks. pyqcd_add_benchmark(source) builds the benchmark
+# executable in source (named after the file) and adds a target run_<name>
+# that runs it, writing the results as JSON to
+# ${PYQCD_BENCHMARK_RESULTS_DIR}/<name>.json (see benchmarks/helpers.hpp). The
+# run_benchmarks target runs all benchmarks, one at a time so that they don't
+# compete for the machine.
+
+set (PYQCD_BENCHMARK_RESULTS_DIR ${CMAKE_BINARY_DIR}/benchmark_results
+  CACHE PATH "Directory for benchmark results")
+set (PYQCD_BENCHMARK_ARGS ""
+  CACHE STRING "Extra arguments passed to benchmarks by run_benchmarks")
+
+add_custom_target (run_benchmarks)
+
+function (pyqcd_add_benchmark source)
+  get_filename_component (name ${source} NAME_WE)
+  add_executable (${name} ${source})
+  target_link_libraries (${name} pyQCDutils)
+
+  separate_arguments (args UNIX_COMMAND "${PYQCD_BENCHMARK_ARGS}")
+  add_custom_target (run_${name}
+    COMMAND ${CMAKE_COMMAND} -E make_directory ${PYQCD_BENCHMARK_RESULTS_DIR}
+    COMMAND ${name} --json ${PYQCD_BENCHMARK_RESULTS_DIR}/${name}.json ${args}
+    DEPENDS ${name}
+    COMMENT "Running benchmark ${name}")
+
+  # Chain the run targets so that they never run concurrently
+  get_property (previous GLOBAL PROPERTY PYQCD_LAST_BENCHMARK)
+  if (previous)
+    add_dependencies (run_${name} ${previous})
+  endif ()
+  set_property (GLOBAL PROPERTY PYQCD_LAST_BENCHMARK run_${name})
+  add_dependencies (run_benchmarks run_${name})
+endfunction ()
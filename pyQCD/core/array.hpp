@@ -11,6 +11,20 @@
  *
  * The expression templates that are used by this class can be found in
  * array_expr.hpp
+ *
+ * Storage that is about to be overwritten, such as the result of an expression,
+ * is not value-initialised beforehand, so each element is only written once.
+ * The Uninitialized tag provides the same behaviour to client code that fills
+ * an array itself.
+ *
+ * If an expression has an Array operand that's about to expire, e.g.
+ * Array<double> c = std::move(a) + b, then a new Array constructed from the
+ * expression takes over the buffer of that operand rather than allocating one
+ * of its own. This is only done when every node of the expression is an Array
+ * operand or one of the elementwise nodes in array_expr.hpp, so that each
+ * element only depends on the elements of its operands at the same index.
+ * Expressions containing any other node, such as a stencil, which reads
+ * neighbouring sites, always get a buffer of their own.
  */
 
 #include <stdexcept>
@@ -20,10 +34,17 @@
 #include <utils/macros.hpp>
 #include <utils/templates.hpp>
 #include "detail/array_expr.hpp"
+#include "detail/default_init_allocator.hpp"
+#include "expr_cost.hpp"
 
 
 namespace pyQCD
 {
+  // Tag to request that storage is left uninitialised on construction, for use
+  // when all the elements are about to be overwritten
+  struct Uninitialized { };
+
+
   template <typename T1, template <typename> class Alloc = std::allocator,
     typename T2 = EmptyType>
   class Array
@@ -31,34 +52,33 @@ namespace pyQCD
   {
   template <typename U1, typename U2, typename U3, typename U4, typename Op>
   friend class ArrayBinary;
+  template <typename U>
+  friend struct BufferTraits;
   public:
+    typedef std::vector<T1, DefaultInitAllocator<Alloc<T1> > > storage_type;
+    typedef typename storage_type::iterator iterator;
+    typedef typename storage_type::const_iterator const_iterator;
+
     Array() { }
     Array(const int n, const T1& val) : data_(n, val) { }
+    Array(const int n, Uninitialized) : data_(n) { }
     Array(const Array<T1, Alloc, T2>& array) = default;
     Array(Array<T1, Alloc, T2>&& array) = default;
     template <typename U1, typename U2>
-    Array(const ArrayExpr<U1, U2>& expr)
-    {
-      data_.resize(expr.size());
-      T1* ptr = &data_[0];
-      for (unsigned long i = 0; i < expr.size(); ++i) {
-        ptr[i] = static_cast<T1>(expr[i]);
-      }
-    }
+    Array(const ArrayExpr<U1, U2>& expr) { evaluate(expr); }
     virtual ~Array() = default;
 
     T1& operator[](const unsigned long i) { return data_[i]; }
     const T1& operator[](const unsigned long i) const { return data_[i]; }
 
-    void resize(const int size) { data_.resize(size); }
+    void resize(const int size) { data_.resize(size, T1()); }
     ArrayConst<Array<T1, Alloc, T2> > broadcast() const
     { return ArrayConst<Array<T1, Alloc, T2> >(*this); }
 
-    typename std::vector<T1>::iterator begin() { return data_.begin(); }
-    typename std::vector<T1>::const_iterator begin() const
-    { return data_.begin(); }
-    typename std::vector<T1>::iterator end() { return data_.end(); }
-    typename std::vector<T1>::const_iterator end() const { return data_.end(); }
+    iterator begin() { return data_.begin(); }
+    const_iterator begin() const { return data_.begin(); }
+    iterator end() { return data_.end(); }
+    const_iterator end() const { return data_.end(); }
 
     Array<T1, Alloc, T2>& operator=(const Array<T1, Alloc, T2>& array) = default;
     Array<T1, Alloc, T2>& operator=(Array<T1, Alloc, T2>&& array) = default;
@@ -72,10 +92,7 @@ namespace pyQCD
     {
       pyQCDassert ((data_.size() == expr.size()),
                    std::out_of_range("Array::data_"));
-      T1* ptr = &data_[0];
-      for (unsigned long i = 0; i < expr.size(); ++i) {
-        ptr[i] = static_cast<T1>(expr[i]);
-      }
+      evaluate_elements(data_.data(), expr, 0, expr.size());
       return *this;
     }
 
@@ -95,7 +112,25 @@ namespace pyQCD
     unsigned long size() const { return data_.size(); }
 
   protected:
-    std::vector<T1, Alloc<T1> > data_;
+    template <typename U1, typename U2>
+    void evaluate(const ArrayExpr<U1, U2>& expr)
+    {
+      // Evaluate expr into data_, reusing the buffer of an expiring operand
+      // where there is one with the right type and size
+      storage_type* buffer = BufferTraits<U1>::template get<storage_type>(
+        static_cast<const U1&>(expr));
+      const bool steal = buffer != nullptr and buffer->size() == expr.size();
+      if (not steal) {
+        data_.resize(expr.size());
+      }
+      T1* ptr = steal ? buffer->data() : data_.data();
+      evaluate_elements(ptr, expr, 0, expr.size());
+      if (steal) {
+        data_.swap(*buffer);
+      }
+    }
+
+    storage_type data_;
   };
 
 
@@ -0,0 +1,168 @@
+#ifndef ARRAY_VIEW_HPP
+#define ARRAY_VIEW_HPP
+
+/* This file provides a non-owning view of a contiguous sequence of elements,
+ * which can be used in Array expressions. Lattices of Array types (e.g.
+ * Lattice<MatrixArray<3, 3> >) store the elements of all sites in one buffer
+ * and return an ArrayView of the relevant part of it when a site is accessed.
+ *
+ * An ArrayView behaves like a reference: copying a view creates another view
+ * of the same elements, whilst assigning to a view overwrites the elements it
+ * refers to. A view can be converted to the corresponding Array type, which
+ * copies the elements.
+ *
+ * Also provided is ArrayViewIterator, which steps through consecutive views of
+ * the same size. As a view is not itself an object in memory, the iterator
+ * holds the current view and dereferencing returns a reference to it. This
+ * allows range-based for loops using auto& to work as for other Arrays.
+ */
+
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+#include <utils/macros.hpp>
+#include "detail/array_expr.hpp"
+
+
+namespace pyQCD
+{
+  template <typename T>
+  class ArrayViewIterator;
+
+
+  template <typename T>
+  class ArrayView
+    : public ArrayExpr<ArrayView<T>, typename std::remove_const<T>::type>
+  {
+  template <typename U>
+  friend class ArrayViewIterator;
+  public:
+    typedef typename std::remove_const<T>::type value_type;
+
+    ArrayView() : data_(nullptr), size_(0) { }
+    ArrayView(T* data, const unsigned long size) : data_(data), size_(size) { }
+    ArrayView(const ArrayView<T>& view) = default;
+    // Allow conversion from a view of mutable elements to a view of const ones
+    template <typename U,
+      typename std::enable_if<
+        std::is_same<const U, T>::value
+        and not std::is_same<U, T>::value>::type* = nullptr>
+    ArrayView(const ArrayView<U>& view)
+      : data_(view.data()), size_(view.size())
+    { }
+
+    T& operator[](const unsigned long i) const { return data_[i]; }
+
+    T* data() const { return data_; }
+    T* begin() const { return data_; }
+    T* end() const { return data_ + size_; }
+
+    unsigned long size() const { return size_; }
+    const Layout* layout() const { return nullptr; }
+
+    ArrayView<T>& operator=(const ArrayView<T>& view)
+    {
+      pyQCDassert ((size_ == view.size()),
+                   std::out_of_range("ArrayView: size() != view.size()"));
+      for (unsigned long i = 0; i < size_; ++i) {
+        data_[i] = view[i];
+      }
+      return *this;
+    }
+    template <typename U1, typename U2>
+    ArrayView<T>& operator=(const ArrayExpr<U1, U2>& expr)
+    {
+      pyQCDassert ((size_ == expr.size()),
+                   std::out_of_range("ArrayView: size() != expr.size()"));
+      assign_elements(data_, expr, 0, size_);
+      return *this;
+    }
+    ArrayView<T>& operator=(const value_type& rhs)
+    {
+      for (unsigned long i = 0; i < size_; ++i) {
+        data_[i] = rhs;
+      }
+      return *this;
+    }
+
+#define ARRAY_VIEW_OPERATOR_ASSIGN_DECL(op)                                \
+    template <typename U,                                                  \
+      typename std::enable_if<                                             \
+        not std::is_base_of<ArrayObj, U>::value>::type* = nullptr>         \
+    ArrayView<T>& operator op ## =(const U& rhs)                           \
+    {                                                                      \
+      for (unsigned long i = 0; i < size_; ++i) {                          \
+        data_[i] op ## = rhs;                                              \
+      }                                                                    \
+      return *this;                                                        \
+    }                                                                      \
+    template <typename U1, typename U2>                                    \
+    ArrayView<T>& operator op ## =(const ArrayExpr<U1, U2>& expr)          \
+    {                                                                      \
+      pyQCDassert ((size_ == expr.size()),                                 \
+        std::out_of_range("ArrayView: size() != expr.size()"));            \
+      for (unsigned long i = 0; i < size_; ++i) {                          \
+        data_[i] op ## = expr[i];                                          \
+      }                                                                    \
+      return *this;                                                        \
+    }
+
+    ARRAY_VIEW_OPERATOR_ASSIGN_DECL(+);
+    ARRAY_VIEW_OPERATOR_ASSIGN_DECL(-);
+    ARRAY_VIEW_OPERATOR_ASSIGN_DECL(*);
+    ARRAY_VIEW_OPERATOR_ASSIGN_DECL(/);
+
+    const ArrayUnary<ArrayView<T>, value_type, Adjoint> adjoint() const
+    { return ArrayUnary<ArrayView<T>, value_type, Adjoint>(*this); }
+
+  private:
+    T* data_;
+    unsigned long size_;
+  };
+
+
+  template <typename T>
+  class ArrayViewIterator
+    : public std::iterator<std::forward_iterator_tag, ArrayView<T> >
+  {
+  public:
+    ArrayViewIterator(T* data, const unsigned long view_size)
+      : view_(data, view_size)
+    { }
+    ArrayViewIterator(const ArrayViewIterator<T>& iter) = default;
+
+    ArrayViewIterator<T>& operator=(const ArrayViewIterator<T>& iter)
+    {
+      // Rebind the view rather than assigning to the elements it refers to
+      view_.data_ = iter.view_.data_;
+      view_.size_ = iter.view_.size_;
+      return *this;
+    }
+
+    ArrayView<T>& operator*() const { return view_; }
+    ArrayView<T>* operator->() const { return &view_; }
+
+    ArrayViewIterator<T>& operator++()
+    {
+      view_.data_ += view_.size_;
+      return *this;
+    }
+    ArrayViewIterator<T> operator++(int)
+    {
+      ArrayViewIterator<T> ret = *this;
+      view_.data_ += view_.size_;
+      return ret;
+    }
+
+    bool operator==(const ArrayViewIterator<T>& other) const
+    { return view_.data_ == other.view_.data_; }
+    bool operator!=(const ArrayViewIterator<T>& other) const
+    { return view_.data_ != other.view_.data_; }
+
+  private:
+    mutable ArrayView<T> view_;
+  };
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef COMPRESSED_GAUGE_FIELD_HPP
+#define COMPRESSED_GAUGE_FIELD_HPP
+
+/* This file provides a compressed storage format for SU(3) gauge fields. Only
+ * the first two rows of each link are stored (twelve reals rather than
+ * eighteen), and the third row is reconstructed on the fly using unitarity,
+ *
+ *   U_2j = (U_0 x U_1)_j^*.
+ *
+ * Kernels that are bandwidth bound (e.g. dslash and staples) therefore trade
+ * a few flops for a third less memory traffic.
+ *
+ * The links are stored contiguously in a single buffer, in the same order as
+ * the Lattice they're constructed from (array index, then direction). Element
+ * access mirrors that of Lattice<MatrixArray<3, 3> >, i.e. links[index][mu],
+ * so kernels written as templates over the link field type work with either.
+ * Note that this only holds for links in SU(3); links with other phases
+ * folded in can't be compressed in this way.
+ */
+
+#include <complex>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "lattice.hpp"
+#include "matrix_array.hpp"
+
+
+namespace pyQCD
+{
+  template <typename T = double>
+  class CompressedGaugeField
+  {
+  public:
+    typedef Lattice<MatrixArray<3, 3, T> > GaugeField;
+    typedef Eigen::Matrix<std::complex<T>, 3, 3> ColourMatrix;
+    static constexpr unsigned int num_reals = 12;
+
+    class SiteLinks
+    {
+      // Proxy for the links on a single site, mirroring MatrixArray
+    public:
+      SiteLinks(const T* data) : data_(data) { }
+      ColourMatrix operator[](const unsigned int mu) const
+      { return reconstruct(data_ + mu * num_reals); }
+
+    private:
+      const T* data_;
+    };
+
+    CompressedGaugeField() : layout_(nullptr), num_dims_(0), size_(0) { }
+    CompressedGaugeField(const GaugeField& links);
+
+    SiteLinks operator[](const unsigned int index) const
+    { return SiteLinks(&data_[index * num_dims_ * num_reals]); }
+
+    // Reconstruct the full gauge field
+    GaugeField decompress() const;
+
+    static ColourMatrix reconstruct(const T* data);
+    static void compress(const ColourMatrix& link, T* data);
+
+    unsigned int volume() const { return layout_->volume(); }
+    unsigned int num_dims() const { return num_dims_; }
+    const Layout* layout() const { return layout_; }
+    unsigned long size() const { return size_; }
+
+  private:
+    const Layout* layout_;
+    unsigned int num_dims_;
+    unsigned long size_;
+    std::vector<T> data_;
+  };
+
+
+  template <typename T>
+  CompressedGaugeField<T>::CompressedGaugeField(const GaugeField& links)
+    : layout_(links.layout()), num_dims_(links[0].size()),
+      size_(links.size()), data_(links.size() * num_dims_ * num_reals)
+  {
+    for (unsigned int i = 0; i < links.size(); ++i) {
+      for (unsigned int mu = 0; mu < num_dims_; ++mu) {
+        compress(links[i][mu], &data_[(i * num_dims_ + mu) * num_reals]);
+      }
+    }
+  }
+
+
+  template <typename T>
+  typename CompressedGaugeField<T>::GaugeField
+  CompressedGaugeField<T>::decompress() const
+  {
+    GaugeField ret(*layout_,
+                   MatrixArray<3, 3, T>(num_dims_, ColourMatrix::Zero()));
+    for (unsigned int i = 0; i < ret.size(); ++i) {
+      for (unsigned int mu = 0; mu < num_dims_; ++mu) {
+        ret[i][mu] = (*this)[i][mu];
+      }
+    }
+    return ret;
+  }
+
+
+  template <typename T>
+  inline void CompressedGaugeField<T>::compress(const ColourMatrix& link,
+                                                T* data)
+  {
+    for (unsigned int row = 0; row < 2; ++row) {
+      for (unsigned int col = 0; col < 3; ++col) {
+        *data++ = link(row, col).real();
+        *data++ = link(row, col).imag();
+      }
+    }
+  }
+
+
+  template <typename T>
+  inline typename CompressedGaugeField<T>::ColourMatrix
+  CompressedGaugeField<T>::reconstruct(const T* data)
+  {
+    ColourMatrix ret;
+    for (unsigned int row = 0; row < 2; ++row) {
+      for (unsigned int col = 0; col < 3; ++col) {
+        ret(row, col) = std::complex<T>(data[0], data[1]);
+        data += 2;
+      }
+    }
+    ret(2, 0) = std::conj(ret(0, 1) * ret(1, 2) - ret(0, 2) * ret(1, 1));
+    ret(2, 1) = std::conj(ret(0, 2) * ret(1, 0) - ret(0, 0) * ret(1, 2));
+    ret(2, 2) = std::conj(ret(0, 0) * ret(1, 1) - ret(0, 1) * ret(1, 0));
+    return ret;
+  }
+}
+
+#endif
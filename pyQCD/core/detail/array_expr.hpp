@@ -5,11 +5,18 @@
  * temporaries do not need to be created when performing arithmetic operations.
  */
 
+#include <algorithm>
 #include <typeinfo>
 #include <type_traits>
 
+#include <utils/cpu_dispatch.hpp>
 #include <utils/macros.hpp>
+#include <utils/profiling.hpp>
+#ifdef PYQCD_SIMD_KERNEL_VARIANTS
+#include <utils/simd_kernels.hpp>
+#endif
 #include <utils/templates.hpp>
+#include <utils/thread_pool.hpp>
 
 #include "../layout.hpp"
 #include "array_traits.hpp"
@@ -35,7 +42,7 @@ namespace pyQCD
     // CRTP magic - call functions in the Array class
     typename ExprReturnTraits<T1, T2>::type operator[](const int i)
     { return static_cast<T1&>(*this)[i]; }
-    const typename ExprReturnTraits<T1, T2>::type operator[](const int i) const
+    typename ExprReturnTraits<T1, T2>::const_type operator[](const int i) const
     { return static_cast<const T1&>(*this)[i]; }
 
     unsigned long size() const { return static_cast<const T1&>(*this).size(); }
@@ -64,29 +71,131 @@ namespace pyQCD
   };
 
 
+  // Determines whether an operand is an Array (or Lattice) that's about to
+  // expire, the buffer of which may be reused to hold the result of an
+  // expression (see ArrayRvalue)
+  template <typename T>
+  struct IsArrayRvalue
+  {
+    static constexpr bool value = NestedArrayTraits<T>::is_array;
+  };
+
+
+  template <typename T>
+  struct IsArrayRvalue<T&>
+  {
+    static constexpr bool value = false;
+  };
+
+
+  template <typename T>
+  struct IsArrayRvalue<const T>
+  {
+    static constexpr bool value = false;
+  };
+
+
+  template <typename T>
+  class ArrayRvalue
+    : public ArrayExpr<ArrayRvalue<T>,
+        typename NestedArrayTraits<T>::value_type>
+  {
+    // Expression subclass for an Array operand that's about to expire. Like
+    // the Array itself, this refers to the operand rather than copying it, but
+    // allows the buffer to be taken over when the expression is evaluated.
+  public:
+    typedef typename NestedArrayTraits<T>::value_type value_type;
+
+    ArrayRvalue(T& array) : array_(array) { }
+    const value_type& operator[](const unsigned long i) const
+    { return array_[i]; }
+
+    unsigned long size() const { return array_.size(); }
+    const Layout* layout() const { return array_.layout(); }
+
+    T& array() const { return array_; }
+
+  private:
+    T& array_;
+  };
+
+
+  template <typename T1, typename T2, typename Op>
+  struct UnaryResultTraits
+  {
+    typedef typename ElementResultTraits<
+      decltype(Op::apply(std::declval<T2>())),
+      ElementTemporaryTraits<T1>::value>::type type;
+  };
+
+
+  template <typename T1, typename T2, typename T3, typename T4, typename Op>
+  struct BinaryResultTraits
+  {
+    typedef typename ElementResultTraits<
+      decltype(Op::apply(std::declval<T3>(), std::declval<T4>())),
+      ElementTemporaryTraits<T1>::value
+        or ElementTemporaryTraits<T2>::value>::type type;
+  };
+
+
   template <typename T1, typename T2, typename Op>
   class ArrayUnary
     : public ArrayExpr<ArrayUnary<T1, T2, Op>,
-        decltype(Op::apply(std::declval<T2>()))>
+        typename UnaryResultTraits<T1, T2, Op>::type>
   {
   public:
     ArrayUnary(const ArrayExpr<T1, T2>& operand) : operand_(operand) { }
 
-    const decltype(Op::apply(std::declval<T2>()))
+    const typename UnaryResultTraits<T1, T2, Op>::type
     operator[](const unsigned int i) const { return Op::apply(operand_[i]); }
 
     unsigned long size() const { return operand_.size(); }
     const Layout* layout() const { return operand_.layout(); }
 
+    const ArrayExpr<T1, T2>& operand() const { return operand_; }
+
   private:
     typename OperandTraits<T1>::type operand_;
   };
 
 
+  template <typename T1, typename T2, typename T3, typename T4, typename Op,
+            typename Enable = void>
+  struct BinaryElementTraits
+  {
+    // Computes element i of a binary expression from its operands. The
+    // result is converted here, while any temporary operand elements that an
+    // Eigen expression refers to are still alive.
+    template <typename U1, typename U2>
+    static typename BinaryResultTraits<T1, T2, T3, T4, Op>::type
+    apply(const U1& lhs, const U2& rhs, const unsigned long i)
+    { return Op::apply(lhs[i], rhs[i]); }
+  };
+
+
+  // x * y.adjoint(), where there's a generated kernel for the product of a
+  // matrix and an adjoint (see matrix_kernels.hpp), is computed with a single
+  // kernel call instead of forming the adjoint of y first
+  template <typename T1, typename T2, typename T3, typename T4, typename T5>
+  struct BinaryElementTraits<T1, ArrayUnary<T2, T3, Adjoint>, T4, T5,
+    Multiplies, typename std::enable_if<
+      MultiplyAdjointKernelTraits<T4, T3>::enabled and std::is_same<
+        typename MultiplyAdjointKernelTraits<T4, T3>::result_type,
+        typename BinaryResultTraits<T1, ArrayUnary<T2, T3, Adjoint>, T4, T5,
+          Multiplies>::type>::value>::type>
+  {
+    template <typename U1, typename U2>
+    static typename MultiplyAdjointKernelTraits<T4, T3>::result_type
+    apply(const U1& lhs, const U2& rhs, const unsigned long i)
+    { return Multiplies::apply_adjoint(lhs[i], rhs.operand()[i]); }
+  };
+
+
   template <typename T1, typename T2, typename T3, typename T4, typename Op>
   class ArrayBinary
     : public ArrayExpr<ArrayBinary<T1, T2, T3, T4, Op>,
-        decltype(Op::apply(std::declval<T3>(), std::declval<T4>()))>
+        typename BinaryResultTraits<T1, T2, T3, T4, Op>::type>
   {
   // Expression subclass for binary operations
   public:
@@ -98,22 +207,190 @@ namespace pyQCD
       pyQCDassert((BinaryOperandTraits<T1, T2>::equal_layout(lhs_, rhs_)),
         std::bad_cast());
     }
-    // Here we denote the actual arithmetic operation.
-    const decltype(Op::apply(std::declval<T3>(), std::declval<T4>()))
+    // Here we denote the actual arithmetic operation. If the operands'
+    // elements are temporaries, the result is evaluated (see
+    // ElementTemporaryTraits).
+    const typename BinaryResultTraits<T1, T2, T3, T4, Op>::type
     operator[](const unsigned long i) const
-    { return Op::apply(lhs_[i], rhs_[i]); }
+    { return BinaryElementTraits<T1, T2, T3, T4, Op>::apply(lhs_, rhs_, i); }
 
     unsigned long size() const
     { return BinaryOperandTraits<T1, T2>::size(lhs_, rhs_); }
     const Layout* layout() const
     { return BinaryOperandTraits<T1, T2>::layout(lhs_, rhs_); }
 
+    const ArrayExpr<T1, T3>& lhs() const { return lhs_; }
+    const ArrayExpr<T2, T4>& rhs() const { return rhs_; }
+
   private:
     // The members - the inputs to the binary operation
     typename OperandTraits<T1>::type lhs_;
     typename OperandTraits<T2>::type rhs_;
   };
 
+
+  template <typename T, typename U1, typename U2>
+  void assign_elements(T* ptr, const ArrayExpr<U1, U2>& expr,
+                       const unsigned long begin, const unsigned long end)
+  {
+    // Evaluate elements [begin, end) of expr into the corresponding elements
+    // of ptr
+    for (unsigned long i = begin; i < end; ++i) {
+      ElementAssignTraits<T>::assign(ptr[i], expr[i]);
+    }
+  }
+
+
+  template <typename T, typename U, typename Enable = void>
+  struct BatchKernelTraits
+  {
+    // Evaluates elements [begin, end) of an expression of type U into ptr
+    // with one of the batched kernels in simd_kernels.hpp, if there's one
+    // for the expression. Returns false if the elements weren't evaluated.
+    template <typename U1, typename U2>
+    static bool evaluate(T* ptr, const ArrayExpr<U1, U2>& expr,
+                         const unsigned long begin, const unsigned long end)
+    { return false; }
+  };
+
+
+#ifdef PYQCD_SIMD_KERNEL_VARIANTS
+  // The batched kernels are used for products of two arrays of SU(3)-sized
+  // matrices or of a matrix and a vector, and for products of a matrix and
+  // an adjoint, when the AVX variants were built and are supported by the
+  // CPU. The generic variant is no faster than the generated kernels.
+  namespace detail
+  {
+    template <typename T1, typename T2, typename T3, typename T4>
+    struct BatchKernelOperands
+    {
+      static constexpr bool value
+        = NestedArrayTraits<T1>::is_array and NestedArrayTraits<T2>::is_array
+        and std::is_same<T3, Eigen::Matrix<std::complex<double>, 3, 3> >::value
+        and (std::is_same<T4,
+               Eigen::Matrix<std::complex<double>, 3, 3> >::value
+             or std::is_same<T4,
+               Eigen::Matrix<std::complex<double>, 3, 1> >::value);
+    };
+
+
+    template <typename T1, typename T2, typename T3>
+    bool evaluate_batch(
+      simd::BatchKernel simd::Kernels::* kernel, T1* ptr,
+      const T2& lhs, const T3& rhs,
+      const unsigned long begin, const unsigned long end)
+    {
+      const simd::Kernels& kernels = simd_kernels();
+      if (kernels.level == SimdLevel::generic) {
+        return false;
+      }
+      if (begin < end) {
+        (kernels.*kernel)(reinterpret_cast<const double*>(&lhs[begin]),
+                          reinterpret_cast<const double*>(&rhs[begin]),
+                          reinterpret_cast<double*>(ptr + begin),
+                          end - begin);
+      }
+      return true;
+    }
+  }
+
+
+  template <typename T, typename T1, typename T2, typename T3, typename T4>
+  struct BatchKernelTraits<T, ArrayBinary<T1, T2, T3, T4, Multiplies>,
+    typename std::enable_if<
+      detail::BatchKernelOperands<T1, T2, T3, T4>::value
+      and std::is_same<T, T4>::value>::type>
+  {
+    template <typename U1, typename U2>
+    static bool evaluate(T* ptr, const ArrayExpr<U1, U2>& expr,
+                         const unsigned long begin, const unsigned long end)
+    {
+      const U1& product = expr;
+      return detail::evaluate_batch(
+        T4::ColsAtCompileTime == 1 ? &simd::Kernels::multiply_3x3_3x1
+                                   : &simd::Kernels::multiply_3x3,
+        ptr, static_cast<const T1&>(product.lhs()),
+        static_cast<const T2&>(product.rhs()), begin, end);
+    }
+  };
+
+
+  template <typename T, typename T1, typename T2, typename T3, typename T4>
+  struct BatchKernelTraits<T,
+    ArrayBinary<T1, ArrayUnary<T2, T3, Adjoint>, T3, T4, Multiplies>,
+    typename std::enable_if<
+      detail::BatchKernelOperands<T1, T2, T3, T3>::value
+      and std::is_same<T, T3>::value>::type>
+  {
+    template <typename U1, typename U2>
+    static bool evaluate(T* ptr, const ArrayExpr<U1, U2>& expr,
+                         const unsigned long begin, const unsigned long end)
+    {
+      const U1& product = expr;
+      return detail::evaluate_batch(
+        &simd::Kernels::multiply_adjoint_3x3, ptr,
+        static_cast<const T1&>(product.lhs()),
+        static_cast<const T2&>(
+          static_cast<const ArrayUnary<T2, T3, Adjoint>&>(product.rhs())
+          .operand()), begin, end);
+    }
+  };
+#endif
+
+
+  template <typename T, typename U1, typename U2>
+  void evaluate_elements(T* ptr, const ArrayExpr<U1, U2>& expr,
+                         const unsigned long begin, const unsigned long end,
+                         std::false_type)
+  {
+    if (BatchKernelTraits<T, U1>::evaluate(ptr, expr, begin, end)) {
+      return;
+    }
+    dispatch([&] () { assign_elements(ptr, expr, begin, end); });
+  }
+
+
+  template <typename T, typename U1, typename U2>
+  void evaluate_elements(T* ptr, const ArrayExpr<U1, U2>& expr,
+                         const unsigned long begin, const unsigned long end,
+                         std::true_type)
+  {
+    // Split the elements into one contiguous chunk per thread, as in
+    // parallel_for, giving each chunk to assign_elements in one call. Such
+    // expressions cost hundreds of flops per element, so a chunk of 64
+    // elements is enough to be worth a thread.
+    if (begin >= end) {
+      return;
+    }
+    const unsigned long size = end - begin;
+    run_on_thread_pool(
+      [&] (const unsigned int chunk, const unsigned int num_chunks) {
+        const unsigned long chunk_begin = begin + size * chunk / num_chunks;
+        const unsigned long chunk_end
+          = begin + size * (chunk + 1) / num_chunks;
+        dispatch([&] () {
+          assign_elements(ptr, expr, chunk_begin, chunk_end);
+        });
+      }, std::min<unsigned long>(size / 64, ~0u));
+  }
+
+
+  template <typename T, typename U1, typename U2>
+  void evaluate_elements(T* ptr, const ArrayExpr<U1, U2>& expr,
+                         const unsigned long begin, const unsigned long end)
+  {
+    // As assign_elements, but for whole arrays, so the loop is compiled for
+    // the best instruction set the CPU supports (see cpu_dispatch.hpp).
+    // Expressions that are expensive per element (see
+    // ParallelEvaluationTraits) are also evaluated in parallel. The cost is
+    // found by argument-dependent lookup (see expr_cost.hpp).
+    PYQCD_PROFILE_SCOPE_COST("Array evaluation",
+                             expression_cost(expr, begin, end).flops,
+                             expression_cost(expr, begin, end).bytes);
+    evaluate_elements(ptr, expr, begin, end,
+      std::integral_constant<bool, ParallelEvaluationTraits<U1>::value>());
+  }
+
   // Some macros for the operator overloads, as the code is almost
   // the same in each case. For the scalar multiplies I've used
   // some SFINAE to disable these more generalized functions when
@@ -151,6 +428,79 @@ namespace pyQCD
       (ArrayConst<T1>(scalar), array);  \
   }
 
+  // These overloads take Array operands that are about to expire, e.g. the
+  // result of std::move or a function returning an Array, and wrap them in an
+  // ArrayRvalue so that their buffer may be reused. As with the overloads
+  // above, the operands must outlive the expression.
+#define ARRAY_EXPR_RVALUE_OPERATOR(op, trait)                         \
+  template <typename T1, typename T2, typename T3,                    \
+    typename std::enable_if<                                          \
+      IsArrayRvalue<T1>::value>::type* = nullptr>                     \
+  const ArrayBinary<ArrayRvalue<T1>, T2,                              \
+    typename ArrayRvalue<T1>::value_type, T3, trait>                  \
+  operator op(T1&& lhs, const ArrayExpr<T2, T3>& rhs)                 \
+  {                                                                   \
+    return ArrayBinary<ArrayRvalue<T1>, T2,                           \
+      typename ArrayRvalue<T1>::value_type, T3, trait>                \
+      (ArrayRvalue<T1>(lhs), rhs);                                    \
+  }                                                                   \
+                                                                      \
+                                                                      \
+  template <typename T1, typename T2, typename T3,                    \
+    typename std::enable_if<                                          \
+      IsArrayRvalue<T2>::value>::type* = nullptr>                     \
+  const ArrayBinary<T1, ArrayRvalue<T2>, T3,                          \
+    typename ArrayRvalue<T2>::value_type, trait>                      \
+  operator op(const ArrayExpr<T1, T3>& lhs, T2&& rhs)                 \
+  {                                                                   \
+    return ArrayBinary<T1, ArrayRvalue<T2>, T3,                       \
+      typename ArrayRvalue<T2>::value_type, trait>                    \
+      (lhs, ArrayRvalue<T2>(rhs));                                    \
+  }                                                                   \
+                                                                      \
+                                                                      \
+  template <typename T1, typename T2,                                 \
+    typename std::enable_if<IsArrayRvalue<T1>::value                  \
+      and IsArrayRvalue<T2>::value>::type* = nullptr>                 \
+  const ArrayBinary<ArrayRvalue<T1>, ArrayRvalue<T2>,                 \
+    typename ArrayRvalue<T1>::value_type,                             \
+    typename ArrayRvalue<T2>::value_type, trait>                      \
+  operator op(T1&& lhs, T2&& rhs)                                     \
+  {                                                                   \
+    return ArrayBinary<ArrayRvalue<T1>, ArrayRvalue<T2>,              \
+      typename ArrayRvalue<T1>::value_type,                           \
+      typename ArrayRvalue<T2>::value_type, trait>                    \
+      (ArrayRvalue<T1>(lhs), ArrayRvalue<T2>(rhs));                   \
+  }                                                                   \
+                                                                      \
+                                                                      \
+  template <typename T1, typename T2,                                 \
+    typename std::enable_if<IsArrayRvalue<T1>::value                  \
+      and not std::is_base_of<ArrayObj, T2>::value>::type*            \
+      = nullptr>                                                      \
+  const ArrayBinary<ArrayRvalue<T1>, ArrayConst<T2>,                  \
+    typename ArrayRvalue<T1>::value_type, T2, trait>                  \
+  operator op(T1&& array, const T2& scalar)                           \
+  {                                                                   \
+    return ArrayBinary<ArrayRvalue<T1>, ArrayConst<T2>,               \
+      typename ArrayRvalue<T1>::value_type, T2, trait>                \
+      (ArrayRvalue<T1>(array), ArrayConst<T2>(scalar));               \
+  }
+
+#define ARRAY_EXPR_RVALUE_OPERATOR_REVERSE_SCALAR(op, trait)          \
+  template <typename T1, typename T2,                                 \
+    typename std::enable_if<IsArrayRvalue<T2>::value                  \
+      and not std::is_base_of<ArrayObj, T1>::value>::type*            \
+      = nullptr>                                                      \
+  const ArrayBinary<ArrayConst<T1>, ArrayRvalue<T2>, T1,              \
+    typename ArrayRvalue<T2>::value_type, trait>                      \
+  operator op(const T1& scalar, T2&& array)                           \
+  {                                                                   \
+    return ArrayBinary<ArrayConst<T1>, ArrayRvalue<T2>, T1,           \
+      typename ArrayRvalue<T2>::value_type, trait>                    \
+      (ArrayConst<T1>(scalar), ArrayRvalue<T2>(array));               \
+  }
+
 
   ARRAY_EXPR_OPERATOR(+, Plus);
   ARRAY_EXPR_OPERATOR_REVERSE_SCALAR(+, Plus);
@@ -158,6 +508,13 @@ namespace pyQCD
   ARRAY_EXPR_OPERATOR(*, Multiplies);
   ARRAY_EXPR_OPERATOR_REVERSE_SCALAR(*, Multiplies);
   ARRAY_EXPR_OPERATOR(/, Divides);
+
+  ARRAY_EXPR_RVALUE_OPERATOR(+, Plus);
+  ARRAY_EXPR_RVALUE_OPERATOR_REVERSE_SCALAR(+, Plus);
+  ARRAY_EXPR_RVALUE_OPERATOR(-, Minus);
+  ARRAY_EXPR_RVALUE_OPERATOR(*, Multiplies);
+  ARRAY_EXPR_RVALUE_OPERATOR_REVERSE_SCALAR(*, Multiplies);
+  ARRAY_EXPR_RVALUE_OPERATOR(/, Divides);
 }
 
 #endif
\ No newline at end of file
@@ -1,19 +1,69 @@
 #ifndef ARRAY_TRAITS_HPP
 #define ARRAY_TRAITS_HPP
 
+#include <memory>
+#include <type_traits>
+#include <utility>
+
 
 namespace pyQCD
 {
   template <typename T, template <typename> class Alloc, typename U>
   class Array;
 
+  template <typename T>
+  class ArrayView;
+
+  template <typename T, unsigned int N>
+  class FixedArray;
+
   template <typename T1, typename T2>
   class ArrayExpr;
 
   template <typename T>
   class ArrayConst;
 
-  template <typename T, template <typename> class Alloc>
+  template <typename T>
+  class ArrayRvalue;
+
+  template <typename T1, typename T2, typename Op>
+  class ArrayUnary;
+
+  template <typename T1, typename T2, typename T3, typename T4, typename Op>
+  class ArrayBinary;
+
+  // Traits to determine whether a type is derived from Array and, if so, the
+  // type and allocator of its elements. Lattices of such types store the
+  // elements of all sites in a single contiguous buffer (see lattice.hpp).
+  template <typename T>
+  struct ArrayBaseTraits
+  {
+    static constexpr bool is_array = false;
+  };
+
+
+  template <typename T1, template <typename> class A, typename T2>
+  struct ArrayBaseTraits<Array<T1, A, T2> >
+  {
+    static constexpr bool is_array = true;
+    typedef T1 value_type;
+    typedef A<T1> allocator_type;
+  };
+
+
+  std::false_type array_base_of(...);
+  template <typename T1, template <typename> class A, typename T2>
+  Array<T1, A, T2> array_base_of(const Array<T1, A, T2>*);
+
+
+  template <typename T>
+  struct NestedArrayTraits
+    : ArrayBaseTraits<decltype(array_base_of(std::declval<T*>()))>
+  { };
+
+
+  template <typename T, template <typename> class Alloc = std::allocator,
+    bool Nested = NestedArrayTraits<T>::is_array>
   class Lattice;
 
   // These traits classes allow us to switch between a const ref and simple
@@ -22,6 +72,7 @@ namespace pyQCD
   struct ExprReturnTraits
   {
     typedef T2 type;
+    typedef const T2 const_type;
   };
 
 
@@ -29,6 +80,31 @@ namespace pyQCD
   struct ExprReturnTraits<Array<T1, T2, T3>, T1>
   {
     typedef T1& type;
+    typedef const T1& const_type;
+  };
+
+
+  template <typename T1, typename T2>
+  struct ExprReturnTraits<ArrayView<T1>, T2>
+  {
+    typedef T1& type;
+    typedef const T1& const_type;
+  };
+
+
+  template <typename T1, typename T2>
+  struct ExprReturnTraits<ArrayRvalue<T1>, T2>
+  {
+    typedef const T2& type;
+    typedef const T2& const_type;
+  };
+
+
+  template <typename T, unsigned int N>
+  struct ExprReturnTraits<FixedArray<T, N>, T>
+  {
+    typedef T& type;
+    typedef const T& const_type;
   };
 
 
@@ -47,6 +123,37 @@ namespace pyQCD
     typedef ArrayConst<T> type;
   };
 
+
+  template <typename T>
+  struct OperandTraits<ArrayView<T> >
+  {
+    typedef ArrayView<T> type;
+  };
+
+
+  template <typename T>
+  struct OperandTraits<ArrayRvalue<T> >
+  {
+    typedef ArrayRvalue<T> type;
+  };
+
+
+  // Expressions over non-scalar site types (e.g. Lattice<FixedArray<T, N> >)
+  // produce expressions for each site, which are temporaries, so these are
+  // held by value when they're operands of another expression.
+  template <typename T1, typename T2, typename Op>
+  struct OperandTraits<ArrayUnary<T1, T2, Op> >
+  {
+    typedef ArrayUnary<T1, T2, Op> type;
+  };
+
+
+  template <typename T1, typename T2, typename T3, typename T4, typename Op>
+  struct OperandTraits<ArrayBinary<T1, T2, T3, T4, Op> >
+  {
+    typedef ArrayBinary<T1, T2, T3, T4, Op> type;
+  };
+
   // Traits to check first whether supplied type is a Lattice, then get the
   // layout from the supplied object, if applicable
   template <typename T>
@@ -128,6 +235,185 @@ namespace pyQCD
     static bool equal_layout(const ArrayConst<T1>& lhs, const T2& rhs)
     { return true; }
   };
+
+
+  // Traits to determine whether each element of an expression depends only on
+  // the elements of its operands at the same index. This holds for Array
+  // operands and the node types listed here. Any other node, e.g. a stencil,
+  // which reads neighbouring sites, makes the whole expression fail the test.
+  template <typename T>
+  struct ElementwiseTraits
+    : std::integral_constant<bool, NestedArrayTraits<T>::is_array>
+  { };
+
+
+  template <typename T>
+  struct ElementwiseTraits<ArrayConst<T> > : std::true_type { };
+
+
+  template <typename T>
+  struct ElementwiseTraits<ArrayRvalue<T> > : std::true_type { };
+
+
+  template <typename T1, typename T2, typename Op>
+  struct ElementwiseTraits<ArrayUnary<T1, T2, Op> > : ElementwiseTraits<T1>
+  { };
+
+
+  template <typename T1, typename T2, typename T3, typename T4, typename Op>
+  struct ElementwiseTraits<ArrayBinary<T1, T2, T3, T4, Op> >
+    : std::integral_constant<bool, ElementwiseTraits<T1>::value
+                                   and ElementwiseTraits<T2>::value>
+  { };
+
+
+  // Traits to determine whether an expression is expensive enough per element
+  // to be evaluated in parallel (see evaluate_elements). Expensive node types
+  // (e.g. StencilExpr) specialise this to be true, which then carries through
+  // the unary and binary nodes above them.
+  template <typename T>
+  struct ParallelEvaluationTraits : std::false_type { };
+
+
+  template <typename T1, typename T2, typename Op>
+  struct ParallelEvaluationTraits<ArrayUnary<T1, T2, Op> >
+    : ParallelEvaluationTraits<T1>
+  { };
+
+
+  template <typename T1, typename T2, typename T3, typename T4, typename Op>
+  struct ParallelEvaluationTraits<ArrayBinary<T1, T2, T3, T4, Op> >
+    : std::integral_constant<bool, ParallelEvaluationTraits<T1>::value
+                                   or ParallelEvaluationTraits<T2>::value>
+  { };
+
+
+  // Traits to find the buffer of an Array operand that's about to expire (see
+  // ArrayRvalue) and that has the specified storage type, so that it can be
+  // reused to hold the result of an expression. Returns nullptr if there is no
+  // such operand, or if the expression isn't elementwise (see
+  // ElementwiseTraits), since writing to the buffer could then change
+  // elements that have yet to be read.
+  template <typename T>
+  struct BufferTraits
+  {
+    template <typename Storage>
+    static Storage* get(const T& expr) { return nullptr; }
+  };
+
+
+  template <typename T>
+  struct BufferTraits<ArrayRvalue<T> >
+  {
+    template <typename Storage>
+    static Storage* get(const ArrayRvalue<T>& expr)
+    {
+      return get<Storage>(
+        expr, std::is_same<Storage, typename T::storage_type>());
+    }
+
+  private:
+    template <typename Storage>
+    static Storage* get(const ArrayRvalue<T>& expr, std::true_type)
+    { return &expr.array().data_; }
+    template <typename Storage>
+    static Storage* get(const ArrayRvalue<T>& expr, std::false_type)
+    { return nullptr; }
+  };
+
+
+  template <typename T1, typename T2, typename Op>
+  struct BufferTraits<ArrayUnary<T1, T2, Op> >
+  {
+    template <typename Storage>
+    static Storage* get(const ArrayUnary<T1, T2, Op>& expr)
+    {
+      if (not ElementwiseTraits<ArrayUnary<T1, T2, Op> >::value) {
+        return nullptr;
+      }
+      return BufferTraits<T1>::template get<Storage>(expr.operand());
+    }
+  };
+
+
+  template <typename T1, typename T2, typename T3, typename T4, typename Op>
+  struct BufferTraits<ArrayBinary<T1, T2, T3, T4, Op> >
+  {
+    template <typename Storage>
+    static Storage* get(const ArrayBinary<T1, T2, T3, T4, Op>& expr)
+    {
+      if (not ElementwiseTraits<ArrayBinary<T1, T2, T3, T4, Op> >::value) {
+        return nullptr;
+      }
+      Storage* ret = BufferTraits<T1>::template get<Storage>(expr.lhs());
+      return ret ? ret : BufferTraits<T2>::template get<Storage>(expr.rhs());
+    }
+  };
+
+
+  // Determines whether a type is a plain Eigen object, i.e. one that owns its
+  // coefficients rather than being an expression
+  template <typename T, typename Enable = void>
+  struct IsPlainObject : std::false_type { };
+
+
+  template <typename T>
+  struct IsPlainObject<T, typename std::enable_if<
+    std::is_same<T, typename T::PlainObject>::value>::type>
+    : std::true_type { };
+
+
+  // Determines whether the elements of an expression are plain Eigen objects
+  // returned by value (e.g. the results of matrix kernels or stencils). Eigen
+  // expressions refer to plain operands rather than copying them, so element
+  // operations involving these must be evaluated before the element goes out
+  // of scope.
+  template <typename T>
+  struct ElementTemporaryTraits
+  {
+    typedef decltype(std::declval<const T&>()[0]) element_type;
+    static constexpr bool value = not std::is_reference<element_type>::value
+      and IsPlainObject<typename std::decay<element_type>::type>::value;
+  };
+
+
+  // Traits to assign the elements of an expression to the elements of an
+  // array. Converting an Eigen expression to the destination type with
+  // static_cast evaluates it into a temporary matrix, which is then copied, so
+  // plain Eigen destinations are assigned the expression directly instead.
+  // Eigen still forms products in a temporary, as the destination could be a
+  // factor. Using noalias() where it provably isn't was measured to be slower
+  // for the small fixed-size matrices stored in arrays (the temporary stays in
+  // registers), so it isn't used.
+  template <typename T, typename Enable = void>
+  struct ElementAssignTraits
+  {
+    template <typename U>
+    static void assign(T& dest, const U& src) { dest = static_cast<T>(src); }
+  };
+
+
+  template <typename T>
+  struct ElementAssignTraits<T, typename std::enable_if<
+    IsPlainObject<T>::value>::type>
+  {
+    template <typename U>
+    static void assign(T& dest, const U& src) { dest = src; }
+  };
+
+
+  template <typename T, bool Eval>
+  struct ElementResultTraits
+  {
+    typedef T type;
+  };
+
+
+  template <typename T>
+  struct ElementResultTraits<T, true>
+  {
+    typedef typename std::decay<T>::type::PlainObject type;
+  };
 }
 
-#endif
\ No newline at end of file
+#endif
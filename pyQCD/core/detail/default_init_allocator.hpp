@@ -0,0 +1,48 @@
+#ifndef DEFAULT_INIT_ALLOCATOR_HPP
+#define DEFAULT_INIT_ALLOCATOR_HPP
+
+/* This file provides an allocator adaptor that default-initialises elements
+ * instead of value-initialising them when a container is resized. For
+ * arithmetic types this means the memory is left uninitialised, so a buffer
+ * that is about to be overwritten (e.g. the result of an expression) is only
+ * written once. Construction with arguments is unaffected.
+ */
+
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace pyQCD
+{
+  template <typename A>
+  class DefaultInitAllocator : public A
+  {
+    typedef std::allocator_traits<A> Traits;
+
+  public:
+    template <typename U>
+    struct rebind
+    {
+      typedef DefaultInitAllocator<
+        typename Traits::template rebind_alloc<U> > other;
+    };
+
+    DefaultInitAllocator() = default;
+    DefaultInitAllocator(const A& alloc) : A(alloc) { }
+    template <typename B>
+    DefaultInitAllocator(const DefaultInitAllocator<B>& alloc) : A(alloc) { }
+
+    template <typename U>
+    void construct(U* ptr)
+      noexcept(std::is_nothrow_default_constructible<U>::value)
+    { ::new(static_cast<void*>(ptr)) U; }
+    template <typename U, typename... Args>
+    void construct(U* ptr, Args&&... args)
+    { Traits::construct(static_cast<A&>(*this), ptr,
+                        std::forward<Args>(args)...); }
+  };
+}
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef ELEMENT_COST_HPP
+#define ELEMENT_COST_HPP
+
+/* This file provides the compile-time cost, in real floating point operations,
+ * of the arithmetic the operators in operators.hpp carry out on array
+ * elements, and the storage size of the elements themselves.
+ *
+ * Complex additions count as two flops, complex multiplications as six and
+ * complex divisions as eleven. A product of a real and a complex number costs
+ * two. Matrix products are counted as the naive algorithm, i.e. an n x k by
+ * k x m product costs n * m * (k multiplications + (k - 1) additions).
+ * Conjugation and transposition are free.
+ *
+ * Elements whose shape isn't known at compile time (e.g. dynamic Eigen
+ * matrices or the sites of nested lattices) have zero cost.
+ */
+
+#include <complex>
+#include <type_traits>
+
+#include <Eigen/Dense>
+
+
+namespace pyQCD
+{
+  template <typename T, typename Enable = void>
+  struct ElementCostTraits
+  {
+    // Element types that aren't understood
+    static constexpr bool known = false;
+    static constexpr bool is_scalar = false;
+    static constexpr bool is_complex = false;
+    static constexpr long rows = 0;
+    static constexpr long cols = 0;
+    static constexpr long bytes = 0;
+  };
+
+
+  template <typename T>
+  struct ElementCostTraits<
+    T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+  {
+    static constexpr bool known = true;
+    static constexpr bool is_scalar = true;
+    static constexpr bool is_complex = false;
+    static constexpr long rows = 1;
+    static constexpr long cols = 1;
+    static constexpr long bytes = sizeof(T);
+  };
+
+
+  template <typename T>
+  struct ElementCostTraits<std::complex<T> >
+  {
+    static constexpr bool known = true;
+    static constexpr bool is_scalar = true;
+    static constexpr bool is_complex = true;
+    static constexpr long rows = 1;
+    static constexpr long cols = 1;
+    static constexpr long bytes = sizeof(std::complex<T>);
+  };
+
+
+  template <typename T>
+  struct ElementCostTraits<
+    T, typename std::enable_if<
+      std::is_base_of<Eigen::EigenBase<T>, T>::value>::type>
+  {
+    // Eigen matrices and the (unevaluated) expressions built from them
+    typedef typename T::Scalar Scalar;
+    static constexpr bool known
+      = T::RowsAtCompileTime > 0 and T::ColsAtCompileTime > 0;
+    static constexpr bool is_scalar = false;
+    static constexpr bool is_complex = Eigen::NumTraits<Scalar>::IsComplex;
+    static constexpr long rows = known ? T::RowsAtCompileTime : 0;
+    static constexpr long cols = known ? T::ColsAtCompileTime : 0;
+    static constexpr long bytes = rows * cols * sizeof(Scalar);
+  };
+
+
+  template <typename T>
+  struct ElementCostTraits<const T> : ElementCostTraits<T> { };
+
+
+  template <typename T>
+  struct ElementCostTraits<T&> : ElementCostTraits<T> { };
+
+
+  namespace detail
+  {
+    // Costs of operations on the (real or complex) scalars of two elements
+    template <typename T1, typename T2>
+    constexpr long scalar_add_flops()
+    {
+      return ElementCostTraits<T1>::is_complex
+        and ElementCostTraits<T2>::is_complex ? 2 : 1;
+    }
+
+
+    template <typename T1, typename T2>
+    constexpr long scalar_multiply_flops()
+    {
+      return ElementCostTraits<T1>::is_complex
+        and ElementCostTraits<T2>::is_complex ? 6
+        : (ElementCostTraits<T1>::is_complex
+           or ElementCostTraits<T2>::is_complex ? 2 : 1);
+    }
+
+
+    template <typename T1, typename T2>
+    constexpr long scalar_divide_flops()
+    {
+      return ElementCostTraits<T2>::is_complex ? 11
+        : (ElementCostTraits<T1>::is_complex ? 2 : 1);
+    }
+
+
+    template <typename T>
+    constexpr long element_size()
+    { return ElementCostTraits<T>::rows * ElementCostTraits<T>::cols; }
+
+
+    template <typename T1, typename T2>
+    constexpr bool costs_known()
+    { return ElementCostTraits<T1>::known and ElementCostTraits<T2>::known; }
+
+
+    template <typename T1, typename T2>
+    constexpr long addition_flops()
+    {
+      // Element-wise, where one operand may be a scalar
+      return not costs_known<T1, T2>() ? 0
+        : (element_size<T1>() > element_size<T2>()
+           ? element_size<T1>() : element_size<T2>())
+          * scalar_add_flops<T1, T2>();
+    }
+
+
+    template <typename T1, typename T2>
+    constexpr long multiplication_flops()
+    {
+      // Scaling if either operand is a scalar, otherwise a matrix product
+      return not costs_known<T1, T2>() ? 0
+        : ElementCostTraits<T1>::is_scalar
+          ? element_size<T2>() * scalar_multiply_flops<T1, T2>()
+        : ElementCostTraits<T2>::is_scalar
+          ? element_size<T1>() * scalar_multiply_flops<T1, T2>()
+        : ElementCostTraits<T1>::rows * ElementCostTraits<T2>::cols
+          * (ElementCostTraits<T1>::cols * scalar_multiply_flops<T1, T2>()
+             + (ElementCostTraits<T1>::cols - 1) * scalar_add_flops<T1, T2>());
+    }
+
+
+    template <typename T1, typename T2>
+    constexpr long division_flops()
+    {
+      // Element-wise division by a scalar
+      return not costs_known<T1, T2>() ? 0
+        : element_size<T1>() * scalar_divide_flops<T1, T2>();
+    }
+  }
+}
+
+#endif
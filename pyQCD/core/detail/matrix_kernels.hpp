@@ -0,0 +1,272 @@
+#ifndef MATRIX_KERNELS_HPP
+#define MATRIX_KERNELS_HPP
+
+/* This file provides kernels for operations on small, fixed-size complex
+ * matrices: multiplication, multiplication by an adjoint, adjoints, traces
+ * and reunitarization.
+ *
+ * GenericMatrixKernel implements these for any shape using loops with
+ * compile-time bounds. The code generator (see utils/codegen.py and
+ * templates/core/kernels.hpp) emits explicit specializations of MatrixKernel
+ * for each configured matrix shape. These operate on the real and imaginary
+ * parts directly, which avoids the overhead of std::complex multiplication,
+ * and accumulate products a column at a time so that the compiler can
+ * vectorise down the columns (see benchmarks/bench_matrix_kernels.cpp for a
+ * comparison with Eigen). The generator also specializes
+ * MultiplyKernelEnabled, MultiplyAdjointKernelEnabled and AdjointKernelEnabled
+ * for each shape it provides, at which point the Multiplies and Adjoint
+ * operators in operators.hpp dispatch to the kernels automatically, as do the
+ * multiply, multiply_adjoint and adjoint functions below, which are intended
+ * for hand-written loops.
+ *
+ * The generated kernels are included at the end of this file if
+ * PYQCD_GENERATED_KERNELS is defined. The CMake build renders them into the
+ * build tree for 3x3, 3x1, 12x12 and 12x1 matrices.
+ */
+
+#include <complex>
+#include <type_traits>
+
+#include <Eigen/Dense>
+
+
+namespace pyQCD
+{
+  template <typename Scalar, int Rows, int Cols>
+  struct GenericMatrixKernel
+  {
+    typedef Eigen::Matrix<Scalar, Rows, Cols> MatrixType;
+    typedef typename Eigen::NumTraits<Scalar>::Real Real;
+
+    // out = lhs * rhs
+    template <int OtherCols>
+    static void multiply(const MatrixType& lhs,
+                         const Eigen::Matrix<Scalar, Cols, OtherCols>& rhs,
+                         Eigen::Matrix<Scalar, Rows, OtherCols>& out)
+    {
+      for (int j = 0; j < OtherCols; ++j) {
+        for (int i = 0; i < Rows; ++i) {
+          Scalar sum = lhs(i, 0) * rhs(0, j);
+          for (int k = 1; k < Cols; ++k) {
+            sum += lhs(i, k) * rhs(k, j);
+          }
+          out(i, j) = sum;
+        }
+      }
+    }
+
+    // out = lhs * rhs^dag
+    template <int OtherRows>
+    static void multiply_adjoint(
+      const MatrixType& lhs, const Eigen::Matrix<Scalar, OtherRows, Cols>& rhs,
+      Eigen::Matrix<Scalar, Rows, OtherRows>& out)
+    {
+      for (int j = 0; j < OtherRows; ++j) {
+        for (int i = 0; i < Rows; ++i) {
+          Scalar sum = lhs(i, 0) * std::conj(rhs(j, 0));
+          for (int k = 1; k < Cols; ++k) {
+            sum += lhs(i, k) * std::conj(rhs(j, k));
+          }
+          out(i, j) = sum;
+        }
+      }
+    }
+
+    static void adjoint(const MatrixType& mat,
+                        Eigen::Matrix<Scalar, Cols, Rows>& out)
+    {
+      for (int j = 0; j < Cols; ++j) {
+        for (int i = 0; i < Rows; ++i) {
+          out(j, i) = std::conj(mat(i, j));
+        }
+      }
+    }
+
+    static Scalar trace(const MatrixType& mat)
+    {
+      static_assert(Rows == Cols, "trace requires a square matrix");
+      Scalar ret = mat(0, 0);
+      for (int i = 1; i < Rows; ++i) {
+        ret += mat(i, i);
+      }
+      return ret;
+    }
+
+    static void reunitarize(MatrixType& mat)
+    {
+      // Modified Gram-Schmidt on the rows, then fix the phase of the last row
+      // so that the determinant is one
+      static_assert(Rows == Cols, "reunitarize requires a square matrix");
+      for (int i = 0; i < Rows; ++i) {
+        for (int j = 0; j < i; ++j) {
+          const Scalar proj = mat.row(j).dot(mat.row(i));
+          mat.row(i) -= proj * mat.row(j);
+        }
+        mat.row(i) /= mat.row(i).norm();
+      }
+      const Scalar det = mat.determinant();
+      mat.row(Rows - 1) *= std::conj(det) / std::abs(det);
+    }
+  };
+
+
+  template <typename Scalar, int Rows, int Cols>
+  struct MatrixKernel : GenericMatrixKernel<Scalar, Rows, Cols>
+  {
+    static constexpr bool specialised = false;
+  };
+
+
+  // Traits specifying whether the generated kernels should be used for the
+  // product of a (Rows x Inner) and an (Inner x Cols) matrix, and for the
+  // adjoint of a (Rows x Cols) matrix.
+  template <typename Scalar, int Rows, int Inner, int Cols>
+  struct MultiplyKernelEnabled : std::false_type { };
+
+  template <typename Scalar, int Rows, int Cols>
+  struct AdjointKernelEnabled : std::false_type { };
+
+  // As MultiplyKernelEnabled, but for the product of a (Rows x Inner) matrix
+  // and the adjoint of a (Cols x Inner) matrix
+  template <typename Scalar, int Rows, int Inner, int Cols>
+  struct MultiplyAdjointKernelEnabled : std::false_type { };
+
+
+  template <typename T1, typename T2>
+  struct MultiplyKernelTraits
+  {
+    static constexpr bool enabled = false;
+  };
+
+
+  template <typename Scalar, int R, int K, int C, int O1, int O2>
+  struct MultiplyKernelTraits<Eigen::Matrix<Scalar, R, K, O1, R, K>,
+                              Eigen::Matrix<Scalar, K, C, O2, K, C> >
+  {
+    static constexpr bool enabled
+      = MultiplyKernelEnabled<Scalar, R, K, C>::value
+      and not (O1 & Eigen::RowMajor) and not (O2 & Eigen::RowMajor);
+    typedef Eigen::Matrix<Scalar, R, C> result_type;
+    typedef MatrixKernel<Scalar, R, K> kernel_type;
+  };
+
+
+  template <typename T1, typename T2>
+  struct MultiplyAdjointKernelTraits
+  {
+    static constexpr bool enabled = false;
+  };
+
+
+  template <typename Scalar, int R, int K, int C, int O1, int O2>
+  struct MultiplyAdjointKernelTraits<Eigen::Matrix<Scalar, R, K, O1, R, K>,
+                                     Eigen::Matrix<Scalar, C, K, O2, C, K> >
+  {
+    static constexpr bool enabled
+      = MultiplyAdjointKernelEnabled<Scalar, R, K, C>::value
+      and not (O1 & Eigen::RowMajor) and not (O2 & Eigen::RowMajor);
+    typedef Eigen::Matrix<Scalar, R, C> result_type;
+    typedef MatrixKernel<Scalar, R, K> kernel_type;
+  };
+
+
+  template <typename T>
+  struct AdjointKernelTraits
+  {
+    static constexpr bool enabled = false;
+  };
+
+
+  template <typename Scalar, int R, int C, int O>
+  struct AdjointKernelTraits<Eigen::Matrix<Scalar, R, C, O, R, C> >
+  {
+    static constexpr bool enabled
+      = AdjointKernelEnabled<Scalar, R, C>::value
+      and not (O & Eigen::RowMajor);
+    typedef Eigen::Matrix<Scalar, C, R> result_type;
+    typedef MatrixKernel<Scalar, R, C> kernel_type;
+  };
+
+
+  namespace detail
+  {
+    template <typename Scalar, int R, int K, int C>
+    void multiply(const Eigen::Matrix<Scalar, R, K>& lhs,
+                  const Eigen::Matrix<Scalar, K, C>& rhs,
+                  Eigen::Matrix<Scalar, R, C>& out, std::true_type)
+    { MatrixKernel<Scalar, R, K>::multiply(lhs, rhs, out); }
+
+
+    template <typename Scalar, int R, int K, int C>
+    void multiply(const Eigen::Matrix<Scalar, R, K>& lhs,
+                  const Eigen::Matrix<Scalar, K, C>& rhs,
+                  Eigen::Matrix<Scalar, R, C>& out, std::false_type)
+    { out.noalias() = lhs * rhs; }
+
+
+    template <typename Scalar, int R, int K, int C>
+    void multiply_adjoint(const Eigen::Matrix<Scalar, R, K>& lhs,
+                          const Eigen::Matrix<Scalar, C, K>& rhs,
+                          Eigen::Matrix<Scalar, R, C>& out, std::true_type)
+    { MatrixKernel<Scalar, R, K>::multiply_adjoint(lhs, rhs, out); }
+
+
+    template <typename Scalar, int R, int K, int C>
+    void multiply_adjoint(const Eigen::Matrix<Scalar, R, K>& lhs,
+                          const Eigen::Matrix<Scalar, C, K>& rhs,
+                          Eigen::Matrix<Scalar, R, C>& out, std::false_type)
+    { out.noalias() = lhs * rhs.adjoint(); }
+
+
+    template <typename Scalar, int R, int C>
+    void adjoint(const Eigen::Matrix<Scalar, R, C>& mat,
+                 Eigen::Matrix<Scalar, C, R>& out, std::true_type)
+    { MatrixKernel<Scalar, R, C>::adjoint(mat, out); }
+
+
+    template <typename Scalar, int R, int C>
+    void adjoint(const Eigen::Matrix<Scalar, R, C>& mat,
+                 Eigen::Matrix<Scalar, C, R>& out, std::false_type)
+    { out = mat.adjoint(); }
+  }
+
+
+  // out = lhs * rhs, using the generated kernel if there is one and Eigen
+  // otherwise. out must not alias lhs or rhs.
+  template <typename Scalar, int R, int K, int C>
+  void multiply(const Eigen::Matrix<Scalar, R, K>& lhs,
+                const Eigen::Matrix<Scalar, K, C>& rhs,
+                Eigen::Matrix<Scalar, R, C>& out)
+  {
+    detail::multiply(lhs, rhs, out,
+                     typename MultiplyKernelEnabled<Scalar, R, K, C>::type());
+  }
+
+
+  // out = lhs * rhs^dag, as multiply above
+  template <typename Scalar, int R, int K, int C>
+  void multiply_adjoint(const Eigen::Matrix<Scalar, R, K>& lhs,
+                        const Eigen::Matrix<Scalar, C, K>& rhs,
+                        Eigen::Matrix<Scalar, R, C>& out)
+  {
+    detail::multiply_adjoint(
+      lhs, rhs, out,
+      typename MultiplyAdjointKernelEnabled<Scalar, R, K, C>::type());
+  }
+
+
+  // out = mat^dag, as multiply above
+  template <typename Scalar, int R, int C>
+  void adjoint(const Eigen::Matrix<Scalar, R, C>& mat,
+               Eigen::Matrix<Scalar, C, R>& out)
+  {
+    detail::adjoint(mat, out,
+                    typename AdjointKernelEnabled<Scalar, R, C>::type());
+  }
+}
+
+#ifdef PYQCD_GENERATED_KERNELS
+#include <core/kernels.hpp>
+#endif
+
+#endif
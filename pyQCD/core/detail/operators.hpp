@@ -1,7 +1,23 @@
 #ifndef OPERATORS_HPP
 #define OPERATORS_HPP
 
-/* Defines operators for use in Array expression classes */
+/* Defines operators for use in Array expression classes
+ *
+ * Where a generated small-matrix kernel is available for the operand types
+ * (see matrix_kernels.hpp), Multiplies and Adjoint use it in preference to
+ * Eigen's generic implementation. Multiplies::apply_adjoint computes
+ * lhs * rhs^dag in one kernel call, and is used by ArrayBinary for products
+ * with an adjoint (see BinaryElementTraits in array_expr.hpp).
+ *
+ * Each operator also provides flops<T...>(), the number of real floating point
+ * operations it performs on elements of the given types, computed at compile
+ * time (see element_cost.hpp and expr_cost.hpp).
+ */
+
+#include <type_traits>
+
+#include "element_cost.hpp"
+#include "matrix_kernels.hpp"
 
 
 struct Plus
@@ -9,6 +25,10 @@ struct Plus
   template <typename T1, typename T2>
   static auto apply(const T1& lhs, const T2& rhs) -> decltype(lhs + rhs)
   { return lhs + rhs; }
+
+  template <typename T1, typename T2>
+  static constexpr long flops()
+  { return pyQCD::detail::addition_flops<T1, T2>(); }
 };
 
 
@@ -17,14 +37,45 @@ struct Minus
   template <typename T1, typename T2>
   static auto apply(const T1& lhs, const T2& rhs) -> decltype(lhs - rhs)
   { return lhs - rhs; }
+
+  template <typename T1, typename T2>
+  static constexpr long flops()
+  { return pyQCD::detail::addition_flops<T1, T2>(); }
 };
 
 
 struct Multiplies
 {
-  template <typename T1, typename T2>
+  template <typename T1, typename T2,
+    typename std::enable_if<
+      not pyQCD::MultiplyKernelTraits<T1, T2>::enabled>::type* = nullptr>
   static auto apply(const T1& lhs, const T2& rhs) -> decltype(lhs * rhs)
   { return lhs * rhs; }
+
+  template <typename T1, typename T2,
+    typename std::enable_if<
+      pyQCD::MultiplyKernelTraits<T1, T2>::enabled>::type* = nullptr>
+  static typename pyQCD::MultiplyKernelTraits<T1, T2>::result_type
+  apply(const T1& lhs, const T2& rhs)
+  {
+    typename pyQCD::MultiplyKernelTraits<T1, T2>::result_type ret;
+    pyQCD::MultiplyKernelTraits<T1, T2>::kernel_type::multiply(lhs, rhs, ret);
+    return ret;
+  }
+
+  template <typename T1, typename T2>
+  static typename pyQCD::MultiplyAdjointKernelTraits<T1, T2>::result_type
+  apply_adjoint(const T1& lhs, const T2& rhs)
+  {
+    typename pyQCD::MultiplyAdjointKernelTraits<T1, T2>::result_type ret;
+    pyQCD::MultiplyAdjointKernelTraits<T1, T2>::kernel_type::multiply_adjoint(
+      lhs, rhs, ret);
+    return ret;
+  }
+
+  template <typename T1, typename T2>
+  static constexpr long flops()
+  { return pyQCD::detail::multiplication_flops<T1, T2>(); }
 };
 
 
@@ -33,14 +84,35 @@ struct Divides
   template <typename T1, typename T2>
   static auto apply(const T1& lhs, const T2& rhs) -> decltype(lhs / rhs)
   { return lhs / rhs; }
+
+  template <typename T1, typename T2>
+  static constexpr long flops()
+  { return pyQCD::detail::division_flops<T1, T2>(); }
 };
 
 
 struct Adjoint
 {
-  template <typename T>
+  template <typename T,
+    typename std::enable_if<
+      not pyQCD::AdjointKernelTraits<T>::enabled>::type* = nullptr>
   static auto apply(const T& operand) -> decltype(operand.adjoint())
   { return operand.adjoint(); }
+
+  template <typename T,
+    typename std::enable_if<
+      pyQCD::AdjointKernelTraits<T>::enabled>::type* = nullptr>
+  static typename pyQCD::AdjointKernelTraits<T>::result_type
+  apply(const T& operand)
+  {
+    typename pyQCD::AdjointKernelTraits<T>::result_type ret;
+    pyQCD::AdjointKernelTraits<T>::kernel_type::adjoint(operand, ret);
+    return ret;
+  }
+
+  // Conjugation is a sign change, which isn't counted
+  template <typename T>
+  static constexpr long flops() { return 0; }
 };
 
-#endif
\ No newline at end of file
+#endif
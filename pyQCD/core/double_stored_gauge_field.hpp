@@ -0,0 +1,134 @@
+#ifndef DOUBLE_STORED_GAUGE_FIELD_HPP
+#define DOUBLE_STORED_GAUGE_FIELD_HPP
+
+/* This file provides a double-stored gauge field representation. For each site
+ * x both the forward links U_mu(x) and the adjoint backward links
+ * U_mu^dag(x - mu) are stored, contiguously, along with the array indices of
+ * the neighbouring sites. The sites are ordered according to a Layout chosen
+ * by the caller, which should match the order in which an operator traverses
+ * the lattice. Hopping terms can then stream through the links for all
+ * 2 * num_dims directions sequentially without evaluating any adjoints.
+ *
+ * The links may optionally be generated by a callable, which allows phases
+ * (e.g. staggered phases or boundary conditions) to be folded into the links
+ * before they're stored. Links spanning more than one site (e.g. Naik links)
+ * are supported by specifying the number of hops.
+ *
+ * For compatibility with kernels written for Lattice<MatrixArray<N, N> >,
+ * links[index][mu] is the forward link U_mu(x) and
+ * links[index][num_dims + mu] is the backward link U_mu^dag(x - mu).
+ */
+
+#include <complex>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "lattice.hpp"
+#include "layout.hpp"
+#include "matrix_array.hpp"
+
+
+namespace pyQCD
+{
+  template <int N, typename T = double>
+  class DoubleStoredGaugeField
+  {
+  public:
+    typedef Lattice<MatrixArray<N, N, T> > GaugeField;
+    typedef Eigen::Matrix<std::complex<T>, N, N> ColourMatrix;
+
+    DoubleStoredGaugeField() : layout_(nullptr), num_dims_(0), hops_(0) { }
+    DoubleStoredGaugeField(const GaugeField& links, const Layout& layout,
+                           const unsigned int hops = 1);
+    // Construct using a callable with signature
+    // ColourMatrix (const unsigned int site_index, const unsigned int mu)
+    // that returns the forward link at the specified lexicographic site index
+    template <typename Fn>
+    DoubleStoredGaugeField(const Layout& layout, const unsigned int num_dims,
+                           const unsigned int hops, Fn compute_link);
+
+    const ColourMatrix* operator[](const unsigned int index) const
+    { return &links_[index * 2 * num_dims_]; }
+
+    const ColourMatrix& forward(const unsigned int index,
+                                const unsigned int mu) const
+    { return links_[index * 2 * num_dims_ + mu]; }
+    const ColourMatrix& backward(const unsigned int index,
+                                 const unsigned int mu) const
+    { return links_[index * 2 * num_dims_ + num_dims_ + mu]; }
+    // Array indices of x + hops * mu and x - hops * mu
+    unsigned int fwd_neighbour(const unsigned int index,
+                               const unsigned int mu) const
+    { return neighbours_[index * 2 * num_dims_ + mu]; }
+    unsigned int bwd_neighbour(const unsigned int index,
+                               const unsigned int mu) const
+    { return neighbours_[index * 2 * num_dims_ + num_dims_ + mu]; }
+
+    unsigned long size() const { return layout_->volume(); }
+    unsigned int volume() const { return layout_->volume(); }
+    unsigned int num_dims() const { return num_dims_; }
+    unsigned int hops() const { return hops_; }
+    const Layout* layout() const { return layout_; }
+
+  private:
+    template <typename Fn>
+    void init(Fn compute_link);
+
+    const Layout* layout_;
+    unsigned int num_dims_, hops_;
+    std::vector<ColourMatrix, Eigen::aligned_allocator<ColourMatrix> > links_;
+    std::vector<unsigned int> neighbours_;
+  };
+
+
+  template <int N, typename T>
+  DoubleStoredGaugeField<N, T>::DoubleStoredGaugeField(
+    const GaugeField& links, const Layout& layout, const unsigned int hops)
+    : layout_(&layout), num_dims_(links.num_dims()), hops_(hops)
+  {
+    const Layout& links_layout = *links.layout();
+    init([&] (const unsigned int site, const unsigned int mu)
+         { return links[links_layout.get_array_index(site)][mu]; });
+  }
+
+
+  template <int N, typename T>
+  template <typename Fn>
+  DoubleStoredGaugeField<N, T>::DoubleStoredGaugeField(
+    const Layout& layout, const unsigned int num_dims,
+    const unsigned int hops, Fn compute_link)
+    : layout_(&layout), num_dims_(num_dims), hops_(hops)
+  {
+    init(compute_link);
+  }
+
+
+  template <int N, typename T>
+  template <typename Fn>
+  void DoubleStoredGaugeField<N, T>::init(Fn compute_link)
+  {
+    const unsigned int volume = layout_->volume();
+    const int hops = static_cast<int>(hops_);
+    links_.resize(2 * num_dims_ * volume);
+    neighbours_.resize(2 * num_dims_ * volume);
+
+    for (unsigned int site = 0; site < volume; ++site) {
+      const unsigned int index = layout_->get_array_index(site);
+      for (unsigned int mu = 0; mu < num_dims_; ++mu) {
+        const unsigned int fwd_site
+          = layout_->compute_neighbour_index(site, mu, hops);
+        const unsigned int bwd_site
+          = layout_->compute_neighbour_index(site, mu, -hops);
+        const unsigned int offset = index * 2 * num_dims_ + mu;
+
+        links_[offset] = compute_link(site, mu);
+        links_[offset + num_dims_] = compute_link(bwd_site, mu).adjoint();
+        neighbours_[offset] = layout_->get_array_index(fwd_site);
+        neighbours_[offset + num_dims_] = layout_->get_array_index(bwd_site);
+      }
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef EXPR_COST_HPP
+#define EXPR_COST_HPP
+
+/* This file provides the cost of evaluating array expressions, derived at
+ * compile time from the types in the expression tree.
+ *
+ * ExprCostTraits<T1, T2> gives the number of real floating point operations
+ * (flops()) and the number of bytes read (bytes()) per element of the
+ * expression with CRTP type T1 and element type T2. The flops of each node are
+ * those of its operator (see element_cost.hpp and operators.hpp) plus those of
+ * its operands. Every array operand counts as a read of one element, so an
+ * array that appears twice in an expression is counted twice. Scalars
+ * broadcast over the array are free.
+ *
+ * expression_cost(expr) gives the totals for evaluating expr into an array,
+ * i.e. including the bytes written, which can be used to report the achieved
+ * flop rate and bandwidth of an assignment, e.g.
+ *
+ *   const ExprCost cost = expression_cost(5.0 * x + y);
+ *
+ * Write-allocate traffic and any caching of operands between elements are
+ * ignored, so the bytes are those a streaming evaluation must move at least.
+ */
+
+#include "detail/array_expr.hpp"
+#include "detail/element_cost.hpp"
+
+
+namespace pyQCD
+{
+  template <typename T1, typename T2>
+  struct ExprCostTraits
+  {
+    // Arrays, lattices and other leaves of the expression tree
+    static constexpr long flops() { return 0; }
+    static constexpr long bytes() { return ElementCostTraits<T2>::bytes; }
+  };
+
+
+  template <typename T>
+  struct ExprCostTraits<ArrayConst<T>, T>
+  {
+    static constexpr long flops() { return 0; }
+    static constexpr long bytes() { return 0; }
+  };
+
+
+  template <typename T1, typename T2, typename Op, typename T3>
+  struct ExprCostTraits<ArrayUnary<T1, T2, Op>, T3>
+  {
+    static constexpr long flops()
+    { return ExprCostTraits<T1, T2>::flops() + Op::template flops<T2>(); }
+    static constexpr long bytes() { return ExprCostTraits<T1, T2>::bytes(); }
+  };
+
+
+  template <typename T1, typename T2, typename T3, typename T4, typename Op,
+            typename T5>
+  struct ExprCostTraits<ArrayBinary<T1, T2, T3, T4, Op>, T5>
+  {
+    static constexpr long flops()
+    {
+      return ExprCostTraits<T1, T3>::flops() + ExprCostTraits<T2, T4>::flops()
+        + Op::template flops<T3, T4>();
+    }
+    static constexpr long bytes()
+    {
+      return ExprCostTraits<T1, T3>::bytes() + ExprCostTraits<T2, T4>::bytes();
+    }
+  };
+
+
+  struct ExprCost
+  {
+    unsigned long flops, bytes;
+  };
+
+
+  template <typename T1, typename T2>
+  ExprCost expression_cost(const ArrayExpr<T1, T2>& expr,
+                           const unsigned long begin, const unsigned long end)
+  {
+    // The flops and bytes moved when evaluating elements [begin, end) of expr
+    // into an array
+    const unsigned long size = end - begin;
+    return ExprCost{
+      size * ExprCostTraits<T1, T2>::flops(),
+      size * (ExprCostTraits<T1, T2>::bytes() + ElementCostTraits<T2>::bytes)};
+  }
+
+
+  template <typename T1, typename T2>
+  ExprCost expression_cost(const ArrayExpr<T1, T2>& expr)
+  { return expression_cost(expr, 0, expr.size()); }
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef FIXED_ARRAY_HPP
+#define FIXED_ARRAY_HPP
+
+/* This file provides an array class with a size that is fixed at compile time,
+ * for use where the per-site extent of a lattice field is known in advance,
+ * e.g. the four spin components of a fermion field or the fifth dimension of a
+ * domain wall fermion.
+ *
+ * FixedArray uses the same expression templates as Array, but the elements are
+ * stored inline rather than on the heap and there's no virtual destructor, so
+ * a Lattice<FixedArray<T, N> > holds all its data in one contiguous buffer.
+ * Because the extent is a compile-time constant, the loops over the elements
+ * can be unrolled and vectorised by the compiler.
+ */
+
+#include <array>
+#include <stdexcept>
+#include <type_traits>
+
+#include <utils/macros.hpp>
+#include "detail/array_expr.hpp"
+
+
+namespace pyQCD
+{
+  template <typename T, unsigned int N>
+  class FixedArray : public ArrayExpr<FixedArray<T, N>, T>
+  {
+  public:
+    FixedArray() = default;
+    explicit FixedArray(const T& val) { data_.fill(val); }
+    FixedArray(const FixedArray<T, N>& array) = default;
+    template <typename U1, typename U2>
+    FixedArray(const ArrayExpr<U1, U2>& expr)
+    {
+      pyQCDassert ((expr.size() == N),
+                   std::out_of_range("FixedArray: expr.size() != N"));
+      assign_elements(data_.data(), expr, 0, N);
+    }
+
+    T& operator[](const unsigned int i) { return data_[i]; }
+    const T& operator[](const unsigned int i) const { return data_[i]; }
+
+    T* data() { return data_.data(); }
+    const T* data() const { return data_.data(); }
+    typename std::array<T, N>::iterator begin() { return data_.begin(); }
+    typename std::array<T, N>::const_iterator begin() const
+    { return data_.begin(); }
+    typename std::array<T, N>::iterator end() { return data_.end(); }
+    typename std::array<T, N>::const_iterator end() const
+    { return data_.end(); }
+
+    ArrayConst<FixedArray<T, N> > broadcast() const
+    { return ArrayConst<FixedArray<T, N> >(*this); }
+
+    FixedArray<T, N>& operator=(const FixedArray<T, N>& array) = default;
+    FixedArray<T, N>& operator=(const T& rhs)
+    {
+      data_.fill(rhs);
+      return *this;
+    }
+    template <typename U1, typename U2>
+    FixedArray<T, N>& operator=(const ArrayExpr<U1, U2>& expr)
+    {
+      pyQCDassert ((expr.size() == N),
+                   std::out_of_range("FixedArray: expr.size() != N"));
+      assign_elements(data_.data(), expr, 0, N);
+      return *this;
+    }
+
+#define FIXED_ARRAY_OPERATOR_ASSIGN_DECL(op)                               \
+    template <typename U,                                                  \
+      typename std::enable_if<                                             \
+        not std::is_base_of<ArrayObj, U>::value>::type* = nullptr>         \
+    FixedArray<T, N>& operator op ## =(const U& rhs)                       \
+    {                                                                      \
+      for (unsigned int i = 0; i < N; ++i) {                               \
+        data_[i] op ## = rhs;                                              \
+      }                                                                    \
+      return *this;                                                        \
+    }                                                                      \
+    template <typename U1, typename U2>                                    \
+    FixedArray<T, N>& operator op ## =(const ArrayExpr<U1, U2>& expr)      \
+    {                                                                      \
+      pyQCDassert ((expr.size() == N),                                     \
+        std::out_of_range("FixedArray: expr.size() != N"));                \
+      for (unsigned int i = 0; i < N; ++i) {                               \
+        data_[i] op ## = expr[i];                                          \
+      }                                                                    \
+      return *this;                                                        \
+    }
+
+    FIXED_ARRAY_OPERATOR_ASSIGN_DECL(+);
+    FIXED_ARRAY_OPERATOR_ASSIGN_DECL(-);
+    FIXED_ARRAY_OPERATOR_ASSIGN_DECL(*);
+    FIXED_ARRAY_OPERATOR_ASSIGN_DECL(/);
+
+    static constexpr unsigned long size() { return N; }
+    const Layout* layout() const { return nullptr; }
+
+  private:
+    std::array<T, N> data_;
+  };
+}
+
+#endif
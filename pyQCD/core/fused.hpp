@@ -0,0 +1,242 @@
+#ifndef FUSED_HPP
+#define FUSED_HPP
+
+/* This file provides fused evaluation of several array assignments, and
+ * optionally a sum, in a single sweep over the sites. This is intended for
+ * the updates in Krylov solvers such as
+ *
+ *   x += alpha * p;
+ *   r -= alpha * Ap;
+ *   rr = sum |r|^2;
+ *
+ * which, evaluated one statement at a time, stream r from memory three times
+ * and p and Ap once each for very little arithmetic. The fused version is
+ *
+ *   rr = fused_sum(
+ *     [&] (const unsigned long i) { return r[i].squaredNorm(); },
+ *     output(x) += alpha * p, output(r) -= alpha * Ap);
+ *
+ * At each site the assignments are carried out in the order given, followed by
+ * the evaluation of the summand, so the summand and later assignments see the
+ * updated values of earlier targets at that site. Expressions must therefore
+ * only read the targets of the same sweep at the site being computed (which is
+ * always the case for the element-wise expressions in solver updates).
+ *
+ * The sum is computed in blocks of a fixed size that are combined in order, as
+ * in reductions.hpp, so the result doesn't depend on the number of threads.
+ *
+ * The assignment objects refer to their target and operands, so they should
+ * only be created in the argument list of fused_evaluate or fused_sum.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <utils/macros.hpp>
+#include <utils/parallel.hpp>
+#include <utils/profiling.hpp>
+#include <utils/templates.hpp>
+#include "detail/array_expr.hpp"
+#include "lattice.hpp"
+#include "reductions.hpp"
+
+
+namespace pyQCD
+{
+  namespace detail
+  {
+    struct FusedAssign
+    {
+      template <typename T, typename U>
+      void operator()(T&& lhs, const U& rhs) const { lhs = rhs; }
+    };
+
+
+    struct FusedPlusAssign
+    {
+      template <typename T, typename U>
+      void operator()(T&& lhs, const U& rhs) const { lhs += rhs; }
+    };
+
+
+    struct FusedMinusAssign
+    {
+      template <typename T, typename U>
+      void operator()(T&& lhs, const U& rhs) const { lhs -= rhs; }
+    };
+
+
+    // Lattices must save their contents to any snapshots before they're
+    // written and update their version afterwards
+    template <typename T>
+    void prepare_fused_target(T& target) { }
+
+
+    template <typename T, template <typename> class Alloc, bool Nested>
+    void prepare_fused_target(Lattice<T, Alloc, Nested>& target)
+    { target.prepare_write(); }
+
+
+    template <typename T>
+    void finish_fused_target(T& target) { }
+
+
+    template <typename T, template <typename> class Alloc, bool Nested>
+    void finish_fused_target(Lattice<T, Alloc, Nested>& target)
+    { target.touch(); }
+  }
+
+
+  template <typename Target, typename Expr, typename Op>
+  class FusedAssignment
+  {
+    // Assignment of expr to target using Op, to be evaluated by fused_evaluate
+    // or fused_sum
+  public:
+    FusedAssignment(Target& target, const Expr& expr)
+      : target_(target), expr_(expr)
+    {
+      pyQCDassert ((target.size() == expr.size()),
+        std::out_of_range("FusedAssignment: target.size() != expr.size()"));
+    }
+
+    unsigned long size() const { return target_.size(); }
+
+    void prepare() const { detail::prepare_fused_target(target_); }
+    void apply(const unsigned long i) const { Op()(target_[i], expr_[i]); }
+    void finish() const { detail::finish_fused_target(target_); }
+
+  private:
+    Target& target_;
+    typename OperandTraits<Expr>::type expr_;
+  };
+
+
+  template <typename Target>
+  class FusedOutput
+  {
+    // Wrapper around the target of an assignment in a fused sweep
+  public:
+    FusedOutput(Target& target) : target_(target) { }
+
+#define FUSED_OUTPUT_ASSIGN_DECL(op, Op)                                   \
+    template <typename U1, typename U2>                                    \
+    FusedAssignment<Target, U1, detail::Op> operator op(                   \
+      const ArrayExpr<U1, U2>& expr) const                                 \
+    {                                                                      \
+      return FusedAssignment<Target, U1, detail::Op>(                      \
+        target_, static_cast<const U1&>(expr));                            \
+    }
+
+    FUSED_OUTPUT_ASSIGN_DECL(=, FusedAssign);
+    FUSED_OUTPUT_ASSIGN_DECL(+=, FusedPlusAssign);
+    FUSED_OUTPUT_ASSIGN_DECL(-=, FusedMinusAssign);
+
+  private:
+    Target& target_;
+  };
+
+
+  template <typename Target>
+  FusedOutput<Target> output(Target& target)
+  { return FusedOutput<Target>(target); }
+
+
+  namespace detail
+  {
+    template <typename Assignment>
+    unsigned long fused_size(const Assignment& assignment)
+    { return assignment.size(); }
+
+
+    template <typename Assignment, typename... Assignments>
+    unsigned long fused_size(const Assignment& assignment,
+                             const Assignments&... assignments)
+    {
+      pyQCDassert ((fused_size(assignments...) == assignment.size()),
+        std::out_of_range("fused_evaluate: targets differ in size"));
+      return assignment.size();
+    }
+
+
+    // Pack expansions in braced initialiser lists are evaluated in order
+    template <typename... Assignments>
+    void fused_prepare(const Assignments&... assignments)
+    {
+      const int expand[] = {0, (assignments.prepare(), 0)...};
+      (void) expand;
+    }
+
+
+    template <typename... Assignments>
+    void fused_apply(const unsigned long i, const Assignments&... assignments)
+    {
+      const int expand[] = {0, (assignments.apply(i), 0)...};
+      (void) expand;
+    }
+
+
+    template <typename... Assignments>
+    void fused_finish(const Assignments&... assignments)
+    {
+      const int expand[] = {0, (assignments.finish(), 0)...};
+      (void) expand;
+    }
+  }
+
+
+  template <typename... Assignments>
+  void fused_evaluate(const Assignments&... assignments)
+  {
+    // Carry out the assignments in a single parallel sweep over the sites
+    static_assert(sizeof...(Assignments) > 0,
+                  "fused_evaluate: no assignments to evaluate");
+    PYQCD_PROFILE_SCOPE("fused_evaluate");
+    const unsigned long size = detail::fused_size(assignments...);
+    detail::fused_prepare(assignments...);
+    parallel_for(0, size, [&] (const unsigned long i) {
+      detail::fused_apply(i, assignments...);
+    }, reduction_block_size);
+    detail::fused_finish(assignments...);
+  }
+
+
+  template <typename Fn, typename... Assignments>
+  typename std::decay<decltype(std::declval<Fn>()(0ul))>::type
+  fused_sum(Fn summand, const Assignments&... assignments)
+  {
+    // Carry out the assignments in a single parallel sweep over the sites,
+    // returning the sum of summand(i) evaluated after the assignments at each
+    // site i
+    static_assert(sizeof...(Assignments) > 0,
+                  "fused_sum: no assignments to evaluate");
+    PYQCD_PROFILE_SCOPE("fused_sum");
+    typedef typename std::decay<decltype(summand(0ul))>::type T;
+    const unsigned long size = detail::fused_size(assignments...);
+    const unsigned long num_blocks
+      = (size + reduction_block_size - 1) / reduction_block_size;
+
+    detail::fused_prepare(assignments...);
+    std::vector<T> partials(num_blocks, ZeroTraits<T>::zero());
+    parallel_for(0, num_blocks, [&] (const unsigned long block) {
+      const unsigned long end
+        = std::min(size, (block + 1) * reduction_block_size);
+      T& partial = partials[block];
+      for (unsigned long i = block * reduction_block_size; i < end; ++i) {
+        detail::fused_apply(i, assignments...);
+        partial += summand(i);
+      }
+    });
+    detail::fused_finish(assignments...);
+
+    T ret = ZeroTraits<T>::zero();
+    for (auto& partial : partials) {
+      ret += partial;
+    }
+    return ret;
+  }
+}
+
+#endif
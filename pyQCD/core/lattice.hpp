@@ -5,42 +5,91 @@
  * but with a Layout member specifying the relationship between the sites and
  * the Array index. In addition, there are operator() implementations to access
  * elements using site coordinates or a lexicographic index.
+ *
+ * Each Lattice also carries a version number, which is changed whenever the
+ * whole lattice is assigned to or modified using an arithmetic assignment
+ * operator. Objects derived from the contents of a lattice (e.g. the clover
+ * term derived from the gauge field) can use this to determine whether they
+ * are stale. Writes to individual sites are not tracked, so code that modifies
+ * a lattice site by site should call touch() when it's done.
+ *
+ * Copy-on-write snapshots of a lattice can be taken using snapshot() and
+ * restored using restore() (see lattice_snapshot.hpp).
+ *
+ * An expression can be evaluated on a subset of the sites of a lattice (see
+ * subset.hpp) using assign(), in which case only those sites are computed and
+ * written to.
+ *
+ * Per-site operations that can't be written as expressions (e.g. momentum
+ * phases or source construction) can use for_each_site() and transform(),
+ * which run in parallel and give the supplied function the array index and
+ * coordinates of each site.
+ *
+ * Lattices of Array types, such as Lattice<MatrixArray<3, 3> >, would
+ * otherwise hold a separately allocated Array for each site. Instead a partial
+ * specialization stores the elements of all sites in a single contiguous buffer
+ * with the same number of elements on each site, which is fixed when the
+ * lattice is constructed. A lattice constructed from a layout alone is empty,
+ * and takes its site size from the first value, lattice or expression assigned
+ * to it. Sites are accessed through ArrayView objects, which can be indexed,
+ * iterated over and used in Array expressions in the same way as the Array
+ * type itself. The elements are stored using the allocator of the Array type,
+ * so the Alloc parameter must be left as the default.
  */
 
+#include <atomic>
 #include <cassert>
 #include <vector>
 
+#include <utils/profiling.hpp>
 #include "array.hpp"
+#include "array_view.hpp"
+#include "lattice_snapshot.hpp"
 #include "layout.hpp"
+#include "subset.hpp"
 
 
 namespace pyQCD
 {
-  template <typename T, template <typename> class Alloc = std::allocator>
-  class Lattice : public Array<T, Alloc, Lattice<T, Alloc> >
+  inline unsigned long next_lattice_version()
+  {
+    // Versions are unique across all lattices, so a lattice that is replaced
+    // by another (e.g. through a move) is never mistaken for its predecessor
+    static std::atomic<unsigned long> counter(0);
+    return ++counter;
+  }
+
+
+  template <typename T, template <typename> class Alloc, bool Nested>
+  class Lattice : public Array<T, Alloc, Lattice<T, Alloc, Nested> >
   {
   public:
-    Lattice() : layout_(nullptr) { }
+    typedef LatticeSnapshot<T, Alloc<T> > snapshot_type;
+
+    Lattice() : layout_(nullptr), version_(next_lattice_version()) { }
     Lattice(const Layout& layout)
-      : Array<T, Alloc, Lattice<T, Alloc> >(), layout_(&layout)
+      : Array<T, Alloc, Lattice>(), layout_(&layout),
+        version_(next_lattice_version())
     {
-      this->data_.resize(layout.volume());
+      this->data_.resize(layout.volume(), T());
     }
     Lattice(const Layout& layout, const T& val)
-      : Array<T, Alloc, Lattice<T, Alloc> >(layout.volume(), val),
-        layout_(&layout)
+      : Array<T, Alloc, Lattice>(layout.volume(), val),
+        layout_(&layout), version_(next_lattice_version())
     {}
-    Lattice(const Lattice<T, Alloc>& lattice) = default;
+    Lattice(const Layout& layout, Uninitialized)
+      : Array<T, Alloc, Lattice>(layout.volume(), Uninitialized()),
+        layout_(&layout), version_(next_lattice_version())
+    {}
+    Lattice(const Lattice& lattice) = default;
     template <typename U1, typename U2>
     Lattice(const ArrayExpr<U1, U2>& expr)
+      : version_(next_lattice_version())
     {
-      this->data_.resize(expr.size());
-      for (unsigned long i = 0; i < expr.size(); ++i) {
-        this->data_[i] = static_cast<T>(expr[i]);
-      }
+      this->evaluate(expr);
       layout_ = expr.layout();
     }
-    Lattice(Lattice<T, Alloc>&& lattice) = default;
+    Lattice(Lattice&& lattice) = default;
 
     T& operator()(const int i)
     { return this->data_[layout_->get_array_index(i)]; }
@@ -53,33 +102,349 @@ namespace pyQCD
     const T& operator()(const U& site) const
     { return this->data_[layout_->get_array_index(site)]; }
 
-    Lattice<T, Alloc>& operator=(const Lattice<T, Alloc>& lattice);
-    Lattice<T, Alloc>& operator=(Lattice<T, Alloc>&& lattice) = default;
+    Lattice& operator=(const Lattice& lattice);
+    Lattice& operator=(Lattice&& lattice) = default;
+    Lattice& operator=(const T& rhs)
+    {
+      prepare_write();
+      Array<T, Alloc, Lattice>::operator=(rhs);
+      touch();
+      return *this;
+    }
     template <typename U1, typename U2>
-    Lattice<T, Alloc>& operator=(const ArrayExpr<U1, U2>& expr)
+    Lattice& operator=(const ArrayExpr<U1, U2>& expr)
     {
       pyQCDassert ((this->data_.size() == expr.size()),
                    std::out_of_range("Array::data_"));
-      T* ptr = &(this->data_)[0];
+      prepare_write();
+      evaluate_elements(this->data_.data(), expr, 0, expr.size());
+      layout_ = expr.layout();
+      touch();
+      return *this;
+    }
+    template <typename U1, typename U2>
+    Lattice& assign(const Subset& subset, const ArrayExpr<U1, U2>& expr);
+
+    // fn(array_index, coords) is called for every site
+    template <typename Fn>
+    void for_each_site(Fn fn) const { layout_->for_each_site(fn); }
+    // Site values are set to fn(array_index, coords)
+    template <typename Fn>
+    Lattice& transform(Fn fn)
+    {
+      prepare_write();
+      T* ptr = this->data_.data();
+      layout_->for_each_site(
+        [&] (const unsigned int i, const std::vector<unsigned int>& coords)
+        { ptr[i] = fn(i, coords); });
+      touch();
+      return *this;
+    }
+
+#define LATTICE_OPERATOR_ASSIGN_DECL(op)                                   \
+    template <typename U>                                                  \
+    Lattice& operator op ## =(const U& rhs)                                \
+    {                                                                      \
+      prepare_write();                                                     \
+      Array<T, Alloc, Lattice>::operator op ## =(rhs);                     \
+      touch();                                                             \
+      return *this;                                                        \
+    }
+
+    LATTICE_OPERATOR_ASSIGN_DECL(+);
+    LATTICE_OPERATOR_ASSIGN_DECL(-);
+    LATTICE_OPERATOR_ASSIGN_DECL(*);
+    LATTICE_OPERATOR_ASSIGN_DECL(/);
+
+#undef LATTICE_OPERATOR_ASSIGN_DECL
+
+    unsigned int volume() const { return layout_->volume(); }
+    unsigned int num_dims() const { return layout_->num_dims(); }
+    const Layout* layout() const { return layout_; }
+
+    unsigned long version() const { return version_; }
+    void touch() { version_ = next_lattice_version(); }
+
+    // Snapshots are divided into blocks of block_size sites
+    snapshot_type snapshot(const unsigned long block_size = 64)
+    { return snapshot_type(snapshots_.create(this->data_.size(), block_size)); }
+    void restore(const snapshot_type& snapshot);
+    // Save the sites with array indices [begin, end) to any snapshots before
+    // they're modified
+    void prepare_write(const unsigned long begin, const unsigned long end)
+    {
+      if (not snapshots_.empty()) {
+        snapshots_.save(this->data_.data(), begin, end);
+      }
+    }
+    void prepare_write() { prepare_write(0, this->data_.size()); }
+
+  protected:
+    const Layout* layout_;
+    unsigned long version_;
+    detail::SnapshotRegistry<T, Alloc<T> > snapshots_;
+  };
+
+
+  template <typename T, template <typename> class Alloc, bool Nested>
+  Lattice<T, Alloc, Nested>& Lattice<T, Alloc, Nested>::operator=(
+    const Lattice<T, Alloc, Nested>& lattice)
+  {
+    if (layout_) {
+      pyQCDassert (lattice.volume() == volume(),
+        std::invalid_argument("lattice.volume() != volume()"));
+    }
+    else {
+      layout_ = lattice.layout_;
+    }
+    if (&lattice != this) {
+      // Sites are mapped through the layouts, which may differ
+      PYQCD_PROFILE_SCOPE_COST("Lattice copy", 0,
+        volume() * (2 * sizeof(T) + 2 * sizeof(unsigned int)));
+      prepare_write();
+      for (unsigned int i = 0; i < volume(); ++i) {
+        (*this)(lattice.layout_->get_site_index(i)) = lattice[i];
+      }
+      touch();
+    }
+    return *this;
+  }
+
+
+  template <typename T, template <typename> class Alloc, bool Nested>
+  template <typename U1, typename U2>
+  Lattice<T, Alloc, Nested>& Lattice<T, Alloc, Nested>::assign(
+    const Subset& subset, const ArrayExpr<U1, U2>& expr)
+  {
+    pyQCDassert ((this->data_.size() == expr.size()),
+                 std::out_of_range("Array::data_"));
+    pyQCDassert ((subset.size() == 0
+                  or subset.ranges().back().second <= expr.size()),
+                 std::out_of_range("Lattice: subset exceeds size()"));
+    pyQCDassert ((subset.is_valid_for(layout_)), std::bad_cast());
+    pyQCDassert ((expr.layout() == nullptr or layout_ == nullptr
+                  or typeid(*expr.layout()) == typeid(*layout_)),
+                 std::bad_cast());
+    for (auto& range : subset.ranges()) {
+      prepare_write(range.first, range.second);
+      evaluate_elements(this->data_.data(), expr, range.first, range.second);
+    }
+    touch();
+    return *this;
+  }
+
+
+  template <typename T, template <typename> class Alloc, bool Nested>
+  void Lattice<T, Alloc, Nested>::restore(const snapshot_type& snapshot)
+  {
+    pyQCDassert ((snapshots_.contains(snapshot.blocks_.get())),
+      std::invalid_argument("Lattice: snapshot not taken of this lattice"));
+    pyQCDassert ((snapshot.blocks_->size() == this->data_.size()),
+      std::invalid_argument("Lattice: snapshot size != lattice size"));
+    snapshots_.restore(this->data_.data(), *snapshot.blocks_);
+    touch();
+  }
+
+
+  template <typename T, template <typename> class Alloc>
+  class Lattice<T, Alloc, true>
+    : public ArrayExpr<Lattice<T, Alloc, true>,
+        ArrayView<const typename NestedArrayTraits<T>::value_type> >
+  {
+  public:
+    typedef typename NestedArrayTraits<T>::value_type value_type;
+    typedef ArrayView<value_type> view_type;
+    typedef ArrayView<const value_type> const_view_type;
+    typedef ArrayViewIterator<value_type> iterator;
+    typedef ArrayViewIterator<const value_type> const_iterator;
+    typedef LatticeSnapshot<value_type,
+      typename NestedArrayTraits<T>::allocator_type> snapshot_type;
+    static_assert(std::is_same<Alloc<T>, std::allocator<T> >::value,
+                  "Lattice: Alloc can't be specified for a Lattice of Arrays");
+
+    Lattice()
+      : layout_(nullptr), site_size_(0), version_(next_lattice_version())
+    { }
+    Lattice(const Layout& layout)
+      : layout_(&layout), site_size_(0), version_(next_lattice_version())
+    { }
+    Lattice(const Layout& layout, const T& val)
+      : data_(layout.volume() * val.size()), layout_(&layout),
+        site_size_(val.size()), version_(next_lattice_version())
+    {
+      for (auto site : *this) {
+        site = val;
+      }
+    }
+    Lattice(const Layout& layout, const unsigned int site_size, Uninitialized)
+      : data_(layout.volume() * site_size), layout_(&layout),
+        site_size_(site_size), version_(next_lattice_version())
+    { }
+    Lattice(const Lattice& lattice) = default;
+    template <typename U1, typename U2>
+    Lattice(const ArrayExpr<U1, U2>& expr)
+      : layout_(expr.layout()), site_size_(expr.size() ? expr[0].size() : 0),
+        version_(next_lattice_version())
+    {
+      data_.resize(expr.size() * site_size_);
+      for (unsigned long i = 0; i < expr.size(); ++i) {
+        (*this)[i] = expr[i];
+      }
+    }
+    Lattice(Lattice&& lattice) = default;
+
+    view_type operator[](const unsigned long i)
+    { return view_type(data_.data() + i * site_size_, site_size_); }
+    const_view_type operator[](const unsigned long i) const
+    { return const_view_type(data_.data() + i * site_size_, site_size_); }
+
+    view_type operator()(const int i)
+    { return (*this)[layout_->get_array_index(i)]; }
+    const_view_type operator()(const int i) const
+    { return (*this)[layout_->get_array_index(i)]; }
+    template <typename U>
+    view_type operator()(const U& site)
+    { return (*this)[layout_->get_array_index(site)]; }
+    template <typename U>
+    const_view_type operator()(const U& site) const
+    { return (*this)[layout_->get_array_index(site)]; }
+
+    iterator begin() { return iterator(data_.data(), site_size_); }
+    const_iterator begin() const
+    { return const_iterator(data_.data(), site_size_); }
+    iterator end() { return iterator(data_.data() + data_.size(), site_size_); }
+    const_iterator end() const
+    { return const_iterator(data_.data() + data_.size(), site_size_); }
+
+    Lattice& operator=(const Lattice& lattice);
+    Lattice& operator=(Lattice&& lattice) = default;
+    Lattice& operator=(const T& rhs)
+    {
+      if (site_size_ == 0 and layout_) {
+        reshape(layout_->volume(), rhs.size());
+      }
+      pyQCDassert ((rhs.size() == site_size_),
+                   std::out_of_range("Lattice: rhs.size() != site_size()"));
+      prepare_write();
+      for (auto site : *this) {
+        site = rhs;
+      }
+      touch();
+      return *this;
+    }
+    template <typename U1, typename U2>
+    Lattice& operator=(const ArrayExpr<U1, U2>& expr)
+    {
+      if (site_size_ == 0 and expr.size() > 0) {
+        reshape(expr.size(), expr[0].size());
+      }
+      pyQCDassert ((size() == expr.size()),
+                   std::out_of_range("Array::data_"));
+      PYQCD_PROFILE_SCOPE("Lattice evaluation (nested)");
+      prepare_write();
       for (unsigned long i = 0; i < expr.size(); ++i) {
-        ptr[i] = static_cast<T>(expr[i]);
+        (*this)[i] = expr[i];
       }
       layout_ = expr.layout();
+      touch();
+      return *this;
+    }
+    template <typename U1, typename U2>
+    Lattice& assign(const Subset& subset, const ArrayExpr<U1, U2>& expr);
+
+    template <typename Fn>
+    void for_each_site(Fn fn) const { layout_->for_each_site(fn); }
+    // Here fn(view, array_index, coords) writes the site through the view
+    template <typename Fn>
+    Lattice& transform(Fn fn)
+    {
+      prepare_write();
+      layout_->for_each_site(
+        [&] (const unsigned int i, const std::vector<unsigned int>& coords)
+        { fn((*this)[i], i, coords); });
+      touch();
       return *this;
     }
 
+#define NESTED_LATTICE_OPERATOR_ASSIGN_DECL(op)                            \
+    template <typename U,                                                  \
+      typename std::enable_if<                                             \
+        not std::is_base_of<ArrayObj, U>::value>::type* = nullptr>         \
+    Lattice& operator op ## =(const U& rhs)                                \
+    {                                                                      \
+      prepare_write();                                                     \
+      for (auto& item : data_) {                                           \
+        item op ## = rhs;                                                  \
+      }                                                                    \
+      touch();                                                             \
+      return *this;                                                        \
+    }                                                                      \
+    template <typename U1, typename U2>                                    \
+    Lattice& operator op ## =(const ArrayExpr<U1, U2>& expr)               \
+    {                                                                      \
+      pyQCDassert ((size() == expr.size()),                                \
+        std::out_of_range("Arrays must be the same size"));                \
+      prepare_write();                                                     \
+      for (unsigned long i = 0; i < expr.size(); ++i) {                    \
+        (*this)[i] op ## = expr[i];                                        \
+      }                                                                    \
+      touch();                                                             \
+      return *this;                                                        \
+    }
+
+    NESTED_LATTICE_OPERATOR_ASSIGN_DECL(+);
+    NESTED_LATTICE_OPERATOR_ASSIGN_DECL(-);
+    NESTED_LATTICE_OPERATOR_ASSIGN_DECL(*);
+    NESTED_LATTICE_OPERATOR_ASSIGN_DECL(/);
+
+#undef NESTED_LATTICE_OPERATOR_ASSIGN_DECL
+
+    unsigned long size() const
+    { return site_size_ == 0 ? 0 : data_.size() / site_size_; }
+    // The number of elements on each site
+    unsigned int site_size() const { return site_size_; }
+    value_type* data() { return data_.data(); }
+    const value_type* data() const { return data_.data(); }
+
     unsigned int volume() const { return layout_->volume(); }
     unsigned int num_dims() const { return layout_->num_dims(); }
     const Layout* layout() const { return layout_; }
 
+    unsigned long version() const { return version_; }
+    void touch() { version_ = next_lattice_version(); }
+
+    snapshot_type snapshot(const unsigned long block_size = 64)
+    {
+      return snapshot_type(
+        snapshots_.create(data_.size(), block_size * site_size_), site_size_);
+    }
+    void restore(const snapshot_type& snapshot);
+    void prepare_write(const unsigned long begin, const unsigned long end)
+    {
+      if (not snapshots_.empty()) {
+        snapshots_.save(data_.data(), begin * site_size_, end * site_size_);
+      }
+    }
+    void prepare_write() { prepare_write(0, size()); }
+
   protected:
+    // Resize the buffer to hold num_sites sites of site_size elements. The
+    // snapshots save the whole lattice first, so they can still be restored.
+    void reshape(const unsigned long num_sites, const unsigned int site_size);
+
+    std::vector<value_type, DefaultInitAllocator<
+      typename NestedArrayTraits<T>::allocator_type> > data_;
     const Layout* layout_;
+    unsigned int site_size_;
+    unsigned long version_;
+    detail::SnapshotRegistry<value_type,
+      typename NestedArrayTraits<T>::allocator_type> snapshots_;
   };
 
 
   template <typename T, template <typename> class Alloc>
-  Lattice<T, Alloc>& Lattice<T, Alloc>::operator=(
-    const Lattice<T, Alloc>& lattice)
+  Lattice<T, Alloc, true>& Lattice<T, Alloc, true>::operator=(
+    const Lattice<T, Alloc, true>& lattice)
   {
     if (layout_) {
       pyQCDassert (lattice.volume() == volume(),
@@ -89,12 +454,79 @@ namespace pyQCD
       layout_ = lattice.layout_;
     }
     if (&lattice != this) {
+      reshape(lattice.size(), lattice.site_size_);
+      prepare_write();
+      PYQCD_PROFILE_SCOPE_COST("Lattice copy", 0,
+        2 * data_.size() * sizeof(value_type)
+          + 2 * volume() * sizeof(unsigned int));
       for (unsigned int i = 0; i < volume(); ++i) {
         (*this)(lattice.layout_->get_site_index(i)) = lattice[i];
       }
+      touch();
     }
     return *this;
   }
+
+
+  template <typename T, template <typename> class Alloc>
+  template <typename U1, typename U2>
+  Lattice<T, Alloc, true>& Lattice<T, Alloc, true>::assign(
+    const Subset& subset, const ArrayExpr<U1, U2>& expr)
+  {
+    pyQCDassert ((size() == expr.size()),
+                 std::out_of_range("Array::data_"));
+    pyQCDassert ((subset.size() == 0
+                  or subset.ranges().back().second <= expr.size()),
+                 std::out_of_range("Lattice: subset exceeds size()"));
+    pyQCDassert ((subset.is_valid_for(layout_)), std::bad_cast());
+    pyQCDassert ((expr.layout() == nullptr or layout_ == nullptr
+                  or typeid(*expr.layout()) == typeid(*layout_)),
+                 std::bad_cast());
+    for (auto& range : subset.ranges()) {
+      prepare_write(range.first, range.second);
+      for (unsigned int i = range.first; i < range.second; ++i) {
+        (*this)[i] = expr[i];
+      }
+    }
+    touch();
+    return *this;
+  }
+
+
+  template <typename T, template <typename> class Alloc>
+  void Lattice<T, Alloc, true>::reshape(const unsigned long num_sites,
+                                        const unsigned int site_size)
+  {
+    if (site_size == site_size_ and data_.size() == num_sites * site_size) {
+      return;
+    }
+    prepare_write();
+    site_size_ = site_size;
+    data_.resize(num_sites * site_size);
+  }
+
+
+  template <typename T, template <typename> class Alloc>
+  void Lattice<T, Alloc, true>::restore(const snapshot_type& snapshot)
+  {
+    pyQCDassert ((snapshots_.contains(snapshot.blocks_.get())),
+      std::invalid_argument("Lattice: snapshot not taken of this lattice"));
+    if (snapshot.blocks_->size() == data_.size()
+        and snapshot.site_size_ == site_size_) {
+      snapshots_.restore(data_.data(), *snapshot.blocks_);
+    }
+    else {
+      // The lattice has been reshaped since the snapshot was taken, at which
+      // point the snapshot saved all of it (see reshape)
+      pyQCDassert ((snapshot.num_saved_blocks() == snapshot.num_blocks()),
+        std::invalid_argument("Lattice: snapshot size != lattice size"));
+      prepare_write();
+      site_size_ = snapshot.site_size_;
+      data_.resize(snapshot.blocks_->size());
+      snapshot.blocks_->restore(data_.data());
+    }
+    touch();
+  }
 }
 
 #endif
@@ -0,0 +1,225 @@
+#ifndef LATTICE_SNAPSHOT_HPP
+#define LATTICE_SNAPSHOT_HPP
+
+/* This file provides copy-on-write snapshots of the contents of a Lattice.
+ *
+ * Taking a snapshot doesn't copy anything. Instead the lattice's buffer is
+ * divided into blocks of sites, and each block is copied into the snapshot
+ * just before it's first modified. Restoring a snapshot then only copies back
+ * the blocks that have been modified since it was taken. This makes backups of
+ * the gauge field (e.g. for the accept/reject step of HMC) cheap when little
+ * or nothing changes, and no more expensive than a deep copy otherwise.
+ *
+ * Lattice operations that modify the whole lattice (assignment and the
+ * arithmetic assignment operators) save the blocks they overwrite
+ * automatically. As with versioning, writes to individual sites are not
+ * tracked, so code that modifies a lattice site by site should call
+ * prepare_write() before it does so.
+ */
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "detail/array_traits.hpp"
+#include "detail/default_init_allocator.hpp"
+
+
+namespace pyQCD
+{
+  namespace detail
+  {
+    template <typename T, typename Alloc>
+    class SnapshotBlocks
+    {
+      // The blocks of a lattice buffer that have been saved by a snapshot
+    public:
+      SnapshotBlocks(const unsigned long size, const unsigned long block_size)
+        : size_(size), block_size_(std::max(block_size, 1ul)),
+          saved_blocks_((size_ + block_size_ - 1) / block_size_, false)
+      { }
+
+      void save(const T* data, const unsigned long begin,
+                const unsigned long end);
+      void restore(T* data) const;
+
+      unsigned long size() const { return size_; }
+      unsigned long block_size() const { return block_size_; }
+      unsigned long num_blocks() const { return saved_blocks_.size(); }
+      unsigned long num_saved_blocks() const
+      { return std::count(saved_blocks_.begin(), saved_blocks_.end(), true); }
+      bool is_saved(const unsigned long block) const
+      { return saved_blocks_[block]; }
+
+    private:
+      unsigned long size_, block_size_;
+      std::vector<bool> saved_blocks_;
+      // Only allocated when the first block is saved
+      std::vector<T, DefaultInitAllocator<Alloc> > data_;
+    };
+
+
+    template <typename T, typename Alloc>
+    void SnapshotBlocks<T, Alloc>::save(
+      const T* data, const unsigned long begin, const unsigned long end)
+    {
+      // Save the blocks containing elements [begin, end) of data that haven't
+      // been saved already
+      if (begin >= end or begin >= size_) {
+        return;
+      }
+      const unsigned long last_block = std::min((end - 1) / block_size_,
+                                                num_blocks() - 1);
+      for (unsigned long b = begin / block_size_; b <= last_block; ++b) {
+        if (saved_blocks_[b]) {
+          continue;
+        }
+        if (data_.empty()) {
+          data_.resize(size_);
+        }
+        const unsigned long offset = b * block_size_;
+        const unsigned long count = std::min(block_size_, size_ - offset);
+        std::copy(data + offset, data + offset + count, data_.data() + offset);
+        saved_blocks_[b] = true;
+      }
+    }
+
+
+    template <typename T, typename Alloc>
+    void SnapshotBlocks<T, Alloc>::restore(T* data) const
+    {
+      for (unsigned long b = 0; b < num_blocks(); ++b) {
+        if (not saved_blocks_[b]) {
+          continue;
+        }
+        const unsigned long offset = b * block_size_;
+        const unsigned long count = std::min(block_size_, size_ - offset);
+        std::copy(data_.data() + offset, data_.data() + offset + count,
+                  data + offset);
+      }
+    }
+
+
+    template <typename T, typename Alloc>
+    class SnapshotRegistry
+    {
+      // Keeps track of the live snapshots of a lattice so that they can save
+      // blocks before they're modified. Copying a lattice doesn't copy its
+      // snapshots, so a copied registry is empty.
+    public:
+      SnapshotRegistry() = default;
+      SnapshotRegistry(const SnapshotRegistry<T, Alloc>&) { }
+      SnapshotRegistry(SnapshotRegistry<T, Alloc>&&) = default;
+      SnapshotRegistry<T, Alloc>& operator=(const SnapshotRegistry<T, Alloc>&)
+      { return *this; }
+      SnapshotRegistry<T, Alloc>& operator=(SnapshotRegistry<T, Alloc>&&)
+        = default;
+
+      std::shared_ptr<SnapshotBlocks<T, Alloc> > create(
+        const unsigned long size, const unsigned long block_size);
+      bool contains(const SnapshotBlocks<T, Alloc>* blocks) const;
+      void save(const T* data, const unsigned long begin,
+                const unsigned long end,
+                const SnapshotBlocks<T, Alloc>* skip = nullptr);
+      void restore(T* data, const SnapshotBlocks<T, Alloc>& blocks);
+
+      bool empty() const { return snapshots_.empty(); }
+
+    private:
+      std::vector<std::weak_ptr<SnapshotBlocks<T, Alloc> > > snapshots_;
+    };
+
+
+    template <typename T, typename Alloc>
+    std::shared_ptr<SnapshotBlocks<T, Alloc> >
+    SnapshotRegistry<T, Alloc>::create(const unsigned long size,
+                                       const unsigned long block_size)
+    {
+      auto ret = std::make_shared<SnapshotBlocks<T, Alloc> >(size, block_size);
+      snapshots_.push_back(ret);
+      return ret;
+    }
+
+
+    template <typename T, typename Alloc>
+    bool SnapshotRegistry<T, Alloc>::contains(
+      const SnapshotBlocks<T, Alloc>* blocks) const
+    {
+      for (auto& snapshot : snapshots_) {
+        if (snapshot.lock().get() == blocks) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+
+    template <typename T, typename Alloc>
+    void SnapshotRegistry<T, Alloc>::save(
+      const T* data, const unsigned long begin, const unsigned long end,
+      const SnapshotBlocks<T, Alloc>* skip)
+    {
+      // Snapshots that have been destroyed are dropped here
+      auto it = snapshots_.begin();
+      while (it != snapshots_.end()) {
+        auto snapshot = it->lock();
+        if (snapshot) {
+          if (snapshot.get() != skip) {
+            snapshot->save(data, begin, end);
+          }
+          ++it;
+        }
+        else {
+          it = snapshots_.erase(it);
+        }
+      }
+    }
+
+
+    template <typename T, typename Alloc>
+    void SnapshotRegistry<T, Alloc>::restore(
+      T* data, const SnapshotBlocks<T, Alloc>& blocks)
+    {
+      // The other snapshots need the current contents of the blocks that are
+      // about to be overwritten
+      const unsigned long block_size = blocks.block_size();
+      for (unsigned long b = 0; b < blocks.num_blocks(); ++b) {
+        if (blocks.is_saved(b)) {
+          save(data, b * block_size, (b + 1) * block_size, &blocks);
+        }
+      }
+      blocks.restore(data);
+    }
+  }
+
+
+  template <typename T, typename Alloc>
+  class LatticeSnapshot
+  {
+    // The contents of a lattice at some point in time. The snapshot can be
+    // restored using Lattice::restore. Copies of a snapshot share their blocks.
+    template <typename U, template <typename> class A, bool Nested>
+    friend class Lattice;
+  public:
+    LatticeSnapshot() = default;
+
+    // The number of blocks that have been copied into the snapshot so far
+    unsigned long num_saved_blocks() const
+    { return blocks_ ? blocks_->num_saved_blocks() : 0; }
+    unsigned long num_blocks() const
+    { return blocks_ ? blocks_->num_blocks() : 0; }
+
+  private:
+    LatticeSnapshot(std::shared_ptr<detail::SnapshotBlocks<T, Alloc> > blocks,
+                    const unsigned int site_size = 1)
+      : blocks_(blocks), site_size_(site_size)
+    { }
+
+    std::shared_ptr<detail::SnapshotBlocks<T, Alloc> > blocks_;
+    // The number of elements on each site of the lattice when the snapshot was
+    // taken, so that a Lattice of Arrays can be restored to its earlier shape
+    unsigned int site_size_;
+  };
+}
+
+#endif
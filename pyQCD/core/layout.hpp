@@ -8,9 +8,12 @@
 
 #include <functional>
 #include <numeric>
+#include <stdexcept>
 #include <type_traits>
 #include <vector>
 
+#include <utils/parallel.hpp>
+
 
 namespace pyQCD
 {
@@ -50,8 +53,21 @@ namespace pyQCD
     inline unsigned int get_site_index(const unsigned int array_index) const
     { return site_indices_[array_index]; }
 
+    template <typename T>
+    inline unsigned int compute_site_index(const T& site) const;
+    template <typename T>
+    inline void compute_site_coords(const unsigned int site_index,
+                                    T& site) const;
+    inline unsigned int compute_neighbour_index(const unsigned int site_index,
+                                                const unsigned int dim,
+                                                const int offset) const;
+
+    template <typename Fn>
+    void for_each_site(Fn fn) const;
+
     unsigned int volume() const { return lattice_volume_; }
     unsigned int num_dims() const { return num_dims_; }
+    const std::vector<unsigned int>& shape() const { return lattice_shape_; }
 
   private:
     unsigned int num_dims_, lattice_volume_;
@@ -73,19 +89,122 @@ namespace pyQCD
   };
 
 
+  class EvenOddLayout : public Layout
+  {
+    // Layout where all the even sites (those where the sum of the coordinates
+    // is even) come first, followed by all the odd sites. Within each parity
+    // sites are in lexicographic order. All lattice extents must be even.
+  public:
+    EvenOddLayout() { }
+    EvenOddLayout(const std::vector<unsigned int>& shape)
+      : Layout(shape, [&shape] (const unsigned int i)
+      {
+        const unsigned int volume
+          = std::accumulate(shape.begin(), shape.end(), 1u,
+                            std::multiplies<unsigned int>());
+        unsigned int remainder = i, coord_sum = 0;
+        for (int dim = shape.size() - 1; dim > -1; --dim) {
+          coord_sum += remainder % shape[dim];
+          remainder /= shape[dim];
+        }
+        return (coord_sum % 2) * volume / 2 + i / 2;
+      })
+    {
+      for (auto extent : shape) {
+        if (extent % 2 != 0) {
+          throw std::invalid_argument("EvenOddLayout: lattice extents must "
+                                      "be even");
+        }
+      }
+    }
+  };
+
+
   template <typename T,
     typename std::enable_if<not std::is_integral<T>::value>::type*>
   inline unsigned int Layout::get_array_index(const T& site) const
   {
     // Compute the lexicographic index of the specified site and use it to
-    // to get the array index (coordinate at site[0] varies slowest, that at
-    // site[ndim - 1] varies fastest
-    int site_index = 0;
+    // to get the array index
+    return array_indices_[compute_site_index(site)];
+  }
+
+
+  template <typename T>
+  inline unsigned int Layout::compute_site_index(const T& site) const
+  {
+    // Compute the lexicographic index of the specified site (coordinate at
+    // site[0] varies slowest, that at site[ndim - 1] varies fastest)
+    unsigned int site_index = 0;
     for (unsigned int i = 0; i < num_dims_; ++i) {
       site_index *= lattice_shape_[i];
       site_index += site[i];
     }
-    return array_indices_[site_index];
+    return site_index;
+  }
+
+
+  template <typename T>
+  inline void Layout::compute_site_coords(const unsigned int site_index,
+                                          T& site) const
+  {
+    // Invert the lexicographic index computed above, filling site with the
+    // coordinates of the specified site
+    unsigned int remainder = site_index;
+    for (int i = num_dims_ - 1; i > -1; --i) {
+      site[i] = remainder % lattice_shape_[i];
+      remainder /= lattice_shape_[i];
+    }
+  }
+
+
+  template <typename Fn>
+  void Layout::for_each_site(Fn fn) const
+  {
+    // Call fn(array_index, coords) for every site in parallel, where coords is
+    // a std::vector<unsigned int> holding the coordinates of the site. Sites
+    // are divided into contiguous chunks of site indices as in parallel_for.
+    // The coordinates are decomposed once at the start of each chunk, then
+    // stepped from one site to the next by incrementing the last coordinate
+    // and carrying into the earlier ones.
+    if (lattice_volume_ == 0) {
+      return;
+    }
+    const unsigned long volume = lattice_volume_;
+    run_on_thread_pool(
+      [&] (const unsigned int chunk, const unsigned int num_chunks) {
+        const unsigned int chunk_begin = volume * chunk / num_chunks;
+        const unsigned int chunk_end = volume * (chunk + 1) / num_chunks;
+        std::vector<unsigned int> coords(num_dims_);
+        const std::vector<unsigned int>& site = coords;
+        compute_site_coords(chunk_begin, coords);
+        dispatch([&] () {
+          for (unsigned int i = chunk_begin; i < chunk_end; ++i) {
+            fn(array_indices_[i], site);
+            unsigned int dim = num_dims_;
+            while (dim-- > 0 and ++coords[dim] == lattice_shape_[dim]) {
+              coords[dim] = 0;
+            }
+          }
+        });
+      }, volume / lattice_shape_[num_dims_ - 1]);
+  }
+
+
+  inline unsigned int Layout::compute_neighbour_index(
+    const unsigned int site_index, const unsigned int dim,
+    const int offset) const
+  {
+    // Compute the lexicographic index of the site offset from the specified
+    // site by offset sites in dimension dim, using periodic boundaries
+    unsigned int stride = 1;
+    for (unsigned int i = dim + 1; i < num_dims_; ++i) {
+      stride *= lattice_shape_[i];
+    }
+    const int extent = lattice_shape_[dim];
+    const int coord = (site_index / stride) % extent;
+    const int shifted = ((coord + offset) % extent + extent) % extent;
+    return site_index + (shifted - coord) * static_cast<int>(stride);
   }
 }
 
@@ -0,0 +1,15 @@
+from libcpp.string cimport string
+from libcpp.vector cimport vector
+
+cdef extern from "utils/profiling.hpp" namespace "pyQCD":
+    cdef cppclass KernelStats:
+        string name
+        unsigned long calls
+        double seconds
+        unsigned long flops
+        unsigned long bytes
+
+    bint profiling_enabled()
+    vector[KernelStats] profile_stats() except +
+    void reset_profile() except +
+    string profile_report() except +
@@ -0,0 +1,94 @@
+#ifndef REDUCTIONS_HPP
+#define REDUCTIONS_HPP
+
+/* This file provides reductions of lattice expressions into a small number of
+ * bins, such as the timeslice sums C(t) = sum_x f(x, t) needed to construct
+ * correlators.
+ *
+ * The expression is evaluated in a single parallel sweep over the lattice. To
+ * keep the results reproducible, the sites are divided into blocks of a fixed
+ * size that doesn't depend on the number of threads. Each block is summed in
+ * order of array index, and the partial sums of the blocks are then combined
+ * in block order. The result is therefore the same on every run and for every
+ * thread count.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <utils/macros.hpp>
+#include <utils/parallel.hpp>
+#include <utils/profiling.hpp>
+#include <utils/templates.hpp>
+#include "array.hpp"
+#include "layout.hpp"
+
+
+namespace pyQCD
+{
+  // Number of consecutive sites summed by one task
+  const unsigned long reduction_block_size = 1024;
+
+
+  template <typename T1, typename T2, typename Fn>
+  Array<T2> binned_sum(const ArrayExpr<T1, T2>& expr,
+                       const unsigned int num_bins, Fn bin)
+  {
+    // Sum the elements of expr into num_bins bins, where element i is added to
+    // bin(i)
+    PYQCD_PROFILE_SCOPE_COST("binned_sum", expression_cost(expr).flops,
+                             expression_cost(expr).bytes);
+    const unsigned long size = expr.size();
+    const unsigned long num_blocks
+      = (size + reduction_block_size - 1) / reduction_block_size;
+    const T2 zero = ZeroTraits<T2>::zero();
+
+    std::vector<T2> partials(num_blocks * num_bins, zero);
+    parallel_for(0, num_blocks, [&] (const unsigned long block) {
+      T2* block_partials = partials.data() + block * num_bins;
+      const unsigned long end
+        = std::min(size, (block + 1) * reduction_block_size);
+      for (unsigned long i = block * reduction_block_size; i < end; ++i) {
+        const unsigned int b = bin(i);
+        pyQCDassert ((b < num_bins),
+          std::out_of_range("binned_sum: bin(i) >= num_bins"));
+        block_partials[b] += expr[i];
+      }
+    });
+
+    Array<T2> ret(num_bins, zero);
+    for (unsigned long block = 0; block < num_blocks; ++block) {
+      for (unsigned int b = 0; b < num_bins; ++b) {
+        ret[b] += partials[block * num_bins + b];
+      }
+    }
+    return ret;
+  }
+
+
+  template <typename T1, typename T2>
+  Array<T2> timeslice_sum(const ArrayExpr<T1, T2>& expr,
+                          const unsigned int dim = 0)
+  {
+    // Sum expr over each slice of the lattice in dimension dim (by default the
+    // time dimension). The expression must have a layout.
+    const Layout* layout = expr.layout();
+    pyQCDassert ((layout != nullptr),
+      std::invalid_argument("timeslice_sum: expr has no layout"));
+    pyQCDassert ((dim < layout->num_dims()),
+      std::out_of_range("timeslice_sum: dim >= num_dims()"));
+
+    // Lexicographic site indices vary fastest in the last dimension
+    unsigned int stride = 1;
+    for (unsigned int d = dim + 1; d < layout->num_dims(); ++d) {
+      stride *= layout->shape()[d];
+    }
+    const unsigned int extent = layout->shape()[dim];
+    return binned_sum(expr, extent, [=] (const unsigned long i) {
+      return (layout->get_site_index(i) / stride) % extent;
+    });
+  }
+}
+
+#endif
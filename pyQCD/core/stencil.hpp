@@ -0,0 +1,342 @@
+#ifndef STENCIL_HPP
+#define STENCIL_HPP
+
+/* This file provides the Stencil class, which compiles a set of terms of the
+ * form
+ *
+ *   c * W(x, x + path) psi(x + path)
+ *
+ * into a single kernel over the lattice. Here path is a sequence of single
+ * hops in the positive or negative direction of some dimension and W is the
+ * product of the gauge links along the path (U_mu(y) for a forward hop from y
+ * and U_mu^dagger(y - mu) for a backward hop). Straight shifts by several
+ * sites, covariant Laplacians, improved derivatives and closed loops such as
+ * clover leaves can all be written this way.
+ *
+ * When the stencil is constructed, the array indices of the sites reached by
+ * each term and of the links along each path are tabulated for every site, so
+ * applying it involves no coordinate arithmetic. The link products are
+ * applied to the field one matrix-vector product at a time, and the result at
+ * each site is accumulated directly in the output.
+ *
+ * Calling the stencil on a field gives an Array expression, so it can be
+ * combined with other expressions, e.g. psi - kappa * hopping(links, psi).
+ * Stencil::apply evaluates the stencil into an output field in parallel, as
+ * does assigning any expression that contains a stencil to an Array or
+ * Lattice (see ParallelEvaluationTraits in array_traits.hpp).
+ */
+
+#include <complex>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <utils/macros.hpp>
+#include <utils/parallel.hpp>
+#include <utils/profiling.hpp>
+#include <utils/templates.hpp>
+#include "detail/array_expr.hpp"
+#include "layout.hpp"
+
+
+namespace pyQCD
+{
+  struct Hop
+  {
+    // A hop to the neighbouring site in dimension dim, forwards if sign > 0
+    unsigned int dim;
+    int sign;
+  };
+
+
+  template <typename Coeff>
+  struct StencilTerm
+  {
+    Coeff coefficient;
+    std::vector<Hop> path;
+  };
+
+
+  template <typename Coeff>
+  StencilTerm<Coeff> shift_term(const Coeff& coefficient,
+                                const unsigned int dim, const int offset)
+  {
+    // Term for a straight path of offset sites in dimension dim
+    StencilTerm<Coeff> ret{coefficient, {}};
+    for (int i = 0; i < std::abs(offset); ++i) {
+      ret.path.push_back(Hop{dim, offset > 0 ? 1 : -1});
+    }
+    return ret;
+  }
+
+
+  namespace detail
+  {
+    // Stand-in for the gauge field in stencils with unit links
+    struct UnitLinks { };
+
+
+    // out = W in for the link W of a single hop. out must not alias in.
+    template <typename Links, typename V>
+    void apply_link(const Links& links, const unsigned int site,
+                    const unsigned int dim, const bool dagger, const V& in,
+                    V& out)
+    {
+      const auto& link = links[site][dim];
+      if (dagger) {
+        out.noalias() = link.adjoint() * in;
+      }
+      else {
+        out.noalias() = link * in;
+      }
+    }
+
+
+    template <typename V>
+    void apply_link(const UnitLinks& links, const unsigned int site,
+                    const unsigned int dim, const bool dagger, const V& in,
+                    V& out)
+    { out = in; }
+  }
+
+
+  template <typename Coeff, typename Links, typename Field>
+  class StencilExpr;
+
+
+  template <typename Coeff = std::complex<double> >
+  class Stencil
+  {
+  public:
+    Stencil(const Layout& layout,
+            const std::vector<StencilTerm<Coeff> >& terms);
+
+    template <typename Links, typename Field>
+    StencilExpr<Coeff, Links, Field> operator()(const Links& links,
+                                                const Field& in) const
+    { return StencilExpr<Coeff, Links, Field>(*this, links, in); }
+    template <typename Field>
+    StencilExpr<Coeff, detail::UnitLinks, Field> operator()(
+      const Field& in) const
+    { return StencilExpr<Coeff, detail::UnitLinks, Field>(*this, unit_links_,
+                                                          in); }
+
+    template <typename Links, typename Field>
+    void apply(const Links& links, const Field& in, Field& out) const;
+    template <typename Field>
+    void apply(const Field& in, Field& out) const
+    { apply(unit_links_, in, out); }
+
+    // Compute the stencil at the site with the specified array index
+    template <typename Links, typename Field>
+    typename std::decay<decltype(std::declval<Field>()[0])>::type
+    compute_site(const Links& links, const Field& in,
+                 const unsigned int i) const;
+    template <typename Links, typename Field, typename T>
+    void compute_site(const Links& links, const Field& in,
+                      const unsigned int i, T& out) const;
+    // Compute the stencil at the sites with array indices [begin, end),
+    // writing the result for site i to out[i]
+    template <typename Links, typename Field, typename T>
+    void compute(const Links& links, const Field& in, T* out,
+                 const unsigned long begin, const unsigned long end) const
+    {
+      for (unsigned long i = begin; i < end; ++i) {
+        compute_site(links, in, i, out[i]);
+      }
+    }
+
+    const Layout& layout() const { return *layout_; }
+    unsigned int num_terms() const { return coefficients_.size(); }
+
+  private:
+    const Layout* layout_;
+    unsigned int volume_;
+    std::vector<Coeff> coefficients_;
+    // The dimension of each hop and whether its link is daggered, with the
+    // hops of term t starting at hop_offsets_[t]
+    std::vector<unsigned int> hop_offsets_, hop_dims_;
+    std::vector<unsigned char> hop_daggers_;
+    // targets_[i * num_terms + t] -> array index of the site reached by term t
+    // from the site with array index i
+    std::vector<unsigned int> targets_;
+    // link_sites_[i * num_hops + h] -> array index of the site holding the link
+    // for hop h from the site with array index i
+    std::vector<unsigned int> link_sites_;
+    detail::UnitLinks unit_links_;
+  };
+
+
+  template <typename Coeff>
+  Stencil<Coeff>::Stencil(const Layout& layout,
+                          const std::vector<StencilTerm<Coeff> >& terms)
+    : layout_(&layout), volume_(layout.volume())
+  {
+    for (auto& term : terms) {
+      coefficients_.push_back(term.coefficient);
+      hop_offsets_.push_back(hop_dims_.size());
+      for (auto& hop : term.path) {
+        pyQCDassert ((hop.dim < layout.num_dims() and hop.sign != 0),
+          std::invalid_argument("Stencil: invalid hop"));
+        hop_dims_.push_back(hop.dim);
+        hop_daggers_.push_back(hop.sign < 0);
+      }
+    }
+    hop_offsets_.push_back(hop_dims_.size());
+
+    // The tables are ordered by site so that each site's entries are adjacent
+    const unsigned int num_terms = terms.size();
+    const unsigned int num_hops = hop_dims_.size();
+    targets_.resize(num_terms * volume_);
+    link_sites_.resize(num_hops * volume_);
+    for (unsigned int i = 0; i < volume_; ++i) {
+      for (unsigned int t = 0; t < num_terms; ++t) {
+        unsigned int site = layout.get_site_index(i);
+        unsigned int h = hop_offsets_[t];
+        for (auto& hop : terms[t].path) {
+          if (hop.sign > 0) {
+            link_sites_[i * num_hops + h] = layout.get_array_index(site);
+            site = layout.compute_neighbour_index(site, hop.dim, 1);
+          }
+          else {
+            site = layout.compute_neighbour_index(site, hop.dim, -1);
+            link_sites_[i * num_hops + h] = layout.get_array_index(site);
+          }
+          ++h;
+        }
+        targets_[i * num_terms + t] = layout.get_array_index(site);
+      }
+    }
+  }
+
+
+  template <typename Coeff>
+  template <typename Links, typename Field>
+  typename std::decay<decltype(std::declval<Field>()[0])>::type
+  Stencil<Coeff>::compute_site(const Links& links, const Field& in,
+                               const unsigned int i) const
+  {
+    typename std::decay<decltype(in[0])>::type ret;
+    compute_site(links, in, i, ret);
+    return ret;
+  }
+
+
+  template <typename Coeff>
+  template <typename Links, typename Field, typename T>
+  void Stencil<Coeff>::compute_site(const Links& links, const Field& in,
+                                    const unsigned int i, T& out) const
+  {
+    typedef typename std::decay<decltype(in[0])>::type V;
+    const unsigned int num_terms = coefficients_.size();
+    const unsigned int* targets = targets_.data() + i * num_terms;
+    const unsigned int* link_sites = link_sites_.data() + i * hop_dims_.size();
+
+    out = ZeroTraits<V>::zero();
+    V vec, tmp;
+    for (unsigned int t = 0; t < num_terms; ++t) {
+      const unsigned int hop_begin = hop_offsets_[t];
+      unsigned int h = hop_offsets_[t + 1];
+      if (h == hop_begin) {
+        out += coefficients_[t] * in[targets[t]];
+        continue;
+      }
+      // W = L_0 L_1 ... L_n-1, so apply the links from the far end of the
+      // path, starting with the field at the target site
+      --h;
+      detail::apply_link(links, link_sites[h], hop_dims_[h], hop_daggers_[h],
+                         in[targets[t]], vec);
+      while (h-- > hop_begin) {
+        detail::apply_link(links, link_sites[h], hop_dims_[h],
+                           hop_daggers_[h], vec, tmp);
+        vec = tmp;
+      }
+      out += coefficients_[t] * vec;
+    }
+  }
+
+
+  template <typename Coeff>
+  template <typename Links, typename Field>
+  void Stencil<Coeff>::apply(const Links& links, const Field& in,
+                             Field& out) const
+  {
+    pyQCDassert ((in.size() == volume_ and out.size() == volume_),
+      std::out_of_range("Stencil::apply: field size != volume"));
+    pyQCDassert ((&in != &out),
+      std::invalid_argument("Stencil::apply: in and out must differ"));
+    PYQCD_PROFILE_SCOPE("Stencil::apply");
+    out.prepare_write();
+    parallel_for(0, volume_, [&] (const unsigned long i) {
+      compute_site(links, in, i, out[i]);
+    }, 1024);
+    out.touch();
+  }
+
+
+  template <typename Coeff, typename Links, typename Field>
+  class StencilExpr
+    : public ArrayExpr<StencilExpr<Coeff, Links, Field>,
+        typename std::decay<decltype(std::declval<Field>()[0])>::type>
+  {
+    // Expression subclass for a stencil applied to a field
+  public:
+    typedef typename std::decay<decltype(std::declval<Field>()[0])>::type
+      value_type;
+
+    StencilExpr(const Stencil<Coeff>& stencil, const Links& links,
+                const Field& in)
+      : stencil_(stencil), links_(links), in_(in)
+    {
+      pyQCDassert ((in.size() == stencil.layout().volume()),
+        std::out_of_range("StencilExpr: in.size() != volume"));
+    }
+
+    value_type operator[](const unsigned long i) const
+    { return stencil_.compute_site(links_, in_, i); }
+    // Evaluate the sites [begin, end) straight into out, for when the stencil
+    // is the whole of an expression
+    template <typename T>
+    void compute(T* out, const unsigned long begin,
+                 const unsigned long end) const
+    { stencil_.compute(links_, in_, out, begin, end); }
+
+    unsigned long size() const { return in_.size(); }
+    const Layout* layout() const { return &stencil_.layout(); }
+
+  private:
+    const Stencil<Coeff>& stencil_;
+    const Links& links_;
+    const Field& in_;
+  };
+
+
+  // The expression refers to its operands, so it's cheap to hold by value when
+  // it's an operand of another expression
+  template <typename Coeff, typename Links, typename Field>
+  struct OperandTraits<StencilExpr<Coeff, Links, Field> >
+  {
+    typedef StencilExpr<Coeff, Links, Field> type;
+  };
+
+
+  // Each site of a stencil does several matrix-vector products, so
+  // expressions containing one are evaluated in parallel
+  template <typename Coeff, typename Links, typename Field>
+  struct ParallelEvaluationTraits<StencilExpr<Coeff, Links, Field> >
+    : std::true_type
+  { };
+
+
+  template <typename T, typename Coeff, typename Links, typename Field,
+            typename U>
+  void assign_elements(
+    T* ptr, const ArrayExpr<StencilExpr<Coeff, Links, Field>, U>& expr,
+    const unsigned long begin, const unsigned long end)
+  {
+    static_cast<const StencilExpr<Coeff, Links, Field>&>(expr).compute(
+      ptr, begin, end);
+  }
+}
+
+#endif
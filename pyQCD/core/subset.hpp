@@ -0,0 +1,207 @@
+#ifndef SUBSET_HPP
+#define SUBSET_HPP
+
+/* This file provides the Subset class, which specifies a subset of the sites
+ * of a lattice, e.g. a single timeslice, one checkerboard parity or a sparse
+ * list of source sites. Subsets can be passed to Lattice::assign to evaluate
+ * an expression on the selected sites only, and to the reduction functions
+ * below.
+ *
+ * A subset is stored as a sorted list of ranges of array indices, so that
+ * sites that are contiguous in memory are processed in a single loop. Because
+ * the ranges are in terms of array indices, a subset is only valid for
+ * lattices with the layout it was created with. Subsets made from a layout
+ * keep a pointer to it, and assign(), sum() and reduce() check that the
+ * lattice or expression has a layout of the same type and shape. Subsets made
+ * directly from array indices have no layout and aren't checked.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include <utils/macros.hpp>
+#include "detail/array_expr.hpp"
+#include "layout.hpp"
+
+
+namespace pyQCD
+{
+  class Subset
+  {
+  public:
+    // Range of array indices [first, second)
+    typedef std::pair<unsigned int, unsigned int> range_type;
+
+    Subset() : layout_(nullptr), size_(0) { }
+    Subset(const unsigned int begin, const unsigned int end,
+           const Layout* layout = nullptr)
+      : layout_(layout), size_(0)
+    { add_range(begin, end); }
+    explicit Subset(std::vector<unsigned int> array_indices,
+                    const Layout* layout = nullptr);
+
+    const std::vector<range_type>& ranges() const { return ranges_; }
+    // The number of sites in the subset
+    unsigned long size() const { return size_; }
+    // The layout the subset was created with, or nullptr if there isn't one
+    const Layout* layout() const { return layout_; }
+    // Whether the subset can be used with the specified layout
+    bool is_valid_for(const Layout* layout) const;
+
+    template <typename Fn>
+    void for_each(Fn fn) const
+    {
+      for (auto& range : ranges_) {
+        for (unsigned int i = range.first; i < range.second; ++i) {
+          fn(i);
+        }
+      }
+    }
+
+  private:
+    void add_range(const unsigned int begin, const unsigned int end);
+
+    const Layout* layout_;
+    std::vector<range_type> ranges_;
+    unsigned long size_;
+  };
+
+
+  inline Subset::Subset(std::vector<unsigned int> array_indices,
+                        const Layout* layout)
+    : layout_(layout), size_(0)
+  {
+    std::sort(array_indices.begin(), array_indices.end());
+    array_indices.erase(
+      std::unique(array_indices.begin(), array_indices.end()),
+      array_indices.end());
+    for (auto index : array_indices) {
+      add_range(index, index + 1);
+    }
+  }
+
+
+  inline void Subset::add_range(const unsigned int begin,
+                                const unsigned int end)
+  {
+    // Ranges must be added in ascending order. Adjacent ranges are merged.
+    if (begin >= end) {
+      return;
+    }
+    if (not ranges_.empty() and ranges_.back().second == begin) {
+      ranges_.back().second = end;
+    }
+    else {
+      ranges_.push_back(range_type(begin, end));
+    }
+    size_ += end - begin;
+  }
+
+
+  inline bool Subset::is_valid_for(const Layout* layout) const
+  {
+    if (layout_ == nullptr or layout == nullptr or layout_ == layout) {
+      return true;
+    }
+    return typeid(*layout_) == typeid(*layout)
+      and layout_->shape() == layout->shape();
+  }
+
+
+  template <typename Pred>
+  Subset make_subset(const Layout& layout, Pred pred)
+  {
+    // Create the subset of sites for which pred(site_index) is true
+    std::vector<unsigned int> array_indices;
+    for (unsigned int i = 0; i < layout.volume(); ++i) {
+      if (pred(layout.get_site_index(i))) {
+        array_indices.push_back(i);
+      }
+    }
+    return Subset(array_indices, &layout);
+  }
+
+
+  inline Subset timeslice_subset(const Layout& layout, const unsigned int t,
+                                 const unsigned int dim = 0)
+  {
+    pyQCDassert ((dim < layout.num_dims() and t < layout.shape()[dim]),
+      std::out_of_range("timeslice_subset: invalid timeslice"));
+    std::vector<unsigned int> coords(layout.num_dims());
+    return make_subset(layout, [&] (const unsigned int site_index) {
+      layout.compute_site_coords(site_index, coords);
+      return coords[dim] == t;
+    });
+  }
+
+
+  inline Subset parity_subset(const Layout& layout, const unsigned int parity)
+  {
+    // Sites where the sum of the coordinates is even (parity = 0) or odd
+    // (parity = 1)
+    std::vector<unsigned int> coords(layout.num_dims());
+    return make_subset(layout, [&] (const unsigned int site_index) {
+      layout.compute_site_coords(site_index, coords);
+      unsigned int coord_sum = 0;
+      for (auto coord : coords) {
+        coord_sum += coord;
+      }
+      return coord_sum % 2 == parity % 2;
+    });
+  }
+
+
+  inline Subset site_subset(const Layout& layout,
+                            const std::vector<unsigned int>& site_indices)
+  {
+    // Subset of the sites with the specified lexicographic indices
+    std::vector<unsigned int> array_indices(site_indices.size());
+    for (unsigned int i = 0; i < site_indices.size(); ++i) {
+      pyQCDassert ((site_indices[i] < layout.volume()),
+        std::out_of_range("site_subset: invalid site index"));
+      array_indices[i] = layout.get_array_index(site_indices[i]);
+    }
+    return Subset(array_indices, &layout);
+  }
+
+
+  template <typename T1, typename T2, typename U, typename Fn>
+  U reduce(const ArrayExpr<T1, T2>& expr, const Subset& subset, U init,
+           Fn fn)
+  {
+    // Fold fn over the elements of expr in the subset, in order of array index
+    if (subset.size() > 0) {
+      pyQCDassert ((subset.ranges().back().second <= expr.size()),
+        std::out_of_range("reduce: subset exceeds expr.size()"));
+    }
+    pyQCDassert ((subset.is_valid_for(expr.layout())), std::bad_cast());
+    subset.for_each([&] (const unsigned int i) { init = fn(init, expr[i]); });
+    return init;
+  }
+
+
+  template <typename T1, typename T2>
+  T2 sum(const ArrayExpr<T1, T2>& expr, const Subset& subset)
+  {
+    // The subset must not be empty, as some element types (e.g. Eigen
+    // matrices) have no zero value by default
+    pyQCDassert ((subset.size() > 0),
+      std::invalid_argument("sum: subset is empty"));
+    pyQCDassert ((subset.ranges().back().second <= expr.size()),
+      std::out_of_range("sum: subset exceeds expr.size()"));
+    pyQCDassert ((subset.is_valid_for(expr.layout())), std::bad_cast());
+    const unsigned int first = subset.ranges().front().first;
+    T2 ret = expr[first];
+    subset.for_each([&] (const unsigned int i) {
+      if (i != first) {
+        ret += expr[i];
+      }
+    });
+    return ret;
+  }
+}
+
+#endif
@@ -0,0 +1,3 @@
+cdef extern from "utils/thread_pool.hpp" namespace "pyQCD":
+    unsigned int num_threads() except +
+    void set_num_threads(const unsigned int, const bint) except +
\ No newline at end of file
@@ -0,0 +1,291 @@
+#ifndef CLOVER_HPP
+#define CLOVER_HPP
+
+/* This file provides the Sheikholeslami-Wohlert (clover) term,
+ *
+ *   A(x) = -c_sw / 2 sum_{mu < nu} sigma_{mu nu} F_{mu nu}(x),
+ *
+ * where F_{mu nu} is the four-leaf clover discretisation of the field strength.
+ *
+ * In the chiral basis sigma_{mu nu} is block diagonal, so A(x) is made up of
+ * two Hermitian (2N x 2N) blocks, one for each chirality. These are stored
+ * packed, keeping only the real diagonal and the upper triangle of each block,
+ * so the clover term for the whole lattice occupies a single contiguous buffer
+ * of 8 N^2 reals per site.
+ *
+ * The packed blocks are cached against the version of the gauge field they
+ * were computed from, and are only recomputed when the links have changed.
+ * The cache is refreshed under a mutex, so several threads may call apply()
+ * or block() on the same CloverTerm at once. The gauge field must not be
+ * modified while they do.
+ */
+
+#include <atomic>
+#include <complex>
+#include <mutex>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <core/detail/matrix_kernels.hpp>
+#include <core/lattice.hpp>
+#include <core/matrix_array.hpp>
+#include <utils/macros.hpp>
+#include <utils/matrices.hpp>
+#include <utils/profiling.hpp>
+
+
+namespace pyQCD
+{
+  template <int N, typename T = double>
+  class CloverTerm
+  {
+  public:
+    typedef Lattice<MatrixArray<N, N, T> > GaugeField;
+    typedef Lattice<MatrixArray<N, 1, T> > FermionField;
+    typedef Eigen::Matrix<std::complex<T>, N, N> ColourMatrix;
+    typedef Eigen::Matrix<std::complex<T>, 2 * N, 2 * N> BlockMatrix;
+
+    CloverTerm(const GaugeField& links, const T csw);
+
+    // out(x) = A(x) in(x), where the fermion field has four spin components
+    void apply(const FermionField& in, FermionField& out) const;
+
+    // Unpack the block of the specified chirality (0 = positive, spins 0 and
+    // 1; 1 = negative, spins 2 and 3) at the specified array index.
+    BlockMatrix block(const unsigned int index,
+                      const unsigned int chirality) const;
+    // The four-leaf field strength F_{mu nu} at the specified array index
+    ColourMatrix field_strength(const unsigned int index,
+                                const unsigned int mu,
+                                const unsigned int nu) const;
+
+    // Recompute the packed blocks if the gauge field has been modified since
+    // they were last computed. Returns true if a recomputation took place.
+    bool update() const;
+
+    T csw() const { return csw_; }
+    unsigned long version() const { return version_.load(); }
+    static constexpr unsigned int packed_block_size = 4 * N * N;
+
+  private:
+    void compute() const;
+
+    const GaugeField& links_;
+    T csw_;
+    // Cache state - mutable so that the const interface can refresh it. The
+    // version is only stored once packed_data_ is complete, and a refresh is
+    // done holding mutex_.
+    mutable std::atomic<unsigned long> version_;
+    mutable std::vector<T> packed_data_;
+    mutable std::mutex mutex_;
+  };
+
+
+  template <int N, typename T>
+  CloverTerm<N, T>::CloverTerm(const GaugeField& links, const T csw)
+    : links_(links), csw_(csw), version_(0)
+  {
+    pyQCDassert ((links.num_dims() == 4),
+                 std::invalid_argument("CloverTerm: lattice must be 4D"));
+    compute();
+  }
+
+
+  template <int N, typename T>
+  bool CloverTerm<N, T>::update() const
+  {
+    if (version_.load(std::memory_order_acquire) == links_.version()) {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Another thread may have refreshed the cache while this one waited
+    if (version_.load(std::memory_order_relaxed) == links_.version()) {
+      return false;
+    }
+    compute();
+    return true;
+  }
+
+
+  template <int N, typename T>
+  typename CloverTerm<N, T>::ColourMatrix
+  CloverTerm<N, T>::field_strength(const unsigned int index,
+                                   const unsigned int mu,
+                                   const unsigned int nu) const
+  {
+    // Sum the four plaquette leaves in the mu-nu plane that have a corner at
+    // x, all oriented the same way, then take the traceless anti-Hermitian
+    // part: F = (Q - Q^dag) / 8i - Tr(...) / N
+    const Layout& layout = *links_.layout();
+    auto link = [&] (const unsigned int site, const unsigned int dim)
+      -> const ColourMatrix&
+    { return links_[layout.get_array_index(site)][dim]; };
+
+    const unsigned int x = layout.get_site_index(index);
+    const unsigned int x_pmu = layout.compute_neighbour_index(x, mu, 1);
+    const unsigned int x_pnu = layout.compute_neighbour_index(x, nu, 1);
+    const unsigned int x_mmu = layout.compute_neighbour_index(x, mu, -1);
+    const unsigned int x_mnu = layout.compute_neighbour_index(x, nu, -1);
+    const unsigned int x_mmu_pnu
+      = layout.compute_neighbour_index(x_mmu, nu, 1);
+    const unsigned int x_mmu_mnu
+      = layout.compute_neighbour_index(x_mmu, nu, -1);
+    const unsigned int x_pmu_mnu
+      = layout.compute_neighbour_index(x_pmu, nu, -1);
+
+    // Each leaf is built up with the small-matrix kernels, rewriting products
+    // that start with an adjoint as the adjoint of a product where possible
+    ColourMatrix leaves, tmp1, tmp2, tmp3;
+    // U_mu(x) U_nu(x + mu) U_mu^dag(x + nu) U_nu^dag(x)
+    multiply(link(x, mu), link(x_pmu, nu), tmp1);
+    multiply_adjoint(tmp1, link(x_pnu, mu), tmp2);
+    multiply_adjoint(tmp2, link(x, nu), leaves);
+    // U_nu(x) U_mu^dag(x - mu + nu) U_nu^dag(x - mu) U_mu(x - mu)
+    multiply_adjoint(link(x, nu), link(x_mmu_pnu, mu), tmp1);
+    multiply_adjoint(tmp1, link(x_mmu, nu), tmp2);
+    multiply(tmp2, link(x_mmu, mu), tmp1);
+    leaves += tmp1;
+    // [U_nu(x - mu - nu) U_mu(x - mu)]^dag U_mu(x - mu - nu) U_nu(x - nu)
+    multiply(link(x_mmu_mnu, nu), link(x_mmu, mu), tmp1);
+    adjoint(tmp1, tmp2);
+    multiply(tmp2, link(x_mmu_mnu, mu), tmp1);
+    multiply(tmp1, link(x_mnu, nu), tmp3);
+    leaves += tmp3;
+    // U_nu^dag(x - nu) U_mu(x - nu) U_nu(x + mu - nu) U_mu^dag(x)
+    adjoint(link(x_mnu, nu), tmp1);
+    multiply(tmp1, link(x_mnu, mu), tmp2);
+    multiply(tmp2, link(x_pmu_mnu, nu), tmp1);
+    multiply_adjoint(tmp1, link(x, mu), tmp2);
+    leaves += tmp2;
+
+    const std::complex<T> I(0.0, 1.0);
+    ColourMatrix ret = (leaves - leaves.adjoint()) / (8.0 * I);
+    ret.diagonal().array() -= ret.trace() / static_cast<T>(N);
+    return ret;
+  }
+
+
+  template <int N, typename T>
+  void CloverTerm<N, T>::compute() const
+  {
+    const unsigned int volume = links_.volume();
+    packed_data_.resize(2 * packed_block_size * volume);
+
+    // Chiral blocks of -c_sw / 2 sigma_{mu nu}, which are used to form the
+    // spin structure of each block
+    Eigen::Matrix<std::complex<T>, 2, 2> sigma_blocks[2][6];
+    unsigned int plane = 0;
+    for (unsigned int mu = 0; mu < 4; ++mu) {
+      for (unsigned int nu = mu + 1; nu < 4; ++nu) {
+        const SpinMatrix s = -0.5 * static_cast<double>(csw_) * sigma(mu, nu);
+        for (unsigned int chi = 0; chi < 2; ++chi) {
+          sigma_blocks[chi][plane]
+            = s.block<2, 2>(2 * chi, 2 * chi).template cast<std::complex<T> >();
+        }
+        ++plane;
+      }
+    }
+
+    for (unsigned int index = 0; index < volume; ++index) {
+      ColourMatrix field_strengths[6];
+      plane = 0;
+      for (unsigned int mu = 0; mu < 4; ++mu) {
+        for (unsigned int nu = mu + 1; nu < 4; ++nu) {
+          field_strengths[plane++] = field_strength(index, mu, nu);
+        }
+      }
+
+      for (unsigned int chi = 0; chi < 2; ++chi) {
+        BlockMatrix blk = BlockMatrix::Zero();
+        for (unsigned int p = 0; p < 6; ++p) {
+          for (unsigned int a = 0; a < 2; ++a) {
+            for (unsigned int b = 0; b < 2; ++b) {
+              blk.template block<N, N>(N * a, N * b)
+                += sigma_blocks[chi][p](a, b) * field_strengths[p];
+            }
+          }
+        }
+
+        // Pack: diagonal first, followed by the strict upper triangle in
+        // row-major order
+        T* packed = &packed_data_[(2 * index + chi) * packed_block_size];
+        for (unsigned int i = 0; i < 2 * N; ++i) {
+          *packed++ = blk(i, i).real();
+        }
+        for (unsigned int i = 0; i < 2 * N; ++i) {
+          for (unsigned int j = i + 1; j < 2 * N; ++j) {
+            *packed++ = blk(i, j).real();
+            *packed++ = blk(i, j).imag();
+          }
+        }
+      }
+    }
+
+    version_.store(links_.version(), std::memory_order_release);
+  }
+
+
+  template <int N, typename T>
+  typename CloverTerm<N, T>::BlockMatrix
+  CloverTerm<N, T>::block(const unsigned int index,
+                          const unsigned int chirality) const
+  {
+    update();
+    const T* packed = &packed_data_[(2 * index + chirality)
+                                    * packed_block_size];
+    BlockMatrix ret;
+    for (unsigned int i = 0; i < 2 * N; ++i) {
+      ret(i, i) = *packed++;
+    }
+    for (unsigned int i = 0; i < 2 * N; ++i) {
+      for (unsigned int j = i + 1; j < 2 * N; ++j) {
+        ret(i, j) = std::complex<T>(packed[0], packed[1]);
+        ret(j, i) = std::conj(ret(i, j));
+        packed += 2;
+      }
+    }
+    return ret;
+  }
+
+
+  template <int N, typename T>
+  void CloverTerm<N, T>::apply(const FermionField& in, FermionField& out) const
+  {
+    pyQCDassert ((in.volume() == links_.volume()),
+                 std::out_of_range("CloverTerm::apply: in.volume()"));
+    update();
+    PYQCD_PROFILE_SCOPE("CloverTerm::apply");
+
+    for (unsigned int index = 0; index < in.volume(); ++index) {
+      for (unsigned int chi = 0; chi < 2; ++chi) {
+        // Multiply directly from the packed representation, using the
+        // Hermiticity of the block to recover the lower triangle
+        const T* packed = &packed_data_[(2 * index + chi) * packed_block_size];
+        const std::complex<T>* psi[2] = {in[index][2 * chi].data(),
+                                         in[index][2 * chi + 1].data()};
+        auto in_elem = [&] (const unsigned int i) -> const std::complex<T>&
+        { return psi[i / N][i % N]; };
+
+        std::complex<T> result[2 * N];
+        for (unsigned int i = 0; i < 2 * N; ++i) {
+          result[i] = *packed++ * in_elem(i);
+        }
+        for (unsigned int i = 0; i < 2 * N; ++i) {
+          for (unsigned int j = i + 1; j < 2 * N; ++j) {
+            const std::complex<T> elem(packed[0], packed[1]);
+            result[i] += elem * in_elem(j);
+            result[j] += std::conj(elem) * in_elem(i);
+            packed += 2;
+          }
+        }
+
+        for (unsigned int i = 0; i < 2 * N; ++i) {
+          out[index][2 * chi + i / N][i % N] = result[i];
+        }
+      }
+    }
+  }
+}
+
+#endif
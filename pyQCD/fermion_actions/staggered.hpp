@@ -0,0 +1,290 @@
+#ifndef STAGGERED_HPP
+#define STAGGERED_HPP
+
+/* This file provides the staggered Dirac operator,
+ *
+ *   M psi(x) = m psi(x)
+ *     + 1/2 sum_mu eta_mu(x) [V_mu(x) psi(x + mu)
+ *                             - V_mu^dag(x - mu) psi(x - mu)]
+ *     + c_3 / 2 sum_mu eta_mu(x) [W_mu(x) psi(x + 3 mu)
+ *                                 - W_mu^dag(x - 3 mu) psi(x - 3 mu)],
+ *
+ * where eta_mu(x) = (-1)^(x_0 + ... + x_{mu - 1}) are the staggered phases. V
+ * are the (possibly fattened) one-hop links and W the long (Naik) links. For
+ * the unimproved operator V = U and there are no long links; for asqtad/HISQ
+ * style actions the smeared links are passed in along with the Naik
+ * coefficient.
+ *
+ * The staggered phases, boundary conditions and the factors of 1/2 and c_3 are
+ * folded once into a private, double-stored copy of the links, which is stored
+ * in even-odd order along with a neighbour table, so the operator application
+ * itself is nothing more than link-vector products. Fermion fields are
+ * single-spinor colour vectors, stored as MatrixArray<N, 1> in the order given
+ * by the EvenOddLayout returned by layout(), so the even and odd halves of a
+ * field are each contiguous.
+ */
+
+#include <complex>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <core/detail/matrix_kernels.hpp>
+#include <core/double_stored_gauge_field.hpp>
+#include <core/lattice.hpp>
+#include <core/layout.hpp>
+#include <core/matrix_array.hpp>
+#include <utils/cpu_dispatch.hpp>
+#include <utils/macros.hpp>
+#include <utils/profiling.hpp>
+
+
+namespace pyQCD
+{
+  template <int N, typename T = double>
+  class StaggeredOperator
+  {
+  public:
+    typedef Lattice<MatrixArray<N, N, T> > GaugeField;
+    typedef MatrixArray<N, 1, T> ColourField;
+    typedef Eigen::Matrix<std::complex<T>, N, N> ColourMatrix;
+    typedef Eigen::Matrix<std::complex<T>, N, 1> ColourVector;
+
+    // Unimproved staggered operator built from the thin links
+    StaggeredOperator(const GaugeField& links, const T mass,
+                      const std::vector<std::complex<T> >& boundary_phases);
+    // Improved operator with fat one-hop links, long three-hop links and
+    // Naik coefficient c_3
+    StaggeredOperator(const GaugeField& fat_links,
+                      const GaugeField& long_links, const T naik_coefficient,
+                      const T mass,
+                      const std::vector<std::complex<T> >& boundary_phases);
+    // The folded links refer to the layout owned by this object
+    StaggeredOperator(const StaggeredOperator<N, T>&) = delete;
+
+    // out = M in, where in and out cover the whole lattice
+    void apply(const ColourField& in, ColourField& out) const;
+    // out = D_{p, 1 - p} in, where in is a field on the sites of parity
+    // 1 - p and out is a field on the sites of parity p
+    void apply_hopping(const ColourField& in, ColourField& out,
+                       const unsigned int parity) const;
+    // out = (m^2 - D_eo D_oe) in, the Hermitian positive definite even-odd
+    // preconditioned operator acting on even sites
+    void apply_even_odd(const ColourField& in, ColourField& out) const;
+
+    // Given a full source b, compute the source m b_e - D_eo b_o for the even-
+    // odd preconditioned system
+    void prepare_even_odd_source(const ColourField& source,
+                                 ColourField& even_source) const;
+    // Given the solution on the even sites of the even-odd preconditioned
+    // system and the original source, compute the solution on all sites
+    void reconstruct_solution(const ColourField& source,
+                              const ColourField& even_solution,
+                              ColourField& solution) const;
+
+    const EvenOddLayout& layout() const { return layout_; }
+    unsigned int volume() const { return layout_.volume(); }
+    unsigned int half_volume() const { return layout_.volume() / 2; }
+    T mass() const { return mass_; }
+
+  private:
+    DoubleStoredGaugeField<N, T> fold_links(const GaugeField& links,
+                                            const unsigned int hops,
+                                            const T coefficient) const;
+    // Computes the hopping term for the array indices [begin, end) of the
+    // full lattice. The array indices of in and out are shifted by in_offset
+    // and out_offset respectively, to allow for half-lattice fields.
+    void apply_hopping_range(const ColourField& in, ColourField& out,
+                             const unsigned int begin, const unsigned int end,
+                             const unsigned int in_offset,
+                             const unsigned int out_offset) const;
+
+    EvenOddLayout layout_;
+    T mass_;
+    unsigned int num_dims_;
+    std::vector<std::complex<T> > boundary_phases_;
+    bool improved_;
+    // Links with phases, boundary conditions and coefficients folded in
+    DoubleStoredGaugeField<N, T> links_, long_links_;
+  };
+
+
+  template <int N, typename T>
+  StaggeredOperator<N, T>::StaggeredOperator(
+    const GaugeField& links, const T mass,
+    const std::vector<std::complex<T> >& boundary_phases)
+    : layout_(links.layout()->shape()), mass_(mass),
+      num_dims_(links.num_dims()), boundary_phases_(boundary_phases),
+      improved_(false)
+  {
+    pyQCDassert ((boundary_phases.size() == num_dims_),
+                 std::invalid_argument("StaggeredOperator: boundary_phases"));
+    links_ = fold_links(links, 1, 0.5);
+  }
+
+
+  template <int N, typename T>
+  StaggeredOperator<N, T>::StaggeredOperator(
+    const GaugeField& fat_links, const GaugeField& long_links,
+    const T naik_coefficient, const T mass,
+    const std::vector<std::complex<T> >& boundary_phases)
+    : layout_(fat_links.layout()->shape()), mass_(mass),
+      num_dims_(fat_links.num_dims()), boundary_phases_(boundary_phases),
+      improved_(true)
+  {
+    pyQCDassert ((boundary_phases.size() == num_dims_),
+                 std::invalid_argument("StaggeredOperator: boundary_phases"));
+    pyQCDassert ((long_links.volume() == fat_links.volume()),
+                 std::invalid_argument("StaggeredOperator: long_links"));
+    links_ = fold_links(fat_links, 1, 0.5);
+    long_links_ = fold_links(long_links, 3, 0.5 * naik_coefficient);
+  }
+
+
+  template <int N, typename T>
+  DoubleStoredGaugeField<N, T> StaggeredOperator<N, T>::fold_links(
+    const GaugeField& links, const unsigned int hops,
+    const T coefficient) const
+  {
+    // Double-store the links in even-odd order, folding in the staggered
+    // phases, boundary phases and the supplied coefficient
+    const Layout& links_layout = *links.layout();
+    std::vector<unsigned int> coords(num_dims_);
+
+    auto compute_link = [&] (const unsigned int site, const unsigned int mu)
+    {
+      layout_.compute_site_coords(site, coords);
+      unsigned int coord_sum = 0;
+      for (unsigned int nu = 0; nu < mu; ++nu) {
+        coord_sum += coords[nu];
+      }
+      std::complex<T> phase = coord_sum % 2 == 0 ? coefficient : -coefficient;
+      if (coords[mu] + hops >= layout_.shape()[mu]) {
+        phase *= boundary_phases_[mu];
+      }
+      const unsigned int index = links_layout.get_array_index(site);
+      return ColourMatrix(phase * links[index][mu]);
+    };
+
+    return DoubleStoredGaugeField<N, T>(layout_, num_dims_, hops,
+                                        compute_link);
+  }
+
+
+  template <int N, typename T>
+  void StaggeredOperator<N, T>::apply_hopping_range(
+    const ColourField& in, ColourField& out, const unsigned int begin,
+    const unsigned int end, const unsigned int in_offset,
+    const unsigned int out_offset) const
+  {
+    PYQCD_PROFILE_SCOPE("StaggeredOperator::apply_hopping");
+    // The site loop is compiled for the best instruction set available
+    dispatch([&] () {
+      for (unsigned int index = begin; index < end; ++index) {
+        ColourVector result = ColourVector::Zero();
+        ColourVector hop;
+
+        // eta_mu(x - mu) = eta_mu(x), so the backward links, which are the
+        // adjoints of the folded forward links, carry the correct phase
+        for (unsigned int mu = 0; mu < num_dims_; ++mu) {
+          multiply(links_.forward(index, mu),
+                   in[links_.fwd_neighbour(index, mu) - in_offset], hop);
+          result += hop;
+        }
+        for (unsigned int mu = 0; mu < num_dims_; ++mu) {
+          multiply(links_.backward(index, mu),
+                   in[links_.bwd_neighbour(index, mu) - in_offset], hop);
+          result -= hop;
+        }
+
+        if (improved_) {
+          for (unsigned int mu = 0; mu < num_dims_; ++mu) {
+            multiply(long_links_.forward(index, mu),
+                     in[long_links_.fwd_neighbour(index, mu) - in_offset],
+                     hop);
+            result += hop;
+          }
+          for (unsigned int mu = 0; mu < num_dims_; ++mu) {
+            multiply(long_links_.backward(index, mu),
+                     in[long_links_.bwd_neighbour(index, mu) - in_offset],
+                     hop);
+            result -= hop;
+          }
+        }
+
+        out[index - out_offset] = result;
+      }
+    });
+  }
+
+
+  template <int N, typename T>
+  void StaggeredOperator<N, T>::apply(const ColourField& in,
+                                      ColourField& out) const
+  {
+    pyQCDassert ((in.size() == volume() and out.size() == volume()),
+                 std::out_of_range("StaggeredOperator::apply: field size"));
+    pyQCDassert ((&in != &out),
+                 std::invalid_argument("StaggeredOperator::apply: aliasing"));
+    apply_hopping_range(in, out, 0, volume(), 0, 0);
+    out = out + mass_ * in;
+  }
+
+
+  template <int N, typename T>
+  void StaggeredOperator<N, T>::apply_hopping(const ColourField& in,
+                                              ColourField& out,
+                                              const unsigned int parity) const
+  {
+    pyQCDassert ((in.size() == half_volume() and out.size() == half_volume()),
+                 std::out_of_range("StaggeredOperator::apply_hopping: "
+                                   "field size"));
+    const unsigned int out_offset = parity * half_volume();
+    const unsigned int in_offset = (1 - parity) * half_volume();
+    apply_hopping_range(in, out, out_offset, out_offset + half_volume(),
+                        in_offset, out_offset);
+  }
+
+
+  template <int N, typename T>
+  void StaggeredOperator<N, T>::apply_even_odd(const ColourField& in,
+                                               ColourField& out) const
+  {
+    ColourField odd(half_volume(), ColourVector::Zero());
+    apply_hopping(in, odd, 1);
+    apply_hopping(odd, out, 0);
+    out = mass_ * mass_ * in - out;
+  }
+
+
+  template <int N, typename T>
+  void StaggeredOperator<N, T>::prepare_even_odd_source(
+    const ColourField& source, ColourField& even_source) const
+  {
+    ColourField source_odd(half_volume(), ColourVector::Zero());
+    std::copy(source.begin() + half_volume(), source.end(),
+              source_odd.begin());
+    apply_hopping(source_odd, even_source, 0);
+    for (unsigned int i = 0; i < half_volume(); ++i) {
+      even_source[i] = mass_ * source[i] - even_source[i];
+    }
+  }
+
+
+  template <int N, typename T>
+  void StaggeredOperator<N, T>::reconstruct_solution(
+    const ColourField& source, const ColourField& even_solution,
+    ColourField& solution) const
+  {
+    // x_o = (b_o - D_oe x_e) / m
+    ColourField odd(half_volume(), ColourVector::Zero());
+    apply_hopping(even_solution, odd, 1);
+    std::copy(even_solution.begin(), even_solution.end(), solution.begin());
+    for (unsigned int i = 0; i < half_volume(); ++i) {
+      solution[half_volume() + i]
+        = (source[half_volume() + i] - odd[i]) / mass_;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,152 @@
+#ifndef WILSON_ACTION_HPP
+#define WILSON_ACTION_HPP
+
+/* This file provides the Wilson gauge action,
+ *
+ *   S = beta sum_P (1 - Re Tr U_P / N),
+ *
+ * along with the staple and plaquette kernels it is built from. Neighbour
+ * indices are tabulated once at construction, and the kernels are templates
+ * over the link field type. Any type that provides links[index][mu] can be
+ * used, e.g. Lattice<MatrixArray<N, N> > or CompressedGaugeField. The link
+ * products use the small-matrix kernels in matrix_kernels.hpp.
+ */
+
+#include <complex>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <core/detail/matrix_kernels.hpp>
+#include <core/layout.hpp>
+
+
+namespace pyQCD
+{
+  template <int N, typename T = double>
+  class WilsonGaugeAction
+  {
+  public:
+    typedef Eigen::Matrix<std::complex<T>, N, N> ColourMatrix;
+
+    WilsonGaugeAction(const T beta, const Layout& layout);
+
+    // Sum of the staples around the link U_mu(x), where x has the specified
+    // array index, such that the plaquettes containing U_mu(x) are
+    // Re Tr[U_mu(x) A]
+    template <typename Links>
+    ColourMatrix compute_staples(const Links& links, const unsigned int index,
+                                 const unsigned int mu) const;
+    // Contribution to the action of the plaquettes containing U_mu(x)
+    template <typename Links>
+    T local_action(const Links& links, const unsigned int index,
+                   const unsigned int mu) const;
+    // Average of Re Tr U_P / N over all plaquettes
+    template <typename Links>
+    T average_plaquette(const Links& links) const;
+
+    T beta() const { return beta_; }
+
+  private:
+    unsigned int fwd(const unsigned int index, const unsigned int mu) const
+    { return fwd_neighbours_[index * num_dims_ + mu]; }
+    unsigned int bwd(const unsigned int index, const unsigned int mu) const
+    { return bwd_neighbours_[index * num_dims_ + mu]; }
+
+    T beta_;
+    unsigned int num_dims_;
+    // Array indices of neighbouring sites, indexed by index * num_dims + mu
+    std::vector<unsigned int> fwd_neighbours_, bwd_neighbours_;
+  };
+
+
+  template <int N, typename T>
+  WilsonGaugeAction<N, T>::WilsonGaugeAction(const T beta,
+                                             const Layout& layout)
+    : beta_(beta), num_dims_(layout.num_dims()),
+      fwd_neighbours_(layout.volume() * layout.num_dims()),
+      bwd_neighbours_(layout.volume() * layout.num_dims())
+  {
+    for (unsigned int site = 0; site < layout.volume(); ++site) {
+      const unsigned int index = layout.get_array_index(site);
+      for (unsigned int mu = 0; mu < num_dims_; ++mu) {
+        fwd_neighbours_[index * num_dims_ + mu] = layout.get_array_index(
+          layout.compute_neighbour_index(site, mu, 1));
+        bwd_neighbours_[index * num_dims_ + mu] = layout.get_array_index(
+          layout.compute_neighbour_index(site, mu, -1));
+      }
+    }
+  }
+
+
+  template <int N, typename T>
+  template <typename Links>
+  typename WilsonGaugeAction<N, T>::ColourMatrix
+  WilsonGaugeAction<N, T>::compute_staples(const Links& links,
+                                           const unsigned int index,
+                                           const unsigned int mu) const
+  {
+    ColourMatrix ret = ColourMatrix::Zero();
+    ColourMatrix tmp1, tmp2;
+    const unsigned int x_pmu = fwd(index, mu);
+
+    for (unsigned int nu = 0; nu < num_dims_; ++nu) {
+      if (nu == mu) {
+        continue;
+      }
+      const unsigned int x_pnu = fwd(index, nu);
+      const unsigned int x_mnu = bwd(index, nu);
+      const unsigned int x_pmu_mnu = bwd(x_pmu, nu);
+      // Upper staple: U_nu(x + mu) U_mu^dag(x + nu) U_nu^dag(x)
+      multiply_adjoint(links[x_pmu][nu], links[x_pnu][mu], tmp1);
+      multiply_adjoint(tmp1, links[index][nu], tmp2);
+      ret += tmp2;
+      // Lower staple: U_nu^dag(x + mu - nu) U_mu^dag(x - nu) U_nu(x - nu)
+      //   = [U_mu(x - nu) U_nu(x + mu - nu)]^dag U_nu(x - nu)
+      multiply(links[x_mnu][mu], links[x_pmu_mnu][nu], tmp1);
+      adjoint(tmp1, tmp2);
+      multiply(tmp2, links[x_mnu][nu], tmp1);
+      ret += tmp1;
+    }
+    return ret;
+  }
+
+
+  template <int N, typename T>
+  template <typename Links>
+  T WilsonGaugeAction<N, T>::local_action(const Links& links,
+                                          const unsigned int index,
+                                          const unsigned int mu) const
+  {
+    const ColourMatrix staples = compute_staples(links, index, mu);
+    const T num_plaquettes = 2.0 * (num_dims_ - 1);
+    // Re Tr[U A] without forming the product
+    const T trace
+      = links[index][mu].cwiseProduct(staples.transpose()).sum().real();
+    return beta_ * (num_plaquettes - trace / N);
+  }
+
+
+  template <int N, typename T>
+  template <typename Links>
+  T WilsonGaugeAction<N, T>::average_plaquette(const Links& links) const
+  {
+    T total = 0.0;
+    ColourMatrix upper, lower;
+    for (unsigned int index = 0; index < links.size(); ++index) {
+      for (unsigned int mu = 0; mu < num_dims_; ++mu) {
+        const unsigned int x_pmu = fwd(index, mu);
+        for (unsigned int nu = mu + 1; nu < num_dims_; ++nu) {
+          multiply(links[index][mu], links[x_pmu][nu], upper);
+          multiply(links[index][nu], links[fwd(index, nu)][mu], lower);
+          // Re Tr[upper lower^dag] without forming the product
+          total += upper.cwiseProduct(lower.conjugate()).sum().real();
+        }
+      }
+    }
+    const T num_plaquettes = links.size() * num_dims_ * (num_dims_ - 1) / 2;
+    return total / num_plaquettes / N;
+  }
+}
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef LAPLACIAN_HPP
+#define LAPLACIAN_HPP
+
+/* This file provides the gauge covariant Laplacian restricted to the spatial
+ * dimensions of the lattice, i.e. acting on a single timeslice. This is the
+ * operator whose low modes are used as the smearing basis in distillation.
+ *
+ * The time direction is taken to be dimension 0 of the Layout, so that the
+ * sites on a given timeslice have contiguous lexicographic site indices.
+ */
+
+#include <complex>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <core/lattice.hpp>
+#include <core/matrix_array.hpp>
+#include <utils/macros.hpp>
+#include <utils/parallel.hpp>
+
+
+namespace pyQCD
+{
+  template <int N, typename T = double>
+  class Laplacian
+  {
+  public:
+    typedef Lattice<MatrixArray<N, N, T> > GaugeField;
+    typedef Eigen::Matrix<std::complex<T>, N, 1> ColourVector;
+    typedef Eigen::Matrix<std::complex<T>, Eigen::Dynamic, Eigen::Dynamic>
+      DenseMatrix;
+    // A block of colour vector fields on a timeslice, one per column. The
+    // storage is row-major so that the colour vectors at each site are
+    // contiguous.
+    typedef Eigen::Matrix<std::complex<T>, Eigen::Dynamic, Eigen::Dynamic,
+                          Eigen::RowMajor> VectorBlock;
+
+    Laplacian(const GaugeField& links);
+
+    // Apply the 3D Laplacian to a set of colour vectors living on timeslice t.
+    // The vectors are indexed by the spatial lexicographic index.
+    void apply(const unsigned int t, const std::vector<ColourVector>& in,
+               std::vector<ColourVector>& out) const;
+    // Apply the 3D Laplacian on timeslice t to each column of in. Each column
+    // holds the colour vectors of the timeslice stacked in order of spatial
+    // lexicographic index, i.e. has N * timeslice_volume rows.
+    void apply(const unsigned int t, const VectorBlock& in,
+               VectorBlock& out) const;
+    // Construct the dense (N * timeslice_volume) square matrix representing
+    // the Laplacian on timeslice t.
+    DenseMatrix timeslice_matrix(const unsigned int t) const;
+
+    unsigned int timeslice_volume() const { return timeslice_volume_; }
+    unsigned int num_timeslices() const { return num_timeslices_; }
+
+  private:
+    const GaugeField& links_;
+    unsigned int num_timeslices_, timeslice_volume_;
+  };
+
+
+  template <int N, typename T>
+  Laplacian<N, T>::Laplacian(const GaugeField& links)
+    : links_(links)
+  {
+    pyQCDassert ((links.num_dims() > 1),
+                 std::invalid_argument("Laplacian: lattice must have at least "
+                                       "one spatial dimension"));
+    num_timeslices_ = links.layout()->shape()[0];
+    timeslice_volume_ = links.volume() / num_timeslices_;
+  }
+
+
+  template <int N, typename T>
+  void Laplacian<N, T>::apply(const unsigned int t,
+                              const std::vector<ColourVector>& in,
+                              std::vector<ColourVector>& out) const
+  {
+    // Computes out(x) = sum_i [U_i(x) in(x + i) + U_i^dag(x - i) in(x - i)
+    //                          - 2 in(x)]
+    pyQCDassert ((in.size() == timeslice_volume_),
+                 std::out_of_range("Laplacian::apply: in.size()"));
+    const Layout& layout = *links_.layout();
+    const unsigned int offset = t * timeslice_volume_;
+    out.resize(timeslice_volume_);
+
+    for (unsigned int s = 0; s < timeslice_volume_; ++s) {
+      const unsigned int site = offset + s;
+      out[s] = -2.0 * static_cast<T>(layout.num_dims() - 1) * in[s];
+
+      for (unsigned int dim = 1; dim < layout.num_dims(); ++dim) {
+        const unsigned int fwd
+          = layout.compute_neighbour_index(site, dim, 1);
+        const unsigned int bwd
+          = layout.compute_neighbour_index(site, dim, -1);
+        out[s] += links_[layout.get_array_index(site)][dim]
+          * in[fwd - offset];
+        out[s] += links_[layout.get_array_index(bwd)][dim].adjoint()
+          * in[bwd - offset];
+      }
+    }
+  }
+
+
+  template <int N, typename T>
+  void Laplacian<N, T>::apply(const unsigned int t, const VectorBlock& in,
+                              VectorBlock& out) const
+  {
+    // As above, but each link is applied to all the columns at once, so the
+    // cost of the neighbour lookups is shared between them.
+    pyQCDassert ((in.rows() == N * timeslice_volume_),
+                 std::out_of_range("Laplacian::apply: in.rows()"));
+    pyQCDassert ((&in != &out),
+                 std::invalid_argument("Laplacian::apply: in and out alias"));
+    const Layout& layout = *links_.layout();
+    const unsigned int offset = t * timeslice_volume_;
+    const T diag = -2.0 * static_cast<T>(layout.num_dims() - 1);
+    out.resize(in.rows(), in.cols());
+
+    parallel_for(0, timeslice_volume_, [&] (const unsigned long s) {
+      const unsigned int site = offset + s;
+      auto out_rows = out.template middleRows<N>(N * s);
+      out_rows = diag * in.template middleRows<N>(N * s);
+
+      for (unsigned int dim = 1; dim < layout.num_dims(); ++dim) {
+        const unsigned int fwd
+          = layout.compute_neighbour_index(site, dim, 1) - offset;
+        const unsigned int bwd
+          = layout.compute_neighbour_index(site, dim, -1);
+        out_rows.noalias() += links_[layout.get_array_index(site)][dim]
+          * in.template middleRows<N>(N * fwd);
+        out_rows.noalias() += links_[layout.get_array_index(bwd)][dim].adjoint()
+          * in.template middleRows<N>(N * (bwd - offset));
+      }
+    });
+  }
+
+
+  template <int N, typename T>
+  typename Laplacian<N, T>::DenseMatrix
+  Laplacian<N, T>::timeslice_matrix(const unsigned int t) const
+  {
+    const Layout& layout = *links_.layout();
+    const unsigned int offset = t * timeslice_volume_;
+    const T diag = -2.0 * static_cast<T>(layout.num_dims() - 1);
+
+    DenseMatrix ret = DenseMatrix::Zero(N * timeslice_volume_,
+                                        N * timeslice_volume_);
+
+    for (unsigned int s = 0; s < timeslice_volume_; ++s) {
+      const unsigned int site = offset + s;
+      ret.template block<N, N>(N * s, N * s).diagonal().array() += diag;
+
+      for (unsigned int dim = 1; dim < layout.num_dims(); ++dim) {
+        const unsigned int fwd
+          = layout.compute_neighbour_index(site, dim, 1) - offset;
+        const unsigned int bwd
+          = layout.compute_neighbour_index(site, dim, -1);
+        ret.template block<N, N>(N * s, N * fwd)
+          += links_[layout.get_array_index(site)][dim];
+        ret.template block<N, N>(N * s, N * (bwd - offset))
+          += links_[layout.get_array_index(bwd)][dim].adjoint();
+      }
+    }
+
+    return ret;
+  }
+}
+
+#endif
@@ -1,5 +1,9 @@
+from libcpp.vector cimport vector
+
 from operators cimport *
 cimport complex
+cimport profiling
+cimport thread_pool
 {% for matrix in matrixdefs %}
 cimport {{ matrix.matrix_name|to_underscores }}
 cimport {{ matrix.array_name|to_underscores }}
@@ -7,6 +11,56 @@ cimport {{ matrix.lattice_matrix_name|to_underscores }}
 cimport {{ matrix.lattice_array_name|to_underscores }}
 {% endfor %}
 
+def num_threads():
+    """Return the number of threads used by parallel lattice operations"""
+    return thread_pool.num_threads()
+
+
+def set_num_threads(unsigned int num_threads, bint pin=False):
+    """Set the number of threads used by parallel lattice operations
+
+    If pin is True, each worker thread is pinned to its own core.
+    """
+    thread_pool.set_num_threads(num_threads, pin)
+
+
+def profiling_enabled():
+    """Return whether the kernels were compiled with instrumentation
+
+    Instrumentation is enabled by building with PYQCD_ENABLE_PROFILING set.
+    """
+    return profiling.profiling_enabled()
+
+
+def profile_stats():
+    """Return the totals of each instrumented kernel, most expensive first
+
+    Each kernel is described by a dict holding its name and its number of
+    calls, total time in seconds, flops and bytes moved. Times are inclusive
+    of any kernels called from within a kernel.
+    """
+    cdef vector[profiling.KernelStats] stats = profiling.profile_stats()
+    cdef unsigned int i
+    ret = []
+    for i in range(stats.size()):
+        ret.append({"name": stats[i].name.decode(),
+                    "calls": stats[i].calls,
+                    "seconds": stats[i].seconds,
+                    "flops": stats[i].flops,
+                    "bytes": stats[i].bytes})
+    return ret
+
+
+def profile_report():
+    """Return a table of the totals of each instrumented kernel"""
+    return profiling.profile_report().decode()
+
+
+def reset_profile():
+    """Reset the totals of all instrumented kernels to zero"""
+    profiling.reset_profile()
+
+
 cdef class Complex:
     cdef complex.Complex instance
 
@@ -0,0 +1,171 @@
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+
+/* This file is generated by utils/codegen.py. It contains small-matrix
+ * kernels for each of the configured matrix shapes, working directly on the
+ * real and imaginary parts of the matrix elements. See
+ * core/detail/matrix_kernels.hpp for the generic implementations and the
+ * traits used to dispatch to these kernels.
+ *
+ * Output arguments must not alias the inputs.
+ */
+
+#include <cmath>
+#include <complex>
+
+#include <Eigen/Dense>
+
+#include <core/detail/matrix_kernels.hpp>
+
+
+namespace pyQCD
+{
+{% set real = precision %}
+{% set complex = "std::complex<" + precision + ">" %}
+{% for lhs in matrixdefs %}
+{% set R = lhs.num_rows %}
+{% set C = lhs.num_cols %}
+  template <>
+  struct MatrixKernel<{{ complex }}, {{ R }}, {{ C }}>
+    : GenericMatrixKernel<{{ complex }}, {{ R }}, {{ C }}>
+  {
+    typedef GenericMatrixKernel<{{ complex }}, {{ R }}, {{ C }}> Base;
+    using Base::multiply;
+    using Base::multiply_adjoint;
+    static constexpr bool specialised = true;
+    typedef Eigen::Matrix<{{ complex }}, {{ R }}, {{ C }}> MatrixType;
+{% for rhs in matrixdefs if rhs.num_rows == C %}
+{% set K = rhs.num_cols %}
+
+    static void multiply(const MatrixType& lhs,
+                         const Eigen::Matrix<{{ complex }}, {{ C }}, {{ K }}>& rhs,
+                         Eigen::Matrix<{{ complex }}, {{ R }}, {{ K }}>& out)
+    {
+      const {{ real }}* a = reinterpret_cast<const {{ real }}*>(lhs.data());
+      const {{ real }}* b = reinterpret_cast<const {{ real }}*>(rhs.data());
+      {{ real }}* o = reinterpret_cast<{{ real }}*>(out.data());
+      // Each column of out is accumulated from the columns of lhs, so the
+      // inner loop runs down contiguous columns and can be vectorised
+      for (int j = 0; j < {{ K }}; ++j) {
+        {{ real }} re[{{ R }}] = { }, im[{{ R }}] = { };
+        for (int k = 0; k < {{ C }}; ++k) {
+          const {{ real }} b_re = b[2 * (k + {{ C }} * j)];
+          const {{ real }} b_im = b[2 * (k + {{ C }} * j) + 1];
+          for (int i = 0; i < {{ R }}; ++i) {
+            const {{ real }} a_re = a[2 * (i + {{ R }} * k)];
+            const {{ real }} a_im = a[2 * (i + {{ R }} * k) + 1];
+            re[i] += a_re * b_re - a_im * b_im;
+            im[i] += a_im * b_re + a_re * b_im;
+          }
+        }
+        for (int i = 0; i < {{ R }}; ++i) {
+          o[2 * (i + {{ R }} * j)] = re[i];
+          o[2 * (i + {{ R }} * j) + 1] = im[i];
+        }
+      }
+    }
+{% endfor %}
+{% for rhs in matrixdefs if rhs.num_cols == C %}
+{% set K = rhs.num_rows %}
+
+    static void multiply_adjoint(
+      const MatrixType& lhs,
+      const Eigen::Matrix<{{ complex }}, {{ K }}, {{ C }}>& rhs,
+      Eigen::Matrix<{{ complex }}, {{ R }}, {{ K }}>& out)
+    {
+      const {{ real }}* a = reinterpret_cast<const {{ real }}*>(lhs.data());
+      const {{ real }}* b = reinterpret_cast<const {{ real }}*>(rhs.data());
+      {{ real }}* o = reinterpret_cast<{{ real }}*>(out.data());
+      // As multiply, with the elements of rhs^dag read from row j of rhs
+      for (int j = 0; j < {{ K }}; ++j) {
+        {{ real }} re[{{ R }}] = { }, im[{{ R }}] = { };
+        for (int k = 0; k < {{ C }}; ++k) {
+          const {{ real }} b_re = b[2 * (j + {{ K }} * k)];
+          const {{ real }} b_im = -b[2 * (j + {{ K }} * k) + 1];
+          for (int i = 0; i < {{ R }}; ++i) {
+            const {{ real }} a_re = a[2 * (i + {{ R }} * k)];
+            const {{ real }} a_im = a[2 * (i + {{ R }} * k) + 1];
+            re[i] += a_re * b_re - a_im * b_im;
+            im[i] += a_im * b_re + a_re * b_im;
+          }
+        }
+        for (int i = 0; i < {{ R }}; ++i) {
+          o[2 * (i + {{ R }} * j)] = re[i];
+          o[2 * (i + {{ R }} * j) + 1] = im[i];
+        }
+      }
+    }
+{% endfor %}
+
+    static void adjoint(const MatrixType& mat,
+                        Eigen::Matrix<{{ complex }}, {{ C }}, {{ R }}>& out)
+    {
+      const {{ real }}* a = reinterpret_cast<const {{ real }}*>(mat.data());
+      {{ real }}* o = reinterpret_cast<{{ real }}*>(out.data());
+{% for j in range(C) %}
+{% for i in range(R) %}
+      o[{{ 2 * (j + i * C) }}] = a[{{ 2 * (i + j * R) }}];
+      o[{{ 2 * (j + i * C) + 1 }}] = -a[{{ 2 * (i + j * R) + 1 }}];
+{% endfor %}
+{% endfor %}
+    }
+{% if R == C %}
+
+    static {{ complex }} trace(const MatrixType& mat)
+    {
+      const {{ real }}* a = reinterpret_cast<const {{ real }}*>(mat.data());
+      return {{ complex }}({% for i in range(R) %}{{ " + " if not loop.first }}a[{{ 2 * (i + i * R) }}]{% endfor %},
+        {% for i in range(R) %}{{ " + " if not loop.first }}a[{{ 2 * (i + i * R) + 1 }}]{% endfor %});
+    }
+{% if R == 3 %}
+
+    static void reunitarize(MatrixType& mat)
+    {
+      // Normalise the first row, orthogonalise and normalise the second, then
+      // compute the third from unitarity
+      const {{ real }} norm0 = 1.0 / std::sqrt(std::norm(mat(0, 0))
+        + std::norm(mat(0, 1)) + std::norm(mat(0, 2)));
+      mat(0, 0) *= norm0;
+      mat(0, 1) *= norm0;
+      mat(0, 2) *= norm0;
+      const {{ complex }} proj = std::conj(mat(0, 0)) * mat(1, 0)
+        + std::conj(mat(0, 1)) * mat(1, 1) + std::conj(mat(0, 2)) * mat(1, 2);
+      mat(1, 0) -= proj * mat(0, 0);
+      mat(1, 1) -= proj * mat(0, 1);
+      mat(1, 2) -= proj * mat(0, 2);
+      const {{ real }} norm1 = 1.0 / std::sqrt(std::norm(mat(1, 0))
+        + std::norm(mat(1, 1)) + std::norm(mat(1, 2)));
+      mat(1, 0) *= norm1;
+      mat(1, 1) *= norm1;
+      mat(1, 2) *= norm1;
+      mat(2, 0) = std::conj(mat(0, 1) * mat(1, 2) - mat(0, 2) * mat(1, 1));
+      mat(2, 1) = std::conj(mat(0, 2) * mat(1, 0) - mat(0, 0) * mat(1, 2));
+      mat(2, 2) = std::conj(mat(0, 0) * mat(1, 1) - mat(0, 1) * mat(1, 0));
+    }
+{% endif %}
+{% endif %}
+  };
+
+{# Eigen's own product is as fast as the kernel for an inner dimension of
+   three or less (see benchmarks/bench_matrix_kernels.cpp), so the kernel is
+   only used by the operators for larger matrices #}
+{% for rhs in matrixdefs if rhs.num_rows == C and C > 3 %}
+  template <>
+  struct MultiplyKernelEnabled<{{ complex }}, {{ R }}, {{ C }}, {{ rhs.num_cols }}>
+    : std::true_type { };
+
+{% endfor %}
+{% for rhs in matrixdefs if rhs.num_cols == C %}
+  template <>
+  struct MultiplyAdjointKernelEnabled<{{ complex }}, {{ R }}, {{ C }}, {{ rhs.num_rows }}>
+    : std::true_type { };
+
+{% endfor %}
+  template <>
+  struct AdjointKernelEnabled<{{ complex }}, {{ R }}, {{ C }}>
+    : std::true_type { };
+
+{% endfor %}
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include "array.hpp"
 #include "matrix_array.hpp"
 #include "lattice.hpp"
+#include "kernels.hpp"
 
 
 typedef {{ precision }} Real;
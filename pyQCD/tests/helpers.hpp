@@ -2,6 +2,9 @@
 #define HELPERS_HPP
 
 #include <cmath>
+#include <random>
+
+#include <Eigen/Dense>
 
 #include "catch.hpp"
 
@@ -75,4 +78,18 @@ struct TestRandom
   std::uniform_int_distribution<> int_dist;
 };
 
+
+template <int N>
+Eigen::Matrix<std::complex<double>, N, N> random_sun()
+{
+  // Generate a random SU(N) matrix using the QR decomposition of a random
+  // complex matrix, then fix the determinant to one.
+  typedef Eigen::Matrix<std::complex<double>, N, N> MatrixType;
+  Eigen::HouseholderQR<MatrixType> qr(MatrixType::Random());
+  MatrixType ret = qr.householderQ();
+  std::complex<double> det = ret.determinant();
+  ret /= std::pow(det, 1.0 / N);
+  return ret;
+}
+
 #endif
\ No newline at end of file
@@ -17,6 +17,12 @@ TEST_CASE("Array test") {
     for (int i = 0; i < 100; ++i) {
       REQUIRE (array1[i] == 1.0);
     }
+    Arr array3(100, pyQCD::Uninitialized());
+    REQUIRE (array3.size() == 100);
+    array3 = array1 + array2;
+    REQUIRE (array3[50] == 3.0);
+    array3.resize(200);
+    REQUIRE (array3[150] == 0.0);
   }
 
   SECTION ("Testing array iterators") {
@@ -107,6 +113,28 @@ TEST_CASE("Array test") {
       REQUIRE (array1[i] == 2.0);
     }
   }
+
+  SECTION ("Testing buffer reuse for expiring operands") {
+    const double* ptr = &array1[0];
+    Arr array3 = std::move(array1) + 2.0 * array2;
+    REQUIRE (&array3[0] == ptr);
+    REQUIRE (array1.size() == 0);
+    for (int i = 0; i < 100; ++i) {
+      REQUIRE (array3[i] == 5.0);
+    }
+
+    ptr = &array2[0];
+    Arr array4 = array3 * std::move(array2) - 1.0;
+    REQUIRE (&array4[0] == ptr);
+    REQUIRE (array4[99] == 9.0);
+
+    // Buffers of a different type can't be reused
+    pyQCD::Array<int> array5(100, 2);
+    Arr array6 = std::move(array5) * array4;
+    REQUIRE (array5.size() == 100);
+    REQUIRE (array6[0] == 18.0);
+  }
+
 }
 
 TEST_CASE("Non-integral Array types test") {
@@ -118,4 +146,26 @@ TEST_CASE("Non-integral Array types test") {
   array2 *= 3.0;
 
   pyQCD::Array<Eigen::Matrix3cd> array3 = Eigen::Matrix3cd::Ones() * array1;
+
+  SECTION ("Testing matrix products") {
+    typedef pyQCD::Array<Eigen::Matrix3cd, Eigen::aligned_allocator> MatArr;
+    MatArr lhs(4, Eigen::Matrix3cd::Zero()), rhs(4, Eigen::Matrix3cd::Zero());
+    for (int i = 0; i < 4; ++i) {
+      lhs[i] = Eigen::Matrix3cd::Random();
+      rhs[i] = Eigen::Matrix3cd::Random();
+    }
+    const MatArr lhs_copy = lhs;
+
+    MatArr result(4, Eigen::Matrix3cd::Zero());
+    result = lhs * rhs;
+    for (int i = 0; i < 4; ++i) {
+      REQUIRE (result[i].isApprox(lhs_copy[i] * rhs[i]));
+    }
+
+    // The destination is also an operand
+    lhs = lhs * rhs;
+    for (int i = 0; i < 4; ++i) {
+      REQUIRE (lhs[i].isApprox(lhs_copy[i] * rhs[i]));
+    }
+  }
 }
@@ -0,0 +1,138 @@
+#define CATCH_CONFIG_MAIN
+
+#include <thread>
+
+#include <fermion_actions/clover.hpp>
+
+#include "helpers.hpp"
+
+
+typedef pyQCD::MatrixArray<3, 3> GaugeLinks;
+typedef pyQCD::MatrixArray<3, 1> Spinor;
+typedef pyQCD::Lattice<GaugeLinks> GaugeField;
+typedef pyQCD::Lattice<Spinor> FermionField;
+typedef Eigen::Matrix<std::complex<double>, 12, 12> SpinColourMatrix;
+
+TEST_CASE("CloverTerm test") {
+  pyQCD::LexicoLayout layout(std::vector<unsigned int>{4, 4, 4, 4});
+  MatrixCompare<Eigen::Matrix3cd> colour_compare(1.0e-8, 1.0e-8);
+  MatrixCompare<Eigen::Matrix<std::complex<double>, 6, 6> >
+    block_compare(1.0e-8, 1.0e-8);
+
+  GaugeField links(layout, GaugeLinks(4, Eigen::Matrix3cd::Identity()));
+
+  SECTION("Test free field") {
+    pyQCD::CloverTerm<3> clover(links, 1.0);
+    for (unsigned int i = 0; i < links.volume(); ++i) {
+      REQUIRE(colour_compare(clover.field_strength(i, 0, 1),
+                             Eigen::Matrix3cd::Zero()));
+      REQUIRE(block_compare(clover.block(i, 1),
+                            Eigen::Matrix<std::complex<double>, 6, 6>::Zero()));
+    }
+  }
+
+  for (auto& site_links : links) {
+    for (auto& link : site_links) {
+      link = random_sun<3>();
+    }
+  }
+  links.touch();
+
+  SECTION("Test field strength and blocks") {
+    pyQCD::CloverTerm<3> clover(links, 1.5);
+    const Eigen::Matrix3cd f01 = clover.field_strength(7, 0, 1);
+    REQUIRE(colour_compare(f01, f01.adjoint()));
+    REQUIRE(std::abs(f01.trace()) < 1.0e-10);
+    REQUIRE(colour_compare(f01, -clover.field_strength(7, 1, 0)));
+
+    // Compare with the full spin-colour matrix, which should have no
+    // off-diagonal chiral blocks
+    SpinColourMatrix full = SpinColourMatrix::Zero();
+    for (unsigned int mu = 0; mu < 4; ++mu) {
+      for (unsigned int nu = mu + 1; nu < 4; ++nu) {
+        const pyQCD::SpinMatrix sigma = pyQCD::sigma(mu, nu);
+        const Eigen::Matrix3cd f = clover.field_strength(7, mu, nu);
+        for (unsigned int a = 0; a < 4; ++a) {
+          for (unsigned int b = 0; b < 4; ++b) {
+            full.block<3, 3>(3 * a, 3 * b) -= 0.75 * sigma(a, b) * f;
+          }
+        }
+      }
+    }
+    REQUIRE((full.block<6, 6>(0, 6).norm() < 1.0e-10));
+    REQUIRE(block_compare(clover.block(7, 0), full.block<6, 6>(0, 0)));
+    REQUIRE(block_compare(clover.block(7, 1), full.block<6, 6>(6, 6)));
+
+    FermionField psi(layout, Spinor(4, Eigen::Vector3cd::Zero()));
+    for (auto& spinor : psi) {
+      for (auto& colour_vector : spinor) {
+        colour_vector = Eigen::Vector3cd::Random();
+      }
+    }
+    FermionField eta(psi);
+    clover.apply(psi, eta);
+
+    Eigen::Matrix<std::complex<double>, 12, 1> in, expected;
+    for (unsigned int a = 0; a < 4; ++a) {
+      in.segment<3>(3 * a) = psi[7][a];
+    }
+    expected = full * in;
+    MatrixCompare<Eigen::Vector3cd> vector_compare(1.0e-8, 1.0e-8);
+    for (unsigned int a = 0; a < 4; ++a) {
+      REQUIRE(vector_compare(eta[7][a], expected.segment<3>(3 * a)));
+    }
+  }
+
+  SECTION("Test caching") {
+    pyQCD::CloverTerm<3> clover(links, 1.0);
+    REQUIRE(clover.version() == links.version());
+    REQUIRE(not clover.update());
+
+    const Eigen::Matrix<std::complex<double>, 6, 6> before = clover.block(0, 0);
+    links[0][1] = random_sun<3>();
+    // Site writes aren't tracked until the lattice is touched
+    REQUIRE(not clover.update());
+    links.touch();
+    REQUIRE(clover.version() != links.version());
+    REQUIRE(not block_compare(clover.block(0, 0), before));
+    REQUIRE(clover.version() == links.version());
+    REQUIRE(not clover.update());
+
+    links *= 1.0;
+    REQUIRE(clover.update());
+  }
+
+  SECTION("Test concurrent use") {
+    pyQCD::CloverTerm<3> clover(links, 1.0);
+    MatrixCompare<Eigen::Vector3cd> vector_compare(1.0e-8, 1.0e-8);
+    FermionField psi(layout, Spinor(4, Eigen::Vector3cd::Zero()));
+    for (auto& site : psi) {
+      for (auto& spin : site) {
+        spin = Eigen::Vector3cd::Random();
+      }
+    }
+    links[0][2] = random_sun<3>();
+    links.touch();
+
+    // Every thread may find the cache stale on entry
+    std::vector<FermionField> results(4, psi);
+    std::vector<std::thread> threads;
+    for (auto& result : results) {
+      threads.emplace_back([&] () { clover.apply(psi, result); });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    REQUIRE(not clover.update());
+
+    FermionField expected(psi);
+    clover.apply(psi, expected);
+    for (auto& result : results) {
+      for (unsigned int i = 0; i < psi.volume(); ++i) {
+        for (unsigned int a = 0; a < 4; ++a) {
+          REQUIRE(vector_compare(result[i][a], expected[i][a]));
+        }
+      }
+    }
+  }
+}
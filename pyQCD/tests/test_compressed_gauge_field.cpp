@@ -0,0 +1,53 @@
+#define CATCH_CONFIG_MAIN
+
+#include <core/compressed_gauge_field.hpp>
+#include <gauge_actions/wilson_action.hpp>
+
+#include "helpers.hpp"
+
+
+typedef pyQCD::MatrixArray<3, 3> GaugeLinks;
+typedef pyQCD::Lattice<GaugeLinks> GaugeField;
+
+TEST_CASE("CompressedGaugeField test") {
+  pyQCD::LexicoLayout layout(std::vector<unsigned int>{8, 4, 4, 4});
+  MatrixCompare<Eigen::Matrix3cd> compare(1.0e-8, 1.0e-8);
+
+  GaugeField links(layout, GaugeLinks(4, Eigen::Matrix3cd::Identity()));
+  for (auto& site_links : links) {
+    for (auto& link : site_links) {
+      link = random_sun<3>();
+    }
+  }
+  pyQCD::CompressedGaugeField<> compressed(links);
+
+  SECTION("Test reconstruction") {
+    REQUIRE(compressed.size() == links.size());
+    REQUIRE(compressed.num_dims() == 4);
+    REQUIRE(compressed.layout() == &layout);
+    for (unsigned int i = 0; i < links.size(); ++i) {
+      for (unsigned int mu = 0; mu < 4; ++mu) {
+        REQUIRE(compare(compressed[i][mu], links[i][mu]));
+      }
+    }
+    GaugeField decompressed = compressed.decompress();
+    REQUIRE(decompressed.layout() == &layout);
+    REQUIRE(compare(decompressed[100][2], links[100][2]));
+  }
+
+  SECTION("Test kernels") {
+    pyQCD::WilsonGaugeAction<3> action(5.5, layout);
+    for (unsigned int i : {0u, 17u, 511u}) {
+      for (unsigned int mu = 0; mu < 4; ++mu) {
+        REQUIRE(compare(action.compute_staples(compressed, i, mu),
+                        action.compute_staples(links, i, mu)));
+      }
+    }
+    REQUIRE(std::abs(action.average_plaquette(compressed)
+                     - action.average_plaquette(links)) < 1.0e-10);
+
+    GaugeField unit_links(layout, GaugeLinks(4, Eigen::Matrix3cd::Identity()));
+    REQUIRE(std::abs(action.average_plaquette(unit_links) - 1.0) < 1.0e-10);
+    REQUIRE(std::abs(action.local_action(unit_links, 3, 1)) < 1.0e-10);
+  }
+}
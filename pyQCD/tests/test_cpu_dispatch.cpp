@@ -0,0 +1,164 @@
+#define CATCH_CONFIG_MAIN
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include <core/array.hpp>
+#include <core/matrix_array.hpp>
+#include <utils/cpu_dispatch.hpp>
+#include <utils/simd_kernels.hpp>
+
+#include "helpers.hpp"
+
+
+TEST_CASE("CPU dispatch test") {
+  typedef pyQCD::SimdLevel SimdLevel;
+
+  SECTION("Testing simd_level") {
+    const SimdLevel detected = pyQCD::detected_simd_level();
+    REQUIRE(static_cast<int>(pyQCD::simd_level())
+            <= static_cast<int>(detected));
+    REQUIRE(pyQCD::detected_simd_level() == detected);
+    REQUIRE(std::string(pyQCD::simd_level_name(SimdLevel::generic))
+            == "generic");
+    REQUIRE(std::string(pyQCD::simd_level_name(SimdLevel::avx2)) == "avx2");
+    REQUIRE(std::string(pyQCD::simd_level_name(SimdLevel::avx512))
+            == "avx512");
+  }
+
+  SECTION("Testing dispatch") {
+    int count = 0;
+    pyQCD::dispatch([&] () { ++count; });
+    REQUIRE(count == 1);
+    for (auto level : {SimdLevel::generic, SimdLevel::avx2,
+                       SimdLevel::avx512}) {
+      pyQCD::dispatch(level, [&] () { ++count; });
+    }
+    REQUIRE(count == 4);
+  }
+
+  SECTION("Testing variants give the same results") {
+    typedef pyQCD::Array<Eigen::Matrix3cd, Eigen::aligned_allocator> Array;
+    Array a(100, Eigen::Matrix3cd::Zero()), b(a), c(a);
+    for (unsigned int i = 0; i < 100; ++i) {
+      a[i] = Eigen::Matrix3cd::Random();
+      b[i] = Eigen::Matrix3cd::Random();
+      c[i] = Eigen::Matrix3cd::Random();
+    }
+    const auto expr = a * b + 2.0 * c;
+
+    Array expected(a);
+    pyQCD::dispatch(SimdLevel::generic, [&] () {
+      pyQCD::assign_elements(&expected[0], expr, 0, 100);
+    });
+    for (auto level : {SimdLevel::avx2, SimdLevel::avx512}) {
+      Array result(a);
+      pyQCD::dispatch(level, [&] () {
+        pyQCD::assign_elements(&result[0], expr, 0, 100);
+      });
+      for (unsigned int i = 0; i < 100; ++i) {
+        REQUIRE(result[i].isApprox(expected[i], 1e-12));
+      }
+    }
+
+    Array result(a);
+    result = expr;
+    for (unsigned int i = 0; i < 100; ++i) {
+      REQUIRE(result[i].isApprox(expected[i], 1e-12));
+    }
+  }
+
+  SECTION("Testing batched kernels") {
+    const SimdLevel detected = pyQCD::detected_simd_level();
+    REQUIRE(pyQCD::simd::generic::compiled_simd_level() == 0);
+    REQUIRE(pyQCD::simd_kernels(SimdLevel::generic).level
+            == SimdLevel::generic);
+#ifdef PYQCD_SIMD_KERNEL_VARIANTS
+    // Each variant is really built for its instruction set, and is used
+    // instead of the generic one where the CPU supports it
+    REQUIRE(pyQCD::simd::avx2::compiled_simd_level() == 1);
+    REQUIRE(pyQCD::simd::avx512::compiled_simd_level() == 2);
+    const pyQCD::simd::Kernels& generic
+      = pyQCD::simd_kernels(SimdLevel::generic);
+    for (auto level : {SimdLevel::avx2, SimdLevel::avx512}) {
+      const pyQCD::simd::Kernels& kernels = pyQCD::simd_kernels(level);
+      REQUIRE(kernels.level == pyQCD::detail::min_simd_level(level, detected));
+      if (kernels.level != SimdLevel::generic) {
+        REQUIRE(kernels.multiply_3x3 != generic.multiply_3x3);
+        REQUIRE(kernels.multiply_adjoint_3x3 != generic.multiply_adjoint_3x3);
+        REQUIRE(kernels.multiply_3x3_3x1 != generic.multiply_3x3_3x1);
+      }
+    }
+#endif
+
+    const unsigned int n = 10;
+    std::vector<Eigen::Matrix3cd> a(n), b(n);
+    std::vector<Eigen::Vector3cd> x(n);
+    for (unsigned int i = 0; i < n; ++i) {
+      a[i] = Eigen::Matrix3cd::Random();
+      b[i] = Eigen::Matrix3cd::Random();
+      x[i] = Eigen::Vector3cd::Random();
+    }
+    auto data = [] (const void* ptr)
+    { return reinterpret_cast<const double*>(ptr); };
+
+    for (auto level : {SimdLevel::generic, SimdLevel::avx2,
+                       SimdLevel::avx512}) {
+      const pyQCD::simd::Kernels& kernels = pyQCD::simd_kernels(level);
+      std::vector<Eigen::Matrix3cd> c(n);
+      std::vector<Eigen::Vector3cd> y(n);
+      kernels.multiply_3x3(data(&a[0]), data(&b[0]),
+                           reinterpret_cast<double*>(&c[0]), n);
+      for (unsigned int i = 0; i < n; ++i) {
+        REQUIRE(c[i].isApprox(a[i] * b[i], 1e-12));
+      }
+      kernels.multiply_adjoint_3x3(data(&a[0]), data(&b[0]),
+                                   reinterpret_cast<double*>(&c[0]), n);
+      for (unsigned int i = 0; i < n; ++i) {
+        REQUIRE(c[i].isApprox(a[i] * b[i].adjoint(), 1e-12));
+      }
+      kernels.multiply_3x3_3x1(data(&a[0]), data(&x[0]),
+                               reinterpret_cast<double*>(&y[0]), n);
+      for (unsigned int i = 0; i < n; ++i) {
+        REQUIRE(y[i].isApprox(a[i] * x[i], 1e-12));
+      }
+      // The output may be one of the operands
+      c = a;
+      kernels.multiply_3x3(data(&c[0]), data(&b[0]),
+                           reinterpret_cast<double*>(&c[0]), n);
+      for (unsigned int i = 0; i < n; ++i) {
+        REQUIRE(c[i].isApprox(a[i] * b[i], 1e-12));
+      }
+    }
+  }
+
+  SECTION("Testing array products") {
+    pyQCD::MatrixArray<3, 3> a(100, Eigen::Matrix3cd::Zero()), b(a), c(a);
+    pyQCD::MatrixArray<3, 1> x(100, Eigen::Vector3cd::Zero()), y(x);
+    for (unsigned int i = 0; i < 100; ++i) {
+      a[i] = Eigen::Matrix3cd::Random();
+      b[i] = Eigen::Matrix3cd::Random();
+      x[i] = Eigen::Vector3cd::Random();
+    }
+
+    c = a * b;
+    for (unsigned int i = 0; i < 100; ++i) {
+      REQUIRE(c[i].isApprox(a[i] * b[i], 1e-12));
+    }
+    c = a * b.adjoint();
+    for (unsigned int i = 0; i < 100; ++i) {
+      REQUIRE(c[i].isApprox(a[i] * b[i].adjoint(), 1e-12));
+    }
+    y = a * x;
+    for (unsigned int i = 0; i < 100; ++i) {
+      REQUIRE(y[i].isApprox(a[i] * x[i], 1e-12));
+    }
+    const pyQCD::MatrixArray<3, 3> a_copy(a);
+    a = a * b;
+    for (unsigned int i = 0; i < 100; ++i) {
+      REQUIRE(a[i].isApprox(a_copy[i] * b[i], 1e-12));
+    }
+  }
+}
@@ -0,0 +1,118 @@
+#define CATCH_CONFIG_MAIN
+
+#include <algorithms/distillation.hpp>
+
+#include "helpers.hpp"
+
+
+typedef pyQCD::MatrixArray<3, 3> GaugeLinks;
+typedef pyQCD::Lattice<GaugeLinks> GaugeField;
+typedef pyQCD::Lattice<pyQCD::MatrixArray<3, 1> > FermionField;
+
+TEST_CASE("Distillation test") {
+  pyQCD::LexicoLayout layout(std::vector<unsigned int>{4, 3, 3, 3});
+  MatrixCompare<Eigen::MatrixXcd> compare(1.0e-8, 1.0e-8);
+
+  GaugeField unit_field(layout, GaugeLinks(4, Eigen::Matrix3cd::Identity()));
+  GaugeField random_field(layout, GaugeLinks(4, Eigen::Matrix3cd::Identity()));
+  for (auto& site_links : random_field) {
+    for (auto& link : site_links) {
+      link = random_sun<3>();
+    }
+  }
+
+  SECTION("Test Laplacian") {
+    pyQCD::Laplacian<3> laplacian(random_field);
+    REQUIRE(laplacian.num_timeslices() == 4);
+    REQUIRE(laplacian.timeslice_volume() == 27);
+
+    std::vector<Eigen::Vector3cd> in(27), out;
+    Eigen::VectorXcd in_dense(81);
+    for (unsigned int s = 0; s < 27; ++s) {
+      in[s] = Eigen::Vector3cd::Random();
+      in_dense.segment<3>(3 * s) = in[s];
+    }
+    laplacian.apply(2, in, out);
+    Eigen::MatrixXcd matrix = laplacian.timeslice_matrix(2);
+    REQUIRE(compare(matrix, matrix.adjoint()));
+
+    Eigen::VectorXcd out_dense = matrix * in_dense;
+    for (unsigned int s = 0; s < 27; ++s) {
+      REQUIRE(compare(out_dense.segment<3>(3 * s), out[s]));
+    }
+  }
+
+  SECTION("Test eigenvector basis") {
+    pyQCD::DistillationBasis<3> free_basis(unit_field, 4);
+    REQUIRE(free_basis.num_timeslices() == 4);
+    // Constant colour vectors are zero modes of the free Laplacian
+    for (unsigned int i = 0; i < 3; ++i) {
+      REQUIRE(std::abs(free_basis.eigenvalues(0)[i]) < 1.0e-10);
+    }
+    REQUIRE(free_basis.eigenvalues(0)[3] > 1.0e-2);
+
+    pyQCD::DistillationBasis<3> basis(random_field, 6);
+    pyQCD::Laplacian<3> laplacian(random_field);
+    for (unsigned int t = 0; t < 4; ++t) {
+      const Eigen::MatrixXcd& vecs = basis.eigenvectors(t);
+      REQUIRE(vecs.cols() == 6);
+      REQUIRE(compare(vecs.adjoint() * vecs, Eigen::MatrixXcd::Identity(6, 6)));
+      Eigen::MatrixXcd lhs = -laplacian.timeslice_matrix(t) * vecs;
+      Eigen::MatrixXcd rhs = vecs * basis.eigenvalues(t).asDiagonal();
+      REQUIRE(compare(lhs, rhs));
+    }
+  }
+
+  SECTION("Test eigenvectors against a dense solver") {
+    pyQCD::LexicoLayout big_layout(std::vector<unsigned int>{2, 4, 4, 4});
+    GaugeField big_field(big_layout,
+                         GaugeLinks(4, Eigen::Matrix3cd::Identity()));
+    for (auto& site_links : big_field) {
+      for (auto& link : site_links) {
+        link = random_sun<3>();
+      }
+    }
+    pyQCD::DistillationBasis<3> basis(big_field, 10);
+    pyQCD::Laplacian<3> laplacian(big_field);
+    for (unsigned int t = 0; t < 2; ++t) {
+      const Eigen::MatrixXcd matrix = -laplacian.timeslice_matrix(t);
+      Eigen::SelfAdjointEigenSolver<Eigen::MatrixXcd> solver(matrix);
+      for (unsigned int i = 0; i < 10; ++i) {
+        REQUIRE(std::abs(basis.eigenvalues(t)[i] - solver.eigenvalues()[i])
+                < 1.0e-9);
+      }
+      const Eigen::MatrixXcd& vecs = basis.eigenvectors(t);
+      REQUIRE(compare(vecs.adjoint() * vecs,
+                      Eigen::MatrixXcd::Identity(10, 10)));
+      REQUIRE(compare(matrix * vecs, vecs * basis.eigenvalues(t).asDiagonal()));
+    }
+  }
+
+  SECTION("Test perambulator and contraction") {
+    pyQCD::DistillationBasis<3> basis(random_field, 3);
+    unsigned int num_solves = 0;
+    // With an identity "solver" the perambulator is delta(t, t0) * identity
+    auto identity_solve = [&] (const std::vector<FermionField>& sources) {
+      num_solves += sources.size();
+      return sources;
+    };
+    pyQCD::Perambulator<> tau
+      = pyQCD::compute_perambulator(basis, 1, 4, identity_solve);
+    REQUIRE(num_solves == 12);
+    REQUIRE(tau.block_size() == 12);
+    REQUIRE(tau.source_timeslice() == 1);
+    for (unsigned int t = 0; t < 4; ++t) {
+      Eigen::MatrixXcd expected = Eigen::MatrixXcd::Zero(12, 12);
+      if (t == 1) {
+        expected.setIdentity();
+      }
+      REQUIRE(compare(tau[t], expected));
+    }
+
+    pyQCD::Array<std::complex<double> > correlator
+      = pyQCD::meson_correlator(tau, pyQCD::gamma5(), pyQCD::gamma5());
+    REQUIRE(correlator.size() == 4);
+    REQUIRE(std::abs(correlator[1] - 12.0) < 1.0e-10);
+    REQUIRE(std::abs(correlator[0]) < 1.0e-10);
+  }
+}
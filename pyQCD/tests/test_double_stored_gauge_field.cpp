@@ -0,0 +1,67 @@
+#define CATCH_CONFIG_MAIN
+
+#include <core/double_stored_gauge_field.hpp>
+#include <gauge_actions/wilson_action.hpp>
+
+#include "helpers.hpp"
+
+
+typedef pyQCD::MatrixArray<3, 3> GaugeLinks;
+typedef pyQCD::Lattice<GaugeLinks> GaugeField;
+
+TEST_CASE("DoubleStoredGaugeField test") {
+  pyQCD::LexicoLayout layout(std::vector<unsigned int>{8, 4, 4, 4});
+  pyQCD::EvenOddLayout eo_layout(std::vector<unsigned int>{8, 4, 4, 4});
+  MatrixCompare<Eigen::Matrix3cd> compare(1.0e-8, 1.0e-8);
+
+  GaugeField links(layout, GaugeLinks(4, Eigen::Matrix3cd::Identity()));
+  for (auto& site_links : links) {
+    for (auto& link : site_links) {
+      link = random_sun<3>();
+    }
+  }
+
+  SECTION("Test storage") {
+    for (unsigned int hops : {1u, 3u}) {
+      pyQCD::DoubleStoredGaugeField<3> double_stored(links, eo_layout, hops);
+      REQUIRE(double_stored.size() == 512);
+      REQUIRE(double_stored.num_dims() == 4);
+      REQUIRE(double_stored.hops() == hops);
+
+      for (unsigned int site : {0u, 5u, 313u, 511u}) {
+        const unsigned int index = eo_layout.get_array_index(site);
+        for (unsigned int mu = 0; mu < 4; ++mu) {
+          const unsigned int fwd
+            = layout.compute_neighbour_index(site, mu, hops);
+          const unsigned int bwd
+            = layout.compute_neighbour_index(site, mu, -hops);
+          REQUIRE(double_stored.fwd_neighbour(index, mu)
+                  == eo_layout.get_array_index(fwd));
+          REQUIRE(double_stored.bwd_neighbour(index, mu)
+                  == eo_layout.get_array_index(bwd));
+          REQUIRE(compare(double_stored.forward(index, mu), links[site][mu]));
+          REQUIRE(compare(double_stored.backward(index, mu),
+                          links[bwd][mu].adjoint()));
+          REQUIRE(compare(double_stored[index][mu], links[site][mu]));
+          REQUIRE(compare(double_stored[index][4 + mu],
+                          links[bwd][mu].adjoint()));
+        }
+      }
+    }
+  }
+
+  SECTION("Test folded links and kernels") {
+    pyQCD::DoubleStoredGaugeField<3> folded(
+      layout, 4, 1, [&] (const unsigned int site, const unsigned int mu)
+      { return Eigen::Matrix3cd(-2.0 * links[site][mu]); });
+    REQUIRE(compare(folded.forward(10, 2), -2.0 * links[10][2]));
+    const unsigned int neighbour = layout.compute_neighbour_index(10, 2, 1);
+    REQUIRE(compare(folded.backward(neighbour, 2),
+                    -2.0 * links[10][2].adjoint()));
+
+    pyQCD::DoubleStoredGaugeField<3> double_stored(links, layout);
+    pyQCD::WilsonGaugeAction<3> action(5.5, layout);
+    REQUIRE(compare(action.compute_staples(double_stored, 17, 3),
+                    action.compute_staples(links, 17, 3)));
+  }
+}
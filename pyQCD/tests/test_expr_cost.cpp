@@ -0,0 +1,91 @@
+#define CATCH_CONFIG_MAIN
+
+#include <complex>
+
+#include <Eigen/Dense>
+
+#include <core/array.hpp>
+#include <core/expr_cost.hpp>
+#include <core/lattice.hpp>
+#include <core/matrix_array.hpp>
+
+#include "helpers.hpp"
+
+
+typedef std::complex<double> Complex;
+typedef Eigen::Matrix3cd ColourMatrix;
+typedef Eigen::Vector3cd ColourVector;
+
+
+static_assert(pyQCD::ElementCostTraits<double>::bytes == 8,
+              "ElementCostTraits<double>::bytes != 8");
+static_assert(pyQCD::ElementCostTraits<Complex>::is_complex,
+              "ElementCostTraits<Complex>::is_complex is false");
+static_assert(pyQCD::ElementCostTraits<ColourMatrix>::bytes == 144,
+              "ElementCostTraits<ColourMatrix>::bytes != 144");
+static_assert(pyQCD::ElementCostTraits<ColourVector>::rows == 3,
+              "ElementCostTraits<ColourVector>::rows != 3");
+static_assert(not pyQCD::ElementCostTraits<Eigen::MatrixXcd>::known,
+              "ElementCostTraits<MatrixXcd>::known is true");
+
+
+TEST_CASE("Expression cost test") {
+  SECTION("Testing operator costs") {
+    REQUIRE((Plus::flops<double, double>() == 1));
+    REQUIRE((Minus::flops<Complex, Complex>() == 2));
+    REQUIRE((Plus::flops<ColourVector, ColourVector>() == 6));
+    REQUIRE((Multiplies::flops<Complex, Complex>() == 6));
+    REQUIRE((Multiplies::flops<double, ColourMatrix>() == 18));
+    REQUIRE((Multiplies::flops<ColourMatrix, Complex>() == 54));
+    // Nine elements, each three multiplications and two additions
+    REQUIRE((Multiplies::flops<ColourMatrix, ColourMatrix>() == 198));
+    REQUIRE((Multiplies::flops<ColourMatrix, ColourVector>() == 66));
+    REQUIRE((Divides::flops<ColourVector, double>() == 6));
+    REQUIRE((Divides::flops<Complex, Complex>() == 11));
+    REQUIRE((Adjoint::flops<ColourMatrix>() == 0));
+    REQUIRE((Multiplies::flops<Eigen::MatrixXcd, Eigen::MatrixXcd>() == 0));
+    // Costs are available at compile time
+    static_assert(Multiplies::flops<ColourMatrix, ColourMatrix>() == 198,
+                  "Multiplies::flops isn't a constant expression");
+  }
+
+  SECTION("Testing expression costs") {
+    typedef pyQCD::Array<ColourMatrix, Eigen::aligned_allocator> MatrixArray;
+    MatrixArray a(10, ColourMatrix::Identity()), b(a), c(a);
+
+    const pyQCD::ExprCost copy = pyQCD::expression_cost(a);
+    REQUIRE(copy.flops == 0);
+    REQUIRE(copy.bytes == 10 * 2 * 144);
+
+    const pyQCD::ExprCost sum = pyQCD::expression_cost(a + b + c);
+    REQUIRE(sum.flops == 10 * 2 * 18);
+    REQUIRE(sum.bytes == 10 * 4 * 144);
+
+    const pyQCD::ExprCost product = pyQCD::expression_cost(a * b + c);
+    REQUIRE(product.flops == 10 * (198 + 18));
+    REQUIRE(product.bytes == 10 * 4 * 144);
+
+    // Broadcast scalars aren't read from memory
+    const pyQCD::ExprCost scaled = pyQCD::expression_cost(5.0 * a + b);
+    REQUIRE(scaled.flops == 10 * (18 + 18));
+    REQUIRE(scaled.bytes == 10 * 3 * 144);
+
+    pyQCD::MatrixArray<3, 3> links(10, ColourMatrix::Identity());
+    const pyQCD::ExprCost adjoint_product
+      = pyQCD::expression_cost(links.adjoint() * links);
+    REQUIRE(adjoint_product.flops == 10 * 198);
+    REQUIRE(adjoint_product.bytes == 10 * 3 * 144);
+  }
+
+  SECTION("Testing lattice expression costs") {
+    pyQCD::LexicoLayout layout(std::vector<unsigned int>{4, 4, 4, 4});
+    pyQCD::Lattice<ColourMatrix, Eigen::aligned_allocator> links(
+      layout, ColourMatrix::Identity());
+    pyQCD::Lattice<ColourVector, Eigen::aligned_allocator> psi(
+      layout, ColourVector::Ones());
+
+    const pyQCD::ExprCost cost = pyQCD::expression_cost(links * psi);
+    REQUIRE(cost.flops == 256 * 66);
+    REQUIRE(cost.bytes == 256 * (144 + 2 * 48));
+  }
+}
@@ -0,0 +1,73 @@
+#define CATCH_CONFIG_MAIN
+
+#include <core/fixed_array.hpp>
+#include <core/lattice.hpp>
+
+#include "helpers.hpp"
+
+
+typedef pyQCD::FixedArray<double, 4> Array4d;
+typedef pyQCD::FixedArray<Eigen::Vector3cd, 4> Spinor;
+
+
+TEST_CASE("FixedArray test") {
+  Array4d array1(1.0);
+  Array4d array2(2.0);
+
+  SECTION("Test storage") {
+    REQUIRE(sizeof(Array4d) == 4 * sizeof(double));
+    REQUIRE(Array4d::size() == 4);
+    REQUIRE(&array1[3] == array1.data() + 3);
+  }
+
+  SECTION("Test arithmetic operators") {
+    Array4d array3 = array1 + array2;
+    for (auto val : array3) {
+      REQUIRE(val == 3.0);
+    }
+    array3 = 2.0 * array1 * array2 - array2 / 2.0;
+    for (auto val : array3) {
+      REQUIRE(val == 3.0);
+    }
+    array3 += array1;
+    array3 *= 2.0;
+    REQUIRE(array3[2] == 8.0);
+  }
+
+  SECTION("Test mixing with Array") {
+    pyQCD::Array<double> array(4, 3.0);
+    Array4d result = array1 * array;
+    REQUIRE(result[0] == 3.0);
+    REQUIRE_THROWS(Array4d(pyQCD::Array<double>(3, 1.0)));
+  }
+}
+
+
+TEST_CASE("Lattice of FixedArray test") {
+  pyQCD::LexicoLayout layout(std::vector<unsigned int>{8, 4, 4, 4});
+  const Eigen::Matrix3cd mat = Eigen::Matrix3cd::Random();
+  const Eigen::Vector3cd vec = Eigen::Vector3cd::Random();
+  MatrixCompare<Eigen::Vector3cd> compare(1.0e-10, 1.0e-12);
+
+  pyQCD::Lattice<Spinor, Eigen::aligned_allocator> psi(layout, Spinor(vec));
+  pyQCD::Lattice<Spinor, Eigen::aligned_allocator> eta(
+    layout, Spinor(Eigen::Vector3cd::Ones()));
+
+  REQUIRE(sizeof(Spinor) == 4 * sizeof(Eigen::Vector3cd));
+  REQUIRE(&psi[1][0] == &psi[0][0] + 4);
+
+  decltype(psi) result = psi + 2.0 * eta;
+  for (auto& site : result) {
+    for (auto& spin : site) {
+      REQUIRE(compare(spin, vec + 2.0 * Eigen::Vector3cd::Ones()));
+    }
+  }
+
+  result = mat * psi;
+  REQUIRE(compare(result[100][3], mat * vec));
+
+  psi[5][1] = Eigen::Vector3cd::Zero();
+  result = psi;
+  REQUIRE(compare(result[5][1], Eigen::Vector3cd::Zero()));
+  REQUIRE(compare(result[5][2], vec));
+}
@@ -0,0 +1,84 @@
+#define CATCH_CONFIG_MAIN
+
+#include <core/fused.hpp>
+#include <core/lattice.hpp>
+
+#include "helpers.hpp"
+
+
+typedef Eigen::Vector3cd ColourVector;
+typedef pyQCD::Lattice<ColourVector, Eigen::aligned_allocator> Field;
+
+
+TEST_CASE("Fused evaluation test") {
+  pyQCD::LexicoLayout layout(std::vector<unsigned int>{8, 4, 4, 4});
+  Field x(layout), r(layout), p(layout), Ap(layout);
+  for (unsigned int i = 0; i < layout.volume(); ++i) {
+    x[i] = ColourVector::Random();
+    r[i] = ColourVector::Random();
+    p[i] = ColourVector::Random();
+    Ap[i] = ColourVector::Random();
+  }
+  const std::complex<double> alpha(0.5, -0.25);
+
+  // Reference results from separate assignments
+  Field x_ref = x, r_ref = r;
+  x_ref = x + alpha * p;
+  r_ref = r - alpha * Ap;
+  double rr_ref = 0.0;
+  for (auto& vec : r_ref) {
+    rr_ref += vec.squaredNorm();
+  }
+
+  SECTION("Testing fused assignments") {
+    const unsigned long version = x.version();
+    pyQCD::fused_evaluate(pyQCD::output(x) += alpha * p,
+                          pyQCD::output(r) -= alpha * Ap);
+    for (unsigned int i = 0; i < layout.volume(); ++i) {
+      REQUIRE(x[i].isApprox(x_ref[i]));
+      REQUIRE(r[i].isApprox(r_ref[i]));
+    }
+    REQUIRE(x.version() > version);
+
+    // Later assignments see the updated values of earlier targets
+    pyQCD::fused_evaluate(pyQCD::output(p) = 2.0 * r,
+                          pyQCD::output(Ap) = p + r);
+    for (unsigned int i = 0; i < layout.volume(); ++i) {
+      REQUIRE(p[i].isApprox(2.0 * r_ref[i]));
+      REQUIRE(Ap[i].isApprox(3.0 * r_ref[i]));
+    }
+  }
+
+  SECTION("Testing fused sums") {
+    const double rr = pyQCD::fused_sum(
+      [&] (const unsigned long i) { return r[i].squaredNorm(); },
+      pyQCD::output(x) += alpha * p, pyQCD::output(r) -= alpha * Ap);
+    REQUIRE(rr == Approx(rr_ref));
+    for (unsigned int i = 0; i < layout.volume(); ++i) {
+      REQUIRE(x[i].isApprox(x_ref[i]));
+      REQUIRE(r[i].isApprox(r_ref[i]));
+    }
+
+    pyQCD::Array<double> values(5000, 1.0);
+    const double total = pyQCD::fused_sum(
+      [&] (const unsigned long i) { return values[i]; },
+      pyQCD::output(values) = 2.0 * values);
+    REQUIRE(total == 10000.0);
+  }
+
+  SECTION("Testing snapshots and errors") {
+    auto snapshot = x.snapshot();
+    const ColourVector x0 = x[0];
+    pyQCD::fused_evaluate(pyQCD::output(x) += alpha * p);
+    REQUIRE(snapshot.num_saved_blocks() == snapshot.num_blocks());
+    x.restore(snapshot);
+    REQUIRE(x[0].isApprox(x0));
+
+    pyQCD::Array<ColourVector, Eigen::aligned_allocator> short_array(
+      10, ColourVector::Zero());
+    REQUIRE_THROWS(pyQCD::fused_evaluate(pyQCD::output(x) += short_array));
+    REQUIRE_THROWS(pyQCD::fused_evaluate(pyQCD::output(x) += alpha * p,
+                                         pyQCD::output(short_array) -= 1.0 *
+                                         short_array));
+  }
+}
@@ -2,6 +2,7 @@
 
 #include <core/array.hpp>
 #include <core/lattice.hpp>
+#include <core/matrix_array.hpp>
 
 #include "helpers.hpp"
 
@@ -42,6 +43,16 @@ TEST_CASE("Lattice test") {
     REQUIRE_THROWS(lattice1 + bad_lattice);
   }
 
+  SECTION("Test buffer reuse for expiring operands") {
+    const double* ptr = &lattice1[0];
+    Lattice lattice3 = 3.0 * std::move(lattice1) - lattice2;
+    REQUIRE(&lattice3[0] == ptr);
+    REQUIRE(lattice3.layout() == &layout);
+    for (auto val : lattice3) {
+      REQUIRE(val == 1.0);
+    }
+  }
+
   SECTION("Test assignment operator") {
     lattice1 = bad_lattice;
     REQUIRE(lattice1[0] == bad_lattice[511]);
@@ -64,6 +75,47 @@ TEST_CASE("Lattice test") {
     REQUIRE(lattice1.num_dims() == 4);
   }
 
+  SECTION("Test per-site transforms") {
+    // Momentum phase exp(i p.x) with p = 2 pi / 8 in the time direction
+    pyQCD::Lattice<std::complex<double> > phases(layout);
+    phases.transform(
+      [] (const unsigned int i, const std::vector<unsigned int>& coords) {
+        return std::polar(1.0, 2.0 * M_PI * coords[0] / 8.0);
+      });
+    REQUIRE(std::abs(phases(std::vector<unsigned int>{2, 1, 0, 3})
+                     - std::complex<double>(0.0, 1.0)) < 1e-12);
+
+    std::vector<unsigned int> counts(512, 0);
+    phases.for_each_site(
+      [&] (const unsigned int i, const std::vector<unsigned int>& coords) {
+        counts[i] += coords[3] + 1;
+      });
+    REQUIRE(counts[layout.get_array_index(7)] == 4);
+
+    const unsigned long version = lattice_array.version();
+    lattice_array.transform(
+      [] (pyQCD::ArrayView<double> site, const unsigned int i,
+          const std::vector<unsigned int>& coords) {
+        site = static_cast<double>(coords[1]);
+      });
+    REQUIRE(lattice_array(std::vector<unsigned int>{0, 3, 0, 0})[2] == 3.0);
+    REQUIRE(lattice_array.version() > version);
+  }
+
+  SECTION("Test versioning") {
+    const unsigned long version = lattice1.version();
+    REQUIRE(version != lattice2.version());
+    lattice1[0] = 2.0;
+    REQUIRE(lattice1.version() == version);
+    lattice1.touch();
+    REQUIRE(lattice1.version() > version);
+    const unsigned long touched_version = lattice1.version();
+    lattice1 += lattice2;
+    REQUIRE(lattice1.version() > touched_version);
+    lattice2 = lattice1 * 2.0;
+    REQUIRE(lattice2.version() > lattice1.version());
+  }
+
   SECTION("Test non-scalar site types") {
     decltype(lattice_array) result
       = lattice_array * arr.broadcast();
@@ -74,4 +126,75 @@ TEST_CASE("Lattice test") {
       }
     }
   }
+
+  SECTION("Test contiguous storage of non-scalar site types") {
+    REQUIRE(lattice_array.size() == 512);
+    REQUIRE(lattice_array.site_size() == 4);
+    REQUIRE(&lattice_array[1][0] == &lattice_array[0][0] + 4);
+    REQUIRE(lattice_array.data() == &lattice_array[0][0]);
+
+    lattice_array[3] = pyQCD::Array<double>(4, 5.0);
+    lattice_array[3][1] = 6.0;
+    REQUIRE(lattice_array[3][0] == 5.0);
+    REQUIRE(lattice_array(3)[1] == 6.0);
+    REQUIRE(lattice_array[4][0] == 2.0);
+
+    pyQCD::Array<double> site_copy = lattice_array[3];
+    site_copy[0] = 1.0;
+    REQUIRE(lattice_array[3][0] == 5.0);
+    REQUIRE(site_copy[1] == 6.0);
+
+    const unsigned long version = lattice_array.version();
+    lattice_array *= 2.0;
+    REQUIRE(lattice_array[3][1] == 12.0);
+    lattice_array += lattice_array * 0.5;
+    REQUIRE(lattice_array[3][1] == 18.0);
+    REQUIRE(lattice_array.version() > version);
+
+    decltype(lattice_array) copy = lattice_array;
+    copy = arr;
+    REQUIRE(copy[3][1] == 2.0);
+    REQUIRE(lattice_array[3][1] == 18.0);
+
+    typedef pyQCD::MatrixArray<3, 3> GaugeLinks;
+    pyQCD::Lattice<GaugeLinks> links(
+      layout, GaugeLinks(4, Eigen::Matrix3cd::Identity()));
+    const Eigen::Matrix3cd mat = Eigen::Matrix3cd::Random();
+    links[10][2] = mat;
+    GaugeLinks adjoint = links[10].adjoint();
+    REQUIRE(adjoint[2].isApprox(mat.adjoint()));
+    pyQCD::Lattice<GaugeLinks> product = links * links;
+    REQUIRE(product[10][2].isApprox(mat * mat));
+    REQUIRE(product[10][0].isApprox(Eigen::Matrix3cd::Identity()));
+    unsigned int num_sites = 0;
+    for (auto& site_links : links) {
+      REQUIRE(site_links.size() == 4);
+      ++num_sites;
+    }
+    REQUIRE(num_sites == 512);
+  }
+
+  SECTION("Test assignment to an empty lattice of non-scalar site types") {
+    typedef pyQCD::MatrixArray<3, 3> GaugeLinks;
+    const Eigen::Matrix3cd mat = Eigen::Matrix3cd::Random();
+    pyQCD::Lattice<GaugeLinks> links(layout, GaugeLinks(4, mat));
+
+    pyQCD::Lattice<GaugeLinks> product(layout);
+    REQUIRE(product.size() == 0);
+    product = links * links;
+    REQUIRE(product.size() == 512);
+    REQUIRE(product.site_size() == 4);
+    REQUIRE(product[10][2].isApprox(mat * mat));
+
+    pyQCD::Lattice<GaugeLinks> copy(layout);
+    copy = links;
+    REQUIRE(copy.site_size() == 4);
+    REQUIRE(copy[10][2].isApprox(mat));
+
+    pyQCD::Lattice<GaugeLinks> uniform(layout);
+    uniform = GaugeLinks(2, Eigen::Matrix3cd::Identity());
+    REQUIRE(uniform.size() == 512);
+    REQUIRE(uniform.site_size() == 2);
+    REQUIRE(uniform[10][1].isApprox(Eigen::Matrix3cd::Identity()));
+  }
 }
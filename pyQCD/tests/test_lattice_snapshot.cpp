@@ -0,0 +1,84 @@
+#define CATCH_CONFIG_MAIN
+
+#include <core/lattice.hpp>
+#include <core/matrix_array.hpp>
+
+#include "helpers.hpp"
+
+
+TEST_CASE("LatticeSnapshot test") {
+  pyQCD::LexicoLayout layout(std::vector<unsigned int>{8, 4, 4, 4});
+
+  SECTION("Testing scalar site types") {
+    pyQCD::Lattice<double> lattice(layout, 1.0);
+    auto snapshot = lattice.snapshot(16);
+    REQUIRE(snapshot.num_blocks() == 32);
+    REQUIRE(snapshot.num_saved_blocks() == 0);
+
+    lattice.prepare_write(20, 21);
+    lattice[20] = 5.0;
+    REQUIRE(snapshot.num_saved_blocks() == 1);
+
+    auto copy = lattice;
+    copy *= 2.0;
+    REQUIRE(snapshot.num_saved_blocks() == 1);
+    REQUIRE_THROWS(copy.restore(snapshot));
+
+    const unsigned long version = lattice.version();
+    lattice.restore(snapshot);
+    REQUIRE(lattice[20] == 1.0);
+    REQUIRE(lattice.version() > version);
+
+    auto second_snapshot = lattice.snapshot();
+    lattice += 1.0;
+    REQUIRE(snapshot.num_saved_blocks() == 32);
+    REQUIRE(second_snapshot.num_saved_blocks() == 8);
+    for (auto val : lattice) {
+      REQUIRE(val == 2.0);
+    }
+    lattice.restore(snapshot);
+    for (auto val : lattice) {
+      REQUIRE(val == 1.0);
+    }
+  }
+
+  SECTION("Testing Array site types") {
+    typedef pyQCD::MatrixArray<3, 3> GaugeLinks;
+    pyQCD::Lattice<GaugeLinks> links(
+      layout, GaugeLinks(4, Eigen::Matrix3cd::Identity()));
+    auto snapshot = links.snapshot(8);
+    REQUIRE(snapshot.num_blocks() == 64);
+
+    const Eigen::Matrix3cd mat = Eigen::Matrix3cd::Random();
+    links.prepare_write(100, 101);
+    links[100][2] = mat;
+    REQUIRE(snapshot.num_saved_blocks() == 1);
+
+    auto second_snapshot = links.snapshot(8);
+    links.restore(snapshot);
+    REQUIRE(links[100][2].isApprox(Eigen::Matrix3cd::Identity()));
+    // Restoring overwrites a block that the second snapshot needs
+    REQUIRE(second_snapshot.num_saved_blocks() == 1);
+    links.restore(second_snapshot);
+    REQUIRE(links[100][2].isApprox(mat));
+
+    links = links * links;
+    REQUIRE(snapshot.num_saved_blocks() == 64);
+    links.restore(snapshot);
+    REQUIRE(links[100][2].isApprox(Eigen::Matrix3cd::Identity()));
+
+    // Assigning a lattice with a different site size saves the whole lattice,
+    // so that restoring the snapshot brings back the earlier shape
+    pyQCD::Lattice<GaugeLinks> wider(layout, GaugeLinks(6, mat));
+    links[100][2] = mat;
+    auto third_snapshot = links.snapshot(8);
+    links = wider;
+    REQUIRE(links.site_size() == 6);
+    REQUIRE(third_snapshot.num_saved_blocks() == 64);
+    links.restore(third_snapshot);
+    REQUIRE(links.site_size() == 4);
+    REQUIRE(links.size() == layout.volume());
+    REQUIRE(links[100][2].isApprox(mat));
+    REQUIRE(links[99][2].isApprox(Eigen::Matrix3cd::Identity()));
+  }
+}
@@ -16,4 +16,54 @@ TEST_CASE("LexicoLayout test") {
              == 313);
   REQUIRE (layout.volume() == 512);
   REQUIRE (layout.num_dims() == 4);
+
+  std::vector<unsigned int> coords(4);
+  layout.compute_site_coords(313, coords);
+  REQUIRE (coords == (std::vector<unsigned int>{4, 3, 2, 1}));
+  REQUIRE (layout.compute_neighbour_index(313, 3, 1) == 314);
+  REQUIRE (layout.compute_neighbour_index(313, 0, -5) == 505);
+}
+
+
+TEST_CASE("EvenOddLayout test") {
+  pyQCD::EvenOddLayout layout(std::vector<unsigned int>{8, 4, 4, 4});
+
+  REQUIRE (layout.volume() == 512);
+  std::vector<unsigned int> coords(4);
+  for (unsigned int i = 0; i < 512; ++i) {
+    layout.compute_site_coords(i, coords);
+    const unsigned int parity
+      = (coords[0] + coords[1] + coords[2] + coords[3]) % 2;
+    REQUIRE ((layout.get_array_index(i) / 256 == parity));
+    REQUIRE (layout.get_site_index(layout.get_array_index(i)) == i);
+  }
+  REQUIRE (layout.get_array_index(0) == 0);
+  REQUIRE (layout.get_array_index(1) == 256);
+  REQUIRE (layout.get_array_index(std::vector<unsigned int>{0, 0, 1, 1}) == 2);
+  REQUIRE_THROWS (pyQCD::EvenOddLayout(std::vector<unsigned int>{8, 4, 4, 3}));
+}
+
+
+TEST_CASE("Layout site loop test") {
+  pyQCD::EvenOddLayout layout(std::vector<unsigned int>{8, 4, 4, 4});
+
+  // Each array index is visited once, with the matching coordinates
+  std::vector<unsigned int> site_indices(512, 1000);
+  layout.for_each_site(
+    [&] (const unsigned int i, const std::vector<unsigned int>& coords) {
+      site_indices[i] = layout.compute_site_index(coords);
+    });
+  for (unsigned int i = 0; i < 512; ++i) {
+    REQUIRE (site_indices[i] == layout.get_site_index(i));
+  }
+
+  // Chunks that start part of the way along a row
+  pyQCD::set_num_threads(3);
+  std::vector<unsigned int> threaded_site_indices(512, 1000);
+  layout.for_each_site(
+    [&] (const unsigned int i, const std::vector<unsigned int>& coords) {
+      threaded_site_indices[i] = layout.compute_site_index(coords);
+    });
+  pyQCD::set_num_threads(1);
+  REQUIRE (threaded_site_indices == site_indices);
 }
@@ -0,0 +1,183 @@
+#define CATCH_CONFIG_MAIN
+
+#include <core/matrix_array.hpp>
+#include <core/detail/matrix_kernels.hpp>
+
+#include "helpers.hpp"
+
+
+typedef Eigen::Matrix<std::complex<double>, 12, 12> Matrix12cd;
+typedef Eigen::Matrix<std::complex<double>, 12, 1> Vector12cd;
+
+
+TEST_CASE("Generic matrix kernel test") {
+  typedef pyQCD::GenericMatrixKernel<std::complex<double>, 3, 3> Kernel;
+  MatrixCompare<Eigen::Matrix3cd> compare(1.0e-10, 1.0e-12);
+  Eigen::Matrix3cd mat1 = Eigen::Matrix3cd::Random();
+  Eigen::Matrix3cd mat2 = Eigen::Matrix3cd::Random();
+  Eigen::Matrix3cd result;
+
+  SECTION("Test multiplication") {
+    Kernel::multiply(mat1, mat2, result);
+    REQUIRE(compare(result, mat1 * mat2));
+    Eigen::Vector3cd vec = Eigen::Vector3cd::Random(), vec_result;
+    Kernel::multiply(mat1, vec, vec_result);
+    REQUIRE(((vec_result - mat1 * vec).norm() < 1.0e-12));
+    Kernel::multiply_adjoint(mat1, mat2, result);
+    REQUIRE(compare(result, mat1 * mat2.adjoint()));
+  }
+
+  SECTION("Test adjoint and trace") {
+    Kernel::adjoint(mat1, result);
+    REQUIRE(compare(result, mat1.adjoint()));
+    REQUIRE((std::abs(Kernel::trace(mat1) - mat1.trace()) < 1.0e-12));
+  }
+
+  SECTION("Test reunitarization") {
+    Eigen::Matrix3cd special_unitary = random_sun<3>();
+    result = special_unitary;
+    Kernel::reunitarize(result);
+    REQUIRE(compare(result, special_unitary));
+
+    result = special_unitary + 1.0e-3 * mat1;
+    Kernel::reunitarize(result);
+    REQUIRE(compare(result * result.adjoint(), Eigen::Matrix3cd::Identity()));
+    REQUIRE((std::abs(result.determinant() - 1.0) < 1.0e-12));
+  }
+}
+
+
+#ifdef PYQCD_GENERATED_KERNELS
+TEST_CASE("Generated matrix kernel test") {
+  typedef pyQCD::MatrixKernel<std::complex<double>, 3, 3> Kernel3;
+  typedef pyQCD::MatrixKernel<std::complex<double>, 3, 1> VectorKernel3;
+  typedef pyQCD::MatrixKernel<std::complex<double>, 12, 12> Kernel12;
+  REQUIRE(Kernel3::specialised);
+  REQUIRE(VectorKernel3::specialised);
+  REQUIRE(Kernel12::specialised);
+  REQUIRE(not (pyQCD::MatrixKernel<std::complex<double>, 2, 2>::specialised));
+
+  SECTION("Test 3x3 kernels") {
+    MatrixCompare<Eigen::Matrix3cd> compare(1.0e-10, 1.0e-12);
+    const Eigen::Matrix3cd mat1 = Eigen::Matrix3cd::Random();
+    const Eigen::Matrix3cd mat2 = Eigen::Matrix3cd::Random();
+    const Eigen::Vector3cd vec1 = Eigen::Vector3cd::Random();
+    const Eigen::Vector3cd vec2 = Eigen::Vector3cd::Random();
+    Eigen::Matrix3cd result;
+    Eigen::Vector3cd vec_result;
+
+    Kernel3::multiply(mat1, mat2, result);
+    REQUIRE(compare(result, mat1 * mat2));
+    Kernel3::multiply(mat1, vec1, vec_result);
+    REQUIRE(((vec_result - mat1 * vec1).norm() < 1.0e-12));
+    Kernel3::multiply_adjoint(mat1, mat2, result);
+    REQUIRE(compare(result, mat1 * mat2.adjoint()));
+    VectorKernel3::multiply_adjoint(vec1, vec2, result);
+    REQUIRE(compare(result, vec1 * vec2.adjoint()));
+    Kernel3::adjoint(mat1, result);
+    REQUIRE(compare(result, mat1.adjoint()));
+    REQUIRE((std::abs(Kernel3::trace(mat1) - mat1.trace()) < 1.0e-12));
+
+    const Eigen::Matrix3cd special_unitary = random_sun<3>();
+    result = special_unitary + 1.0e-3 * mat1;
+    Kernel3::reunitarize(result);
+    REQUIRE(compare(result * result.adjoint(), Eigen::Matrix3cd::Identity()));
+    REQUIRE((std::abs(result.determinant() - 1.0) < 1.0e-12));
+  }
+
+  SECTION("Test 12x12 kernels") {
+    MatrixCompare<Matrix12cd> compare(1.0e-10, 1.0e-12);
+    const Matrix12cd mat1 = Matrix12cd::Random();
+    const Matrix12cd mat2 = Matrix12cd::Random();
+    const Vector12cd vec = Vector12cd::Random();
+    Matrix12cd result;
+    Vector12cd vec_result;
+
+    Kernel12::multiply(mat1, mat2, result);
+    REQUIRE(compare(result, mat1 * mat2));
+    Kernel12::multiply(mat1, vec, vec_result);
+    REQUIRE(((vec_result - mat1 * vec).norm() < 1.0e-12));
+    Kernel12::multiply_adjoint(mat1, mat2, result);
+    REQUIRE(compare(result, mat1 * mat2.adjoint()));
+    Kernel12::adjoint(mat1, result);
+    REQUIRE(compare(result, mat1.adjoint()));
+    REQUIRE((std::abs(Kernel12::trace(mat1) - mat1.trace()) < 1.0e-12));
+  }
+}
+#endif
+
+
+TEST_CASE("Matrix kernel dispatch test") {
+  // These hold whether or not the generated kernels are compiled in, in
+  // which case the operators and the free functions should use them
+  typedef Eigen::Matrix3cd Matrix3cd;
+#ifdef PYQCD_GENERATED_KERNELS
+  static_assert(pyQCD::MultiplyKernelTraits<Matrix12cd, Matrix12cd>::enabled,
+                "12x12 multiplication kernel not enabled");
+  static_assert(pyQCD::MultiplyKernelTraits<Matrix12cd, Vector12cd>::enabled,
+                "12x12 matrix-vector kernel not enabled");
+  static_assert(
+    pyQCD::MultiplyAdjointKernelTraits<Matrix3cd, Matrix3cd>::enabled,
+    "3x3 multiplication by adjoint kernel not enabled");
+  static_assert(pyQCD::AdjointKernelTraits<Matrix12cd>::enabled,
+                "12x12 adjoint kernel not enabled");
+#endif
+  MatrixCompare<Matrix3cd> compare(1.0e-10, 1.0e-12);
+  pyQCD::MatrixArray<3, 3> array1(10, Matrix3cd::Random());
+  pyQCD::MatrixArray<3, 3> array2(10, Matrix3cd::Random());
+  for (unsigned int i = 0; i < array1.size(); ++i) {
+    array1[i] = Matrix3cd::Random();
+    array2[i] = Matrix3cd::Random();
+  }
+
+  SECTION("Test multiplication") {
+    pyQCD::MatrixArray<3, 3> result = array1 * array2;
+    for (unsigned int i = 0; i < result.size(); ++i) {
+      REQUIRE(compare(result[i], array1[i] * array2[i]));
+    }
+  }
+
+  SECTION("Test adjoint") {
+    pyQCD::MatrixArray<3, 3> result = array1.adjoint();
+    for (unsigned int i = 0; i < result.size(); ++i) {
+      REQUIRE(compare(result[i], array1[i].adjoint()));
+    }
+  }
+
+  SECTION("Test multiplication by adjoint") {
+    pyQCD::MatrixArray<3, 3> result = array1 * array2.adjoint();
+    for (unsigned int i = 0; i < result.size(); ++i) {
+      REQUIRE(compare(result[i], array1[i] * array2[i].adjoint()));
+    }
+    const pyQCD::MatrixArray<3, 3> product = array2 * array1;
+    result = (array1 * array2) * product.adjoint();
+    for (unsigned int i = 0; i < result.size(); ++i) {
+      REQUIRE(compare(result[i], array1[i] * array2[i]
+                      * product[i].adjoint()));
+    }
+  }
+
+  SECTION("Test 12x12 operators") {
+    MatrixCompare<Matrix12cd> compare12(1.0e-10, 1.0e-12);
+    pyQCD::MatrixArray<12, 12> array3(4, Matrix12cd::Random());
+    pyQCD::MatrixArray<12, 12> array4(4, Matrix12cd::Random());
+    pyQCD::MatrixArray<12, 12> result = array3 * array4;
+    REQUIRE(compare12(result[0], array3[0] * array4[0]));
+    result = array3 * array4.adjoint();
+    REQUIRE(compare12(result[0], array3[0] * array4[0].adjoint()));
+  }
+
+  SECTION("Test free functions") {
+    Matrix3cd result;
+    pyQCD::multiply(array1[0], array2[0], result);
+    REQUIRE(compare(result, array1[0] * array2[0]));
+    pyQCD::multiply_adjoint(array1[0], array2[0], result);
+    REQUIRE(compare(result, array1[0] * array2[0].adjoint()));
+    pyQCD::adjoint(array1[0], result);
+    REQUIRE(compare(result, array1[0].adjoint()));
+    // Shapes without a generated kernel fall back to Eigen
+    Eigen::Matrix2cd mat = Eigen::Matrix2cd::Random(), mat_result;
+    pyQCD::multiply_adjoint(mat, mat, mat_result);
+    REQUIRE((mat_result - mat * mat.adjoint()).norm() < 1.0e-12);
+  }
+}
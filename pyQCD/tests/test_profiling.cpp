@@ -0,0 +1,79 @@
+#define CATCH_CONFIG_MAIN
+#define PYQCD_ENABLE_PROFILING
+
+#include <string>
+#include <vector>
+
+#include <core/array.hpp>
+#include <core/lattice.hpp>
+#include <utils/parallel.hpp>
+#include <utils/profiling.hpp>
+#include <utils/thread_pool.hpp>
+
+#include "helpers.hpp"
+
+
+pyQCD::KernelStats find_stats(const std::string& name)
+{
+  for (auto& stats : pyQCD::profile_stats()) {
+    if (stats.name == name) {
+      return stats;
+    }
+  }
+  return pyQCD::KernelStats{name, 0, 0.0, 0, 0};
+}
+
+
+void profiled_kernel(const unsigned long flops, const unsigned long bytes)
+{
+  PYQCD_PROFILE_SCOPE_COST("test kernel", flops, bytes);
+}
+
+
+TEST_CASE("Profiling test") {
+  REQUIRE(pyQCD::profiling_enabled());
+  pyQCD::reset_profile();
+
+  SECTION("Testing scoped counters") {
+    for (unsigned int i = 0; i < 10; ++i) {
+      profiled_kernel(100, 200);
+    }
+    const pyQCD::KernelStats stats = find_stats("test kernel");
+    REQUIRE(stats.calls == 10);
+    REQUIRE(stats.flops == 1000);
+    REQUIRE(stats.bytes == 2000);
+    REQUIRE(stats.seconds >= 0.0);
+
+    const std::string report = pyQCD::profile_report();
+    REQUIRE(report.find("test kernel") != std::string::npos);
+
+    pyQCD::reset_profile();
+    REQUIRE(find_stats("test kernel").calls == 0);
+  }
+
+  SECTION("Testing counters are thread-safe") {
+    pyQCD::set_num_threads(4);
+    pyQCD::parallel_for(0, 10000, [] (const unsigned long i) {
+      profiled_kernel(1, 2);
+    });
+    const pyQCD::KernelStats stats = find_stats("test kernel");
+    REQUIRE(stats.calls == 10000);
+    REQUIRE(stats.flops == 10000);
+    REQUIRE(stats.bytes == 20000);
+  }
+
+  SECTION("Testing instrumented kernels") {
+    pyQCD::Array<double> a(100, 1.0), b(100, 2.0);
+    a = a + 5.0 * b;
+    const pyQCD::KernelStats evaluation = find_stats("Array evaluation");
+    REQUIRE(evaluation.calls == 1);
+    REQUIRE(evaluation.flops == 200);
+    REQUIRE(evaluation.bytes == 100 * 3 * sizeof(double));
+
+    pyQCD::LexicoLayout lexico(std::vector<unsigned int>{4, 4, 4, 4});
+    pyQCD::EvenOddLayout even_odd(std::vector<unsigned int>{4, 4, 4, 4});
+    pyQCD::Lattice<double> x(lexico, 1.0), y(even_odd, 2.0);
+    x = y;
+    REQUIRE(find_stats("Lattice copy").calls == 1);
+  }
+}
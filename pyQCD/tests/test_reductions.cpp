@@ -0,0 +1,63 @@
+#define CATCH_CONFIG_MAIN
+
+#include <core/lattice.hpp>
+#include <core/reductions.hpp>
+
+#include "helpers.hpp"
+
+
+TEST_CASE("Reductions test") {
+  pyQCD::LexicoLayout layout(std::vector<unsigned int>{8, 4, 4, 4});
+  pyQCD::Lattice<double> lattice(layout);
+  for (unsigned int i = 0; i < lattice.size(); ++i) {
+    lattice[i] = i;
+  }
+
+  SECTION("Testing timeslice sums") {
+    pyQCD::Array<double> result = pyQCD::timeslice_sum(2.0 * lattice);
+    REQUIRE(result.size() == 8);
+    for (unsigned int t = 0; t < 8; ++t) {
+      // Sites 64 t, ..., 64 t + 63
+      REQUIRE(result[t] == 2.0 * (64.0 * 64.0 * t + 63.0 * 64.0 / 2.0));
+    }
+
+    result = pyQCD::timeslice_sum(lattice, 3);
+    REQUIRE(result.size() == 4);
+    for (unsigned int z = 0; z < 4; ++z) {
+      REQUIRE(result[z] == 128.0 * (254.0 + z));
+    }
+
+    pyQCD::Array<double> no_layout(10, 1.0);
+    REQUIRE_THROWS(pyQCD::timeslice_sum(no_layout));
+  }
+
+  SECTION("Testing binned sums") {
+    pyQCD::Array<double> values(5000, 1.0);
+    pyQCD::Array<double> result = pyQCD::binned_sum(values, 3,
+      [] (const unsigned long i) { return i % 3; });
+    REQUIRE(result[0] == 1667.0);
+    REQUIRE(result[1] == 1667.0);
+    REQUIRE(result[2] == 1666.0);
+
+    REQUIRE_THROWS(pyQCD::binned_sum(values, 2,
+      [] (const unsigned long i) { return 2u; }));
+
+    pyQCD::Lattice<Eigen::Matrix3cd> mats(layout, Eigen::Matrix3cd::Identity());
+    pyQCD::Array<Eigen::Matrix3cd> mat_result = pyQCD::timeslice_sum(mats);
+    REQUIRE(mat_result[5].isApprox(64.0 * Eigen::Matrix3cd::Identity()));
+  }
+
+  SECTION("Testing reproducibility") {
+    pyQCD::Lattice<double> noise(layout);
+    for (unsigned int i = 0; i < noise.size(); ++i) {
+      noise[i] = std::sin(1.0e3 * i);
+    }
+    const pyQCD::Array<double> first = pyQCD::timeslice_sum(noise * noise);
+    for (int trial = 0; trial < 10; ++trial) {
+      const pyQCD::Array<double> again = pyQCD::timeslice_sum(noise * noise);
+      for (unsigned int t = 0; t < 8; ++t) {
+        REQUIRE(again[t] == first[t]);
+      }
+    }
+  }
+}
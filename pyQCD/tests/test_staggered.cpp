@@ -0,0 +1,135 @@
+#define CATCH_CONFIG_MAIN
+
+#include <fermion_actions/staggered.hpp>
+
+#include "helpers.hpp"
+
+
+typedef pyQCD::MatrixArray<3, 3> GaugeLinks;
+typedef pyQCD::Lattice<GaugeLinks> GaugeField;
+typedef pyQCD::StaggeredOperator<3> Operator;
+typedef Operator::ColourField ColourField;
+
+std::complex<double> inner_product(const ColourField& lhs,
+                                   const ColourField& rhs)
+{
+  std::complex<double> ret = 0.0;
+  for (unsigned int i = 0; i < lhs.size(); ++i) {
+    ret += lhs[i].dot(rhs[i]);
+  }
+  return ret;
+}
+
+
+ColourField random_field(const unsigned int size)
+{
+  ColourField ret(size, Eigen::Vector3cd::Zero());
+  for (auto& vec : ret) {
+    vec = Eigen::Vector3cd::Random();
+  }
+  return ret;
+}
+
+
+TEST_CASE("StaggeredOperator test") {
+  pyQCD::LexicoLayout layout(std::vector<unsigned int>{8, 4, 4, 4});
+  MatrixCompare<Eigen::Vector3cd> compare(1.0e-8, 1.0e-8);
+
+  GaugeField links(layout, GaugeLinks(4, Eigen::Matrix3cd::Identity()));
+  GaugeField long_links(links);
+  for (unsigned int i = 0; i < links.volume(); ++i) {
+    for (unsigned int mu = 0; mu < 4; ++mu) {
+      links[i][mu] = random_sun<3>();
+      long_links[i][mu] = random_sun<3>();
+    }
+  }
+  const std::vector<std::complex<double> > boundary_phases
+    {-1.0, 1.0, 1.0, 1.0};
+
+  Operator unimproved(links, 0.1, boundary_phases);
+  Operator improved(links, long_links, -1.0 / 24.0, 0.1, boundary_phases);
+
+  SECTION("Test operator against direct evaluation") {
+    const pyQCD::Layout& eo_layout = improved.layout();
+    ColourField psi = random_field(improved.volume());
+    ColourField eta(improved.volume(), Eigen::Vector3cd::Zero());
+    improved.apply(psi, eta);
+
+    // Site at time boundary, so boundary conditions come into play
+    const std::vector<unsigned int> site{7, 1, 2, 3};
+    const unsigned int site_index = layout.compute_site_index(site);
+    Eigen::Vector3cd expected = 0.1 * psi[eo_layout.get_array_index(site)];
+    unsigned int coord_sum = 0;
+    for (unsigned int mu = 0; mu < 4; ++mu) {
+      const double eta_mu = coord_sum % 2 == 0 ? 0.5 : -0.5;
+      coord_sum += site[mu];
+      for (int hops : {1, 3}) {
+        const GaugeField& hop_links = hops == 1 ? links : long_links;
+        const double coeff = hops == 1 ? eta_mu : -eta_mu / 24.0;
+        const unsigned int fwd
+          = layout.compute_neighbour_index(site_index, mu, hops);
+        const unsigned int bwd
+          = layout.compute_neighbour_index(site_index, mu, -hops);
+        const double fwd_bc
+          = (mu == 0 and site[mu] + hops >= 8) ? -1.0 : 1.0;
+        const double bwd_bc
+          = (mu == 0 and static_cast<int>(site[mu]) - hops < 0) ? -1.0 : 1.0;
+        expected += coeff * fwd_bc * hop_links[site_index][mu]
+          * psi[eo_layout.get_array_index(fwd)];
+        expected -= coeff * bwd_bc * hop_links[bwd][mu].adjoint()
+          * psi[eo_layout.get_array_index(bwd)];
+      }
+    }
+    REQUIRE(compare(eta[eo_layout.get_array_index(site)], expected));
+  }
+
+  SECTION("Test anti-Hermiticity of hopping term") {
+    for (Operator* op : {&unimproved, &improved}) {
+      ColourField psi = random_field(op->volume());
+      ColourField phi = random_field(op->volume());
+      ColourField d_psi(op->volume(), Eigen::Vector3cd::Zero());
+      ColourField d_phi(op->volume(), Eigen::Vector3cd::Zero());
+      op->apply(psi, d_psi);
+      op->apply(phi, d_phi);
+      // <phi, (M - m) psi> = -<(M - m) phi, psi>
+      const std::complex<double> lhs
+        = inner_product(phi, d_psi) - 0.1 * inner_product(phi, psi);
+      const std::complex<double> rhs
+        = -(inner_product(d_phi, psi) - 0.1 * inner_product(phi, psi));
+      REQUIRE(std::abs(lhs - rhs) < 1.0e-10);
+    }
+  }
+
+  SECTION("Test even-odd preconditioning") {
+    const unsigned int half_volume = improved.half_volume();
+    ColourField solution = random_field(improved.volume());
+    ColourField source(improved.volume(), Eigen::Vector3cd::Zero());
+    improved.apply(solution, source);
+
+    ColourField even_solution(half_volume, Eigen::Vector3cd::Zero());
+    std::copy(solution.begin(), solution.begin() + half_volume,
+              even_solution.begin());
+
+    ColourField even_source(half_volume, Eigen::Vector3cd::Zero());
+    ColourField lhs(half_volume, Eigen::Vector3cd::Zero());
+    improved.prepare_even_odd_source(source, even_source);
+    improved.apply_even_odd(even_solution, lhs);
+    for (unsigned int i = 0; i < half_volume; ++i) {
+      REQUIRE(compare(lhs[i], even_source[i]));
+    }
+
+    ColourField reconstructed(improved.volume(), Eigen::Vector3cd::Zero());
+    improved.reconstruct_solution(source, even_solution, reconstructed);
+    for (unsigned int i = 0; i < improved.volume(); ++i) {
+      REQUIRE(compare(reconstructed[i], solution[i]));
+    }
+
+    // The preconditioned operator is Hermitian positive definite
+    ColourField psi = random_field(half_volume);
+    ColourField m_psi(half_volume, Eigen::Vector3cd::Zero());
+    improved.apply_even_odd(psi, m_psi);
+    const std::complex<double> norm = inner_product(psi, m_psi);
+    REQUIRE(std::abs(norm.imag()) < 1.0e-10);
+    REQUIRE(norm.real() > 0.0);
+  }
+}
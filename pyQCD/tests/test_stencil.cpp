@@ -0,0 +1,118 @@
+#define CATCH_CONFIG_MAIN
+
+#include <core/lattice.hpp>
+#include <core/matrix_array.hpp>
+#include <core/stencil.hpp>
+
+#include "helpers.hpp"
+
+
+typedef Eigen::Vector3cd ColourVector;
+typedef pyQCD::Lattice<ColourVector, Eigen::aligned_allocator> Field;
+typedef pyQCD::MatrixArray<3, 3> GaugeLinks;
+typedef pyQCD::Lattice<GaugeLinks> GaugeField;
+
+
+TEST_CASE("Stencil test") {
+  pyQCD::EvenOddLayout layout(std::vector<unsigned int>{4, 4, 4, 4});
+  GaugeField links(layout, GaugeLinks(4, Eigen::Matrix3cd::Identity()));
+  for (auto& site_links : links) {
+    for (auto& link : site_links) {
+      link = random_sun<3>();
+    }
+  }
+  Field psi(layout);
+  for (auto& vec : psi) {
+    vec = ColourVector::Random();
+  }
+  MatrixCompare<ColourVector> comp(1e-10, 1e-10);
+
+  SECTION("Testing covariant Laplacian") {
+    std::vector<pyQCD::StencilTerm<std::complex<double> > > terms;
+    terms.push_back(pyQCD::shift_term(std::complex<double>(-8.0), 0, 0));
+    for (unsigned int mu = 0; mu < 4; ++mu) {
+      terms.push_back(pyQCD::shift_term(std::complex<double>(1.0), mu, 1));
+      terms.push_back(pyQCD::shift_term(std::complex<double>(1.0), mu, -1));
+    }
+    pyQCD::Stencil<> laplacian(layout, terms);
+    REQUIRE(laplacian.num_terms() == 9);
+
+    Field out(layout, pyQCD::Uninitialized());
+    laplacian.apply(links, psi, out);
+    for (unsigned int site = 0; site < layout.volume(); ++site) {
+      ColourVector expected = -8.0 * psi(site);
+      for (unsigned int mu = 0; mu < 4; ++mu) {
+        const unsigned int fwd = layout.compute_neighbour_index(site, mu, 1);
+        const unsigned int bwd = layout.compute_neighbour_index(site, mu, -1);
+        expected += links(site)[mu] * psi(fwd);
+        expected += links(bwd)[mu].adjoint() * psi(bwd);
+      }
+      REQUIRE(comp(out(site), expected));
+    }
+
+    // Stencils can be used in expressions
+    Field combined = psi - 0.5 * laplacian(links, psi);
+    REQUIRE(combined.layout() == &layout);
+    for (unsigned int i = 0; i < layout.volume(); ++i) {
+      REQUIRE(comp(combined[i], ColourVector(psi[i] - 0.5 * out[i])));
+    }
+    // Expressions containing a stencil are evaluated on several threads
+    pyQCD::set_num_threads(4);
+    Field threaded_combined = psi - 0.5 * laplacian(links, psi);
+    Field threaded_out(layout, pyQCD::Uninitialized());
+    threaded_out = laplacian(links, psi);
+    pyQCD::set_num_threads(1);
+    for (unsigned int i = 0; i < layout.volume(); ++i) {
+      REQUIRE(threaded_combined[i] == combined[i]);
+      REQUIRE(threaded_out[i] == out[i]);
+    }
+    REQUIRE_THROWS(laplacian.apply(links, psi, psi));
+  }
+
+  SECTION("Testing closed paths") {
+    // Clover leaf in the (0, 1) plane
+    std::vector<pyQCD::Hop> path{{0, 1}, {1, 1}, {0, -1}, {1, -1}};
+    pyQCD::Stencil<> leaf(layout,
+      {pyQCD::StencilTerm<std::complex<double> >{1.0, path}});
+    Field out = leaf(links, psi);
+    for (unsigned int site = 0; site < layout.volume(); ++site) {
+      const unsigned int x_p0 = layout.compute_neighbour_index(site, 0, 1);
+      const unsigned int x_p1 = layout.compute_neighbour_index(site, 1, 1);
+      const Eigen::Matrix3cd plaquette = links(site)[0] * links(x_p0)[1]
+        * links(x_p1)[0].adjoint() * links(site)[1].adjoint();
+      REQUIRE(comp(out(site), ColourVector(plaquette * psi(site))));
+    }
+  }
+
+  SECTION("Testing unit links") {
+    pyQCD::LexicoLayout lexico_layout(std::vector<unsigned int>{8, 4, 4, 4});
+    pyQCD::Lattice<double> field(lexico_layout);
+    for (unsigned int i = 0; i < field.size(); ++i) {
+      field[i] = i;
+    }
+    pyQCD::Stencil<double> derivative(lexico_layout,
+      {pyQCD::shift_term(0.5, 3, 2), pyQCD::shift_term(-0.5, 3, -2)});
+    pyQCD::Lattice<double> out(lexico_layout);
+    derivative.apply(field, out);
+    REQUIRE(out[5] == 0.5 * (7.0 - 7.0));
+    REQUIRE(out[1] == 0.5 * (3.0 - 3.0));
+    REQUIRE(out[64] == 0.5 * (66.0 - 66.0));
+    REQUIRE(out[4] == 0.5 * (6.0 - 6.0));
+
+    pyQCD::Stencil<double> shift(lexico_layout, {pyQCD::shift_term(1.0, 0, 3)});
+    shift.apply(field, out);
+    REQUIRE(out[0] == 192.0);
+    REQUIRE(out[448] == 128.0);
+
+    // The stencil reads other sites of field, so the result can't take over
+    // the buffer of field even though it's about to expire
+    const double* ptr = &field[0];
+    pyQCD::Lattice<double> diff = std::move(field) - shift(field);
+    REQUIRE(&diff[0] != ptr);
+    REQUIRE(diff[0] == 0.0 - 192.0);
+    REQUIRE(diff[448] == 448.0 - 128.0);
+    REQUIRE(diff[200] == 200.0 - 392.0);
+    REQUIRE_THROWS(pyQCD::Stencil<double>(lexico_layout,
+      {pyQCD::shift_term(1.0, 4, 1)}));
+  }
+}
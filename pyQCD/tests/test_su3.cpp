@@ -0,0 +1,179 @@
+#define CATCH_CONFIG_MAIN
+
+#include <algorithms/su3.hpp>
+#include <core/matrix_array.hpp>
+
+#include "helpers.hpp"
+
+
+typedef pyQCD::MatrixArray<3, 3> GaugeLinks;
+typedef pyQCD::Lattice<GaugeLinks> GaugeField;
+
+
+Eigen::Matrix3cd random_hermitian_traceless(const double scale)
+{
+  Eigen::Matrix3cd ret = Eigen::Matrix3cd::Random();
+  ret = 0.5 * (ret + ret.adjoint()).eval();
+  ret.diagonal().array() -= ret.trace() / 3.0;
+  return scale * ret;
+}
+
+
+Eigen::Matrix3cd exp_series(const Eigen::Matrix3cd& Q)
+{
+  const std::complex<double> I(0.0, 1.0);
+  Eigen::Matrix3cd ret = Eigen::Matrix3cd::Identity();
+  Eigen::Matrix3cd term = Eigen::Matrix3cd::Identity();
+  for (int n = 1; n < 80; ++n) {
+    term = (term * I * Q / static_cast<double>(n)).eval();
+    ret += term;
+  }
+  return ret;
+}
+
+
+TEST_CASE("SU(3) exponential test") {
+  MatrixCompare<Eigen::Matrix3cd> compare(1.0e-10, 1.0e-12);
+  const Eigen::Matrix3cd identity = Eigen::Matrix3cd::Identity();
+
+  SECTION("Test exp(iQ)") {
+    for (double scale : {0.0, 1.0e-4, 0.05, 0.1, 0.5, 2.0}) {
+      const Eigen::Matrix3cd Q = random_hermitian_traceless(scale);
+      for (const Eigen::Matrix3cd& mat : {Q, Eigen::Matrix3cd(-Q)}) {
+        const Eigen::Matrix3cd result = pyQCD::exp_i(mat);
+        REQUIRE(compare(result, exp_series(mat)));
+        REQUIRE(compare(result * result.adjoint(), identity));
+        REQUIRE((std::abs(result.determinant() - 1.0) < 1.0e-12));
+      }
+    }
+  }
+
+  SECTION("Test coefficient derivatives") {
+    // df_j / d(eps) = b1j dc1 / d(eps) + b2j dc0 / d(eps) for Q + eps X
+    const double eps = 1.0e-6;
+    for (double scale : {0.02, 0.1, 0.3, 1.0, 2.0}) {
+      const Eigen::Matrix3cd Q = random_hermitian_traceless(scale);
+      const Eigen::Matrix3cd X = random_hermitian_traceless(1.0);
+      for (const Eigen::Matrix3cd& mat : {Q, Eigen::Matrix3cd(-Q)}) {
+        const auto coeffs = pyQCD::compute_exp_coefficients(mat, true);
+        const auto plus
+          = pyQCD::compute_exp_coefficients(Eigen::Matrix3cd(mat + eps * X));
+        const auto minus
+          = pyQCD::compute_exp_coefficients(Eigen::Matrix3cd(mat - eps * X));
+        const double dc0 = (mat * mat * X).trace().real();
+        const double dc1 = (mat * X).trace().real();
+        for (unsigned int j = 0; j < 3; ++j) {
+          const std::complex<double> expected
+            = (plus.f[j] - minus.f[j]) / (2.0 * eps);
+          const std::complex<double> result
+            = coeffs.b1[j] * dc1 + coeffs.b2[j] * dc0;
+          REQUIRE((std::abs(result - expected) < 1.0e-6));
+        }
+      }
+    }
+  }
+
+  SECTION("Test series and closed form agree") {
+    Eigen::Matrix3cd Q = random_hermitian_traceless(1.0);
+    Q *= std::sqrt(2.0 * pyQCD::detail::exp_series_threshold
+                   / (Q * Q).trace().real());
+    const auto below = pyQCD::compute_exp_coefficients(
+      Eigen::Matrix3cd((1.0 - 1.0e-12) * Q), true);
+    const auto above = pyQCD::compute_exp_coefficients(
+      Eigen::Matrix3cd((1.0 + 1.0e-12) * Q), true);
+    for (unsigned int j = 0; j < 3; ++j) {
+      REQUIRE((std::abs(below.f[j] - above.f[j]) < 1.0e-10));
+      REQUIRE((std::abs(below.b1[j] - above.b1[j]) < 1.0e-8));
+      REQUIRE((std::abs(below.b2[j] - above.b2[j]) < 1.0e-8));
+    }
+  }
+}
+
+
+TEST_CASE("SU(3) projection test") {
+  MatrixCompare<Eigen::Matrix3cd> compare(1.0e-10, 1.0e-12);
+  const Eigen::Matrix3cd identity = Eigen::Matrix3cd::Identity();
+
+  pyQCD::LexicoLayout layout(std::vector<unsigned int>{4, 2, 2, 2});
+  GaugeField links(layout, GaugeLinks(4, identity));
+  for (auto& site_links : links) {
+    for (auto& link : site_links) {
+      link = random_sun<3>();
+    }
+  }
+  GaugeField noisy = links;
+  for (auto& site_links : noisy) {
+    for (auto& link : site_links) {
+      link += 1.0e-3 * Eigen::Matrix3cd::Random();
+    }
+  }
+
+  SECTION("Test reunitarize") {
+    GaugeField result = links;
+    pyQCD::reunitarize(links, result);
+    REQUIRE(compare(result[5][2], links[5][2]));
+
+    const unsigned long version = noisy.version();
+    pyQCD::reunitarize(noisy, noisy);
+    REQUIRE(noisy.version() != version);
+    for (auto& site_links : noisy) {
+      for (auto& link : site_links) {
+        REQUIRE(compare(link * link.adjoint(), identity));
+        REQUIRE((std::abs(link.determinant() - 1.0) < 1.0e-12));
+      }
+    }
+  }
+
+  SECTION("Test project_su3") {
+    GaugeField result = links;
+    GaugeField scaled = links;
+    for (auto& site_links : scaled) {
+      for (auto& link : site_links) {
+        link *= std::polar(2.0, 0.3);
+      }
+    }
+    pyQCD::project_su3(scaled, result);
+    REQUIRE(compare(result[7][1], links[7][1]));
+
+    pyQCD::project_su3(noisy, result);
+    for (unsigned int i = 0; i < result.size(); ++i) {
+      for (auto& link : result[i]) {
+        REQUIRE(compare(link * link.adjoint(), identity));
+        REQUIRE((std::abs(link.determinant() - 1.0) < 1.0e-12));
+      }
+      REQUIRE(((result[i][0] - links[i][0]).norm() < 1.0e-2));
+    }
+  }
+
+  SECTION("Test on several threads") {
+    pyQCD::LexicoLayout big_layout(std::vector<unsigned int>{8, 4, 4, 4});
+    GaugeField big_noisy(big_layout, GaugeLinks(4, identity));
+    for (auto& site_links : big_noisy) {
+      for (auto& link : site_links) {
+        link = random_sun<3>() + 1.0e-3 * Eigen::Matrix3cd::Random();
+      }
+    }
+    GaugeField result = big_noisy;
+    pyQCD::set_num_threads(4);
+    pyQCD::reunitarize(big_noisy, result);
+    pyQCD::set_num_threads(1);
+    for (unsigned int i = 0; i < result.size(); ++i) {
+      for (unsigned int mu = 0; mu < 4; ++mu) {
+        REQUIRE(compare(result[i][mu], pyQCD::reunitarize(
+          Eigen::Matrix3cd(big_noisy[i][mu]))));
+      }
+    }
+  }
+
+  SECTION("Test exponential of a field") {
+    GaugeLinks Q(4, identity);
+    for (auto& mat : Q) {
+      mat = random_hermitian_traceless(0.5);
+    }
+    GaugeLinks result(4, identity);
+    pyQCD::exp_i(Q, result);
+    for (unsigned int mu = 0; mu < 4; ++mu) {
+      REQUIRE(compare(result[mu], exp_series(Q[mu])));
+    }
+  }
+}
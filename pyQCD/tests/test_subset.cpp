@@ -0,0 +1,98 @@
+#define CATCH_CONFIG_MAIN
+
+#include <core/lattice.hpp>
+#include <core/matrix_array.hpp>
+#include <core/subset.hpp>
+
+#include "helpers.hpp"
+
+
+TEST_CASE("Subset test") {
+  pyQCD::LexicoLayout layout(std::vector<unsigned int>{8, 4, 4, 4});
+
+  SECTION("Testing construction") {
+    pyQCD::Subset range(10, 20);
+    REQUIRE(range.size() == 10);
+    REQUIRE(range.ranges().size() == 1);
+
+    pyQCD::Subset list(std::vector<unsigned int>{7, 3, 4, 5, 3, 9});
+    REQUIRE(list.size() == 5);
+    REQUIRE(list.ranges().size() == 3);
+    REQUIRE(list.ranges()[0] == pyQCD::Subset::range_type(3, 6));
+
+    auto timeslice = pyQCD::timeslice_subset(layout, 2);
+    REQUIRE(timeslice.size() == 64);
+    REQUIRE(timeslice.ranges().size() == 1);
+    REQUIRE(timeslice.ranges()[0] == pyQCD::Subset::range_type(128, 192));
+
+    auto even = pyQCD::parity_subset(layout, 0);
+    auto odd = pyQCD::parity_subset(layout, 1);
+    REQUIRE(even.size() == 256);
+    REQUIRE(odd.size() == 256);
+    REQUIRE(even.ranges()[0].first == 0);
+    REQUIRE(odd.ranges()[0].first == 1);
+
+    auto sites = pyQCD::site_subset(layout, std::vector<unsigned int>{0, 511});
+    REQUIRE(sites.size() == 2);
+    REQUIRE_THROWS(
+      pyQCD::site_subset(layout, std::vector<unsigned int>{512}));
+  }
+
+  SECTION("Testing assignment") {
+    pyQCD::Lattice<double> lattice1(layout, 1.0), lattice2(layout, 2.0);
+    pyQCD::Lattice<double> result(layout, 0.0);
+    const unsigned long version = result.version();
+    result.assign(pyQCD::timeslice_subset(layout, 1), lattice1 + lattice2);
+    REQUIRE(result.version() > version);
+    for (unsigned int i = 0; i < result.size(); ++i) {
+      REQUIRE(result[i] == ((i >= 64 and i < 128) ? 3.0 : 0.0));
+    }
+    REQUIRE_THROWS(result.assign(pyQCD::Subset(0, 1000), lattice1));
+
+    auto snapshot = result.snapshot(64);
+    result.assign(pyQCD::Subset(0, 10), lattice2);
+    REQUIRE(snapshot.num_saved_blocks() == 1);
+
+    // Subsets made from a layout can only be used with lattices that have a
+    // layout of the same type and shape
+    pyQCD::EvenOddLayout even_odd_layout(std::vector<unsigned int>{8, 4, 4, 4});
+    pyQCD::LexicoLayout other_layout(std::vector<unsigned int>{8, 4, 4, 4});
+    pyQCD::Lattice<double> even_odd(even_odd_layout, 1.0);
+    auto timeslice = pyQCD::timeslice_subset(layout, 1);
+    REQUIRE(timeslice.layout() == &layout);
+    REQUIRE(timeslice.is_valid_for(&other_layout));
+    REQUIRE_THROWS(even_odd.assign(timeslice, 2.0 * even_odd));
+    REQUIRE_THROWS(pyQCD::sum(even_odd, timeslice));
+    REQUIRE_THROWS(pyQCD::reduce(even_odd, timeslice, 0.0,
+      [] (const double a, const double b) { return a + b; }));
+    REQUIRE(pyQCD::Subset(0, 10).is_valid_for(&even_odd_layout));
+    result.assign(pyQCD::timeslice_subset(other_layout, 1), lattice2);
+    REQUIRE(result[64] == 2.0);
+
+    typedef pyQCD::MatrixArray<3, 3> GaugeLinks;
+    pyQCD::Lattice<GaugeLinks> links(
+      layout, GaugeLinks(4, Eigen::Matrix3cd::Identity()));
+    links.assign(pyQCD::parity_subset(layout, 1), 2.0 * links);
+    REQUIRE(links[0][3].isApprox(Eigen::Matrix3cd::Identity()));
+    REQUIRE(links[1][3].isApprox(2.0 * Eigen::Matrix3cd::Identity()));
+  }
+
+  SECTION("Testing reductions") {
+    pyQCD::Lattice<double> lattice(layout);
+    for (unsigned int i = 0; i < lattice.size(); ++i) {
+      lattice[i] = i;
+    }
+    auto timeslice = pyQCD::timeslice_subset(layout, 0);
+    REQUIRE(pyQCD::sum(lattice, timeslice) == 63.0 * 64.0 / 2.0);
+    REQUIRE(pyQCD::sum(2.0 * lattice, pyQCD::Subset(3, 5)) == 14.0);
+    REQUIRE_THROWS(pyQCD::sum(lattice, pyQCD::Subset()));
+
+    const double max = pyQCD::reduce(lattice, pyQCD::parity_subset(layout, 0),
+      0.0, [] (const double a, const double b) { return std::max(a, b); });
+    REQUIRE(max == 511.0);
+
+    pyQCD::Lattice<Eigen::Matrix3cd> mats(layout, Eigen::Matrix3cd::Identity());
+    REQUIRE(pyQCD::sum(mats, pyQCD::Subset(0, 4)).isApprox(
+      4.0 * Eigen::Matrix3cd::Identity()));
+  }
+}
@@ -0,0 +1,100 @@
+#define CATCH_CONFIG_MAIN
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <utils/parallel.hpp>
+#include <utils/task_group.hpp>
+
+#include "helpers.hpp"
+
+
+TEST_CASE("TaskGroup test") {
+  pyQCD::set_num_threads(4);
+
+  SECTION("Testing spawn and wait") {
+    pyQCD::TaskGroup group;
+    REQUIRE(group.num_queues() == 4);
+
+    // Recursively sum 0, ..., 9999 by splitting the range in two
+    std::atomic<unsigned long> total(0);
+    std::function<void(unsigned long, unsigned long)> sum_range
+      = [&] (const unsigned long begin, const unsigned long end) {
+        if (end - begin <= 100) {
+          unsigned long partial = 0;
+          for (unsigned long i = begin; i < end; ++i) {
+            partial += i;
+          }
+          total += partial;
+          return;
+        }
+        const unsigned long mid = (begin + end) / 2;
+        group.spawn([=, &sum_range] () { sum_range(begin, mid); });
+        group.spawn([=, &sum_range] () { sum_range(mid, end); });
+      };
+    group.spawn([&] () { sum_range(0, 10000); });
+    group.wait();
+    REQUIRE(total == 49995000ul);
+
+    // The group can be reused, and exceptions are propagated
+    group.spawn([] () { throw std::runtime_error("error"); });
+    for (unsigned int i = 0; i < 100; ++i) {
+      group.spawn([] () { });
+    }
+    REQUIRE_THROWS(group.wait());
+    group.spawn([&] () { total = 0; });
+    group.wait();
+    REQUIRE(total == 0);
+  }
+
+  SECTION("Testing work stealing") {
+    // All the tasks start on one queue, so the other threads must steal them
+    pyQCD::TaskGroup group;
+    std::mutex mutex;
+    std::set<std::thread::id> ids;
+    for (unsigned int i = 0; i < 32; ++i) {
+      group.spawn(0, [&] () {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::lock_guard<std::mutex> lock(mutex);
+        ids.insert(std::this_thread::get_id());
+      });
+    }
+    group.wait();
+    REQUIRE(ids.size() > 1);
+  }
+
+  SECTION("Testing parallel_for_dynamic") {
+    const unsigned long size = 10000;
+    std::vector<std::atomic<int> > counts(size);
+    pyQCD::parallel_for_dynamic(0, size, [&] (const unsigned long i) {
+      ++counts[i];
+    }, 7);
+    for (unsigned long i = 0; i < size; ++i) {
+      REQUIRE(counts[i] == 1);
+    }
+
+    // Nested within a static loop
+    std::atomic<unsigned long> total(0);
+    pyQCD::parallel_for(0, 10, [&] (const unsigned long i) {
+      pyQCD::parallel_for_dynamic(0, 10, [&] (const unsigned long j) {
+        total += i * j;
+      });
+    });
+    REQUIRE(total == 45ul * 45ul);
+
+    REQUIRE_THROWS(pyQCD::parallel_for_dynamic(0, size,
+      [] (const unsigned long i) {
+        if (i == 5000) {
+          throw std::out_of_range("error");
+        }
+      }));
+  }
+
+  pyQCD::set_num_threads(1);
+}
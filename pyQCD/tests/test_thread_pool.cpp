@@ -0,0 +1,140 @@
+#define CATCH_CONFIG_MAIN
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <utils/parallel.hpp>
+#include <utils/thread_pool.hpp>
+
+#include "helpers.hpp"
+
+
+TEST_CASE("ThreadPool test") {
+  SECTION("Testing run") {
+    pyQCD::ThreadPool pool(4);
+    REQUIRE(pool.num_threads() == 4);
+
+    std::vector<std::atomic<int> > counts(4);
+    std::vector<std::thread::id> ids(4);
+    std::atomic<bool> in_region(true);
+    for (unsigned int trial = 0; trial < 100; ++trial) {
+      auto fn = [&] (const unsigned int thread) {
+        ++counts[thread];
+        ids[thread] = std::this_thread::get_id();
+        if (not pyQCD::ThreadPool::in_parallel_region()) {
+          in_region = false;
+        }
+      };
+      pool.run(fn);
+    }
+    for (unsigned int thread = 0; thread < 4; ++thread) {
+      REQUIRE(counts[thread] == 100);
+    }
+    REQUIRE(in_region);
+    REQUIRE(ids[0] == std::this_thread::get_id());
+    REQUIRE(ids[1] != ids[0]);
+    REQUIRE(not pyQCD::ThreadPool::in_parallel_region());
+
+    auto throwing_fn = [] (const unsigned int thread) {
+      if (thread == 2) {
+        throw std::runtime_error("error");
+      }
+    };
+    REQUIRE_THROWS(pool.run(throwing_fn));
+  }
+
+#ifdef __linux__
+  SECTION("Testing pinning") {
+    // Worker t is pinned to the t-th CPU the process is allowed to run on
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    REQUIRE(sched_getaffinity(0, sizeof(cpu_set_t), &allowed) == 0);
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &allowed)) {
+        cpus.push_back(cpu);
+      }
+    }
+
+    pyQCD::ThreadPool pool(3, true);
+    REQUIRE(pool.pinned());
+    std::vector<cpu_set_t> masks(3);
+    auto fn = [&] (const unsigned int thread) {
+      pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                             &masks[thread]);
+    };
+    pool.run(fn);
+    for (unsigned int thread = 1; thread < 3; ++thread) {
+      REQUIRE(CPU_COUNT(&masks[thread]) == 1);
+      REQUIRE(CPU_ISSET(cpus[thread % cpus.size()], &masks[thread]));
+    }
+    REQUIRE(CPU_EQUAL(&masks[0], &allowed));
+
+    REQUIRE(not pyQCD::ThreadPool(3).pinned());
+  }
+#endif
+
+  SECTION("Testing parallel_for") {
+    pyQCD::set_num_threads(4, true);
+    REQUIRE(pyQCD::num_threads() == 4);
+
+    const unsigned long size = 10000;
+    std::vector<std::atomic<int> > counts(size);
+    std::vector<std::thread::id> first_ids(size), second_ids(size);
+    pyQCD::parallel_for(0, size, [&] (const unsigned long i) {
+      ++counts[i];
+      first_ids[i] = std::this_thread::get_id();
+    });
+    pyQCD::parallel_for(0, size, [&] (const unsigned long i) {
+      ++counts[i];
+      second_ids[i] = std::this_thread::get_id();
+    });
+    for (unsigned long i = 0; i < size; ++i) {
+      REQUIRE(counts[i] == 2);
+      // The partition is the same each time
+      REQUIRE(first_ids[i] == second_ids[i]);
+    }
+
+    // Nested loops run on the thread that starts them
+    std::atomic<unsigned long> total(0);
+    pyQCD::parallel_for(0, 100, [&] (const unsigned long i) {
+      pyQCD::parallel_for(0, 100, [&] (const unsigned long j) {
+        total += i * j;
+      });
+    });
+    REQUIRE(total == 4950ul * 4950ul);
+
+    REQUIRE_THROWS(pyQCD::parallel_for(0, size,
+      [] (const unsigned long i) {
+        if (i == 7000) {
+          throw std::out_of_range("error");
+        }
+      }));
+
+    // Loops can be started from several threads at once
+    std::vector<unsigned long> results(4, 0);
+    std::vector<std::thread> callers;
+    for (unsigned int c = 0; c < 4; ++c) {
+      callers.emplace_back([&, c] () {
+        for (unsigned int trial = 0; trial < 20; ++trial) {
+          std::atomic<unsigned long> sum(0);
+          pyQCD::parallel_for(0, 1000, [&] (const unsigned long i) {
+            sum += i * (c + 1);
+          });
+          results[c] += sum;
+        }
+      });
+    }
+    for (auto& caller : callers) {
+      caller.join();
+    }
+    for (unsigned int c = 0; c < 4; ++c) {
+      REQUIRE(results[c] == 20ul * 499500ul * (c + 1));
+    }
+
+    pyQCD::set_num_threads(1);
+    REQUIRE(pyQCD::num_threads() == 1);
+  }
+}
@@ -2,22 +2,33 @@
 
 - Functions to generate Cython code a specific number of colours, representation
 etc.
+- A command line entry point that renders the small-matrix kernels
+(templates/core/kernels.hpp) for a given set of matrix shapes, which the CMake
+build uses to compile and test them.
 """
 
 from __future__ import absolute_import, print_function
 
+import argparse
 import os
 from collections import namedtuple
 from itertools import product
 import shutil
-from string import lowercase
+try:
+    from string import lowercase
+except ImportError:
+    from string import ascii_lowercase as lowercase
 
-from jinja2 import Environment, PackageLoader
+from jinja2 import Environment, FileSystemLoader
 import setuptools
 
 
-# Create the jinja2 template environment.
-env = Environment(loader=PackageLoader('pyQCD', 'templates'),
+# Create the jinja2 template environment. The templates are loaded from the
+# source tree rather than the installed package, so that this module can be
+# run as a script before the package has been built.
+template_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                            "..", "templates")
+env = Environment(loader=FileSystemLoader(template_dir),
                   trim_blocks=True, lstrip_blocks=True)
 
 MatrixDefinition = namedtuple("MatrixDefinition",
@@ -221,6 +232,8 @@ def generate_cython_types(output_path, precision, matrices):
 
     write_core_template("types.hpp", "types.hpp", output_path,
                         matrixdefs=matrices, precision=precision)
+    write_core_template("kernels.hpp", "kernels.hpp", output_path,
+                        matrixdefs=matrices, precision=precision)
     write_core_template("complex.pxd", "complex.pxd", output_path,
                         precision=precision)
     write_core_template("operators.pxd", "operators.pxd", output_path,
@@ -270,6 +283,26 @@ def generate_qcd(num_colours, precision, representation, dest=None):
                           matrix_definitions)
 
 
+def generate_kernels(output_path, precision, shapes):
+    """Render the small-matrix kernels for the specified matrix shapes.
+
+    Args:
+      output_path (str): The directory in which to put kernels.hpp.
+      precision (str): The fundamental machine type to be used in the kernels
+        (e.g. 'double' or 'float').
+      shapes (iterable): An iterable of (num_rows, num_cols) pairs.
+    """
+
+    matrix_definitions = [
+        create_matrix_definition(num_rows, num_cols,
+                                 "Matrix{}x{}".format(num_rows, num_cols))
+        for num_rows, num_cols in shapes]
+    if not os.path.isdir(output_path):
+        os.makedirs(output_path)
+    write_core_template("kernels.hpp", "kernels.hpp", output_path,
+                        matrixdefs=matrix_definitions, precision=precision)
+
+
 class CodeGen(setuptools.Command):
 
     description = "Generate Cython code."
@@ -295,4 +328,28 @@ class CodeGen(setuptools.Command):
         generate_qcd(self.num_colours, self.precision, self.representation)
 
 
-env.filters['to_underscores'] = _camel2underscores
\ No newline at end of file
+env.filters['to_underscores'] = _camel2underscores
+
+
+def _parse_shape(string):
+    """Converts a string of the form RxC to a (num_rows, num_cols) tuple"""
+    try:
+        num_rows, num_cols = (int(n) for n in string.split("x"))
+    except ValueError:
+        raise argparse.ArgumentTypeError(
+            "Invalid matrix shape: {}".format(string))
+    return num_rows, num_cols
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description="Render the small-matrix kernels for the given shapes.")
+    parser.add_argument("output_path",
+                        help="Directory in which to write kernels.hpp")
+    parser.add_argument("shapes", nargs="+", type=_parse_shape,
+                        help="Matrix shapes, e.g. 3x3 3x1")
+    parser.add_argument("-p", "--precision", default="double",
+                        help="Fundamental type for real numbers "
+                             "(defaults to double)")
+    args = parser.parse_args()
+    generate_kernels(args.output_path, args.precision, args.shapes)
\ No newline at end of file
@@ -0,0 +1,164 @@
+#ifndef CPU_DISPATCH_HPP
+#define CPU_DISPATCH_HPP
+
+/* This file provides runtime selection of the instruction set used by the hot
+ * loops of the library, so that a single build runs at full speed on both
+ * AVX2 and AVX-512 machines.
+ *
+ * dispatch(fn) calls fn through one of several trampolines, each of which is
+ * compiled for a different instruction set (AVX-512, AVX2 + FMA or the
+ * baseline the library was built for) and flattened, i.e. everything fn calls
+ * is inlined into it and compiled for that instruction set too. The
+ * trampoline used is the best one the CPU supports, detected on first use.
+ * Anything that can't be inlined (e.g. calls through function pointers) runs
+ * the baseline code, so nothing built for a newer instruction set leaks into
+ * code shared with the other variants.
+ *
+ * Loops are dispatched as a whole, not per element: the evaluation of Array
+ * and Lattice expressions, the chunks of parallel_for (and hence stencils,
+ * reductions and fused evaluation), the staggered hopping term and SU(3)
+ * matrix functions. The trampolines only widen what the compiler
+ * auto-vectorises itself, however: Eigen chooses its packet size from the
+ * flags the whole build is compiled with, so Eigen code inlined into them
+ * keeps using the baseline (e.g. SSE2) packets. The hottest products are
+ * therefore also built as separate translation units with -mavx2 -mfma and
+ * -mavx512f, and selected with the same level (see simd_kernels.hpp).
+ *
+ * The instruction set can be capped with the environment variable PYQCD_SIMD
+ * (one of "generic", "avx2" or "avx512"), e.g. to compare the variants.
+ * Dispatch is only available with GCC-compatible compilers on x86. It can be
+ * disabled by defining PYQCD_DISABLE_DISPATCH (see the PYQCD_SIMD_DISPATCH
+ * CMake option), in which case dispatch(fn) simply calls fn.
+ */
+
+#include <cstdlib>
+#include <cstring>
+
+#if not defined(PYQCD_DISABLE_DISPATCH) and defined(__GNUC__) \
+  and (defined(__x86_64__) or defined(__i386__))
+#define PYQCD_DISPATCH_ENABLED
+#endif
+
+
+namespace pyQCD
+{
+  enum class SimdLevel { generic = 0, avx2 = 1, avx512 = 2 };
+
+
+  inline const char* simd_level_name(const SimdLevel level)
+  {
+    switch (level) {
+    case SimdLevel::avx512:
+      return "avx512";
+    case SimdLevel::avx2:
+      return "avx2";
+    default:
+      return "generic";
+    }
+  }
+
+
+  inline SimdLevel detected_simd_level()
+  {
+    // The best instruction set supported by both the CPU and the compiler
+#ifdef PYQCD_DISPATCH_ENABLED
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") and __builtin_cpu_supports("avx512dq")
+        and __builtin_cpu_supports("avx512vl")
+        and __builtin_cpu_supports("avx512bw")) {
+      return SimdLevel::avx512;
+    }
+    if (__builtin_cpu_supports("avx2") and __builtin_cpu_supports("fma")) {
+      return SimdLevel::avx2;
+    }
+#endif
+    return SimdLevel::generic;
+  }
+
+
+  namespace detail
+  {
+    inline SimdLevel requested_simd_level()
+    {
+      const char* value = std::getenv("PYQCD_SIMD");
+      if (value == nullptr) {
+        return SimdLevel::avx512;
+      }
+      if (std::strcmp(value, "generic") == 0) {
+        return SimdLevel::generic;
+      }
+      if (std::strcmp(value, "avx2") == 0) {
+        return SimdLevel::avx2;
+      }
+      return SimdLevel::avx512;
+    }
+
+
+    inline SimdLevel min_simd_level(const SimdLevel a, const SimdLevel b)
+    { return static_cast<int>(a) < static_cast<int>(b) ? a : b; }
+
+
+#ifdef PYQCD_DISPATCH_ENABLED
+    template <typename Fn>
+    __attribute__((target("avx2,fma"), flatten))
+    void call_avx2(Fn& fn) { fn(); }
+
+
+    template <typename Fn>
+    __attribute__((target("avx512f,avx512dq,avx512vl,avx512bw,avx2,fma"),
+                   flatten))
+    void call_avx512(Fn& fn) { fn(); }
+#endif
+  }
+
+
+  inline SimdLevel simd_level()
+  {
+    // The instruction set used by dispatch
+    static const SimdLevel ret = detail::min_simd_level(
+      detected_simd_level(), detail::requested_simd_level());
+    return ret;
+  }
+
+
+  template <typename Fn>
+  void dispatch(const SimdLevel level, Fn&& fn)
+  {
+    // Call fn using the specified instruction set, or the best one supported
+    // if that's lower
+#ifdef PYQCD_DISPATCH_ENABLED
+    switch (detail::min_simd_level(level, detected_simd_level())) {
+    case SimdLevel::avx512:
+      detail::call_avx512(fn);
+      return;
+    case SimdLevel::avx2:
+      detail::call_avx2(fn);
+      return;
+    default:
+      break;
+    }
+#endif
+    fn();
+  }
+
+
+  template <typename Fn>
+  void dispatch(Fn&& fn)
+  {
+#ifdef PYQCD_DISPATCH_ENABLED
+    switch (simd_level()) {
+    case SimdLevel::avx512:
+      detail::call_avx512(fn);
+      return;
+    case SimdLevel::avx2:
+      detail::call_avx2(fn);
+      return;
+    default:
+      break;
+    }
+#endif
+    fn();
+  }
+}
+
+#endif
@@ -0,0 +1,68 @@
+#include <stdexcept>
+
+#include <utils/matrices.hpp>
+
+/* Implementation of functions in matrices.hpp */
+
+namespace pyQCD
+{
+  namespace
+  {
+    SpinMatrix make_gamma(const int mu)
+    {
+      // Euclidean gamma matrices in the chiral basis:
+      //   gamma_t = ((0, 1), (1, 0)),
+      //   gamma_k = ((0, -i sigma_k), (i sigma_k, 0))
+      const std::complex<double> I(0.0, 1.0);
+      Eigen::Matrix2cd pauli = Eigen::Matrix2cd::Zero();
+      switch (mu) {
+      case 0:
+        pauli = Eigen::Matrix2cd::Identity();
+        break;
+      case 1:
+        pauli << 0.0, 1.0, 1.0, 0.0;
+        pauli *= -I;
+        break;
+      case 2:
+        pauli << 0.0, -I, I, 0.0;
+        pauli *= -I;
+        break;
+      case 3:
+        pauli << 1.0, 0.0, 0.0, -1.0;
+        pauli *= -I;
+        break;
+      default:
+        throw std::out_of_range("gamma: mu must be in the range [0, 4)");
+      }
+      SpinMatrix ret = SpinMatrix::Zero();
+      ret.block<2, 2>(0, 2) = pauli;
+      ret.block<2, 2>(2, 0) = pauli.adjoint();
+      return ret;
+    }
+  }
+
+
+  const SpinMatrix& gamma(const int mu)
+  {
+    static const SpinMatrix gammas[4]
+      = {make_gamma(0), make_gamma(1), make_gamma(2), make_gamma(3)};
+    if (mu < 0 or mu > 3) {
+      throw std::out_of_range("gamma: mu must be in the range [0, 4)");
+    }
+    return gammas[mu];
+  }
+
+
+  const SpinMatrix& gamma5()
+  {
+    static const SpinMatrix ret = gamma(1) * gamma(2) * gamma(3) * gamma(0);
+    return ret;
+  }
+
+
+  SpinMatrix sigma(const int mu, const int nu)
+  {
+    const std::complex<double> I(0.0, 1.0);
+    return 0.5 * I * (gamma(mu) * gamma(nu) - gamma(nu) * gamma(mu));
+  }
+}
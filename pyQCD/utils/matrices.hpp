@@ -0,0 +1,28 @@
+#ifndef MATRICES_HPP
+#define MATRICES_HPP
+
+/* This file provides the Dirac gamma matrices and related spin matrices. The
+ * chiral basis is used throughout, so gamma5 is diagonal and the upper and
+ * lower two spin components have definite chirality.
+ *
+ * The gamma matrix indices follow the lattice dimension ordering used in
+ * Layout, i.e. mu = 0 is the time direction and mu = 1, 2, 3 are the spatial
+ * directions.
+ */
+
+#include <complex>
+
+#include <Eigen/Dense>
+
+
+namespace pyQCD
+{
+  typedef Eigen::Matrix<std::complex<double>, 4, 4> SpinMatrix;
+
+  const SpinMatrix& gamma(const int mu);
+  const SpinMatrix& gamma5();
+  // sigma_{mu nu} = i / 2 [gamma_mu, gamma_nu]
+  SpinMatrix sigma(const int mu, const int nu);
+}
+
+#endif
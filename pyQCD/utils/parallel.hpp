@@ -0,0 +1,50 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+/* This file provides utilities for running loops over lattice sites in
+ * parallel.
+ *
+ * parallel_for divides a range of indices into contiguous chunks, one per
+ * thread of the library's thread pool (see thread_pool.hpp), and calls the
+ * supplied function for each index. The partition is static: a given range is
+ * always divided in the same way, and chunk t always runs on thread t of the
+ * pool. Loops that are too short to benefit from threading (fewer than grain
+ * indices per thread) are run on the calling thread. Any exception thrown by
+ * the function is rethrown on the calling thread once all chunks have
+ * finished. Each chunk is run through dispatch (see cpu_dispatch.hpp), so the
+ * loop body is compiled for the best instruction set the CPU supports.
+ */
+
+#include <algorithm>
+
+#include "cpu_dispatch.hpp"
+#include "thread_pool.hpp"
+
+
+namespace pyQCD
+{
+  template <typename Fn>
+  void parallel_for(const unsigned long begin, const unsigned long end, Fn fn,
+                    const unsigned long grain = 1)
+  {
+    if (begin >= end) {
+      return;
+    }
+    const unsigned long size = end - begin;
+    const unsigned long max_chunks = size / std::max(grain, 1ul);
+
+    run_on_thread_pool(
+      [&] (const unsigned int chunk, const unsigned int num_chunks) {
+        const unsigned long chunk_begin = begin + size * chunk / num_chunks;
+        const unsigned long chunk_end
+          = begin + size * (chunk + 1) / num_chunks;
+        dispatch([&] () {
+          for (unsigned long i = chunk_begin; i < chunk_end; ++i) {
+            fn(i);
+          }
+        });
+      }, std::min<unsigned long>(max_chunks, ~0u));
+  }
+}
+
+#endif
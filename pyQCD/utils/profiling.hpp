@@ -0,0 +1,214 @@
+#ifndef PROFILING_HPP
+#define PROFILING_HPP
+
+/* This file provides optional instrumentation of the library's kernels, to
+ * show where the time of a run goes (expression evaluation, layout
+ * conversion, reductions, fermion operators and so on).
+ *
+ * Kernels are instrumented with
+ *
+ *   PYQCD_PROFILE_SCOPE("name");
+ *   PYQCD_PROFILE_SCOPE_COST("name", flops, bytes);
+ *
+ * which time the rest of the enclosing scope and add the time, one call and
+ * (for the second form) the given flops and bytes to the counters of the
+ * named kernel. The counters are atomic, so kernels may be timed on several
+ * threads at once. Each call site looks its counters up once, so a timed call
+ * costs two clock reads and a few atomic additions. Times are inclusive:
+ * a kernel that calls another is also charged for the other's time.
+ *
+ * Instrumentation is compiled in only when PYQCD_ENABLE_PROFILING is defined
+ * (see the PYQCD_PROFILING CMake option). Otherwise the macros expand to
+ * nothing and their arguments aren't evaluated. The totals are available from
+ * profile_stats() and profile_report() (also exposed to Python), and are
+ * cleared by reset_profile().
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+namespace pyQCD
+{
+  struct KernelStats
+  {
+    std::string name;
+    unsigned long calls;
+    double seconds;
+    unsigned long flops, bytes;
+  };
+
+
+  namespace detail
+  {
+    struct KernelCounters
+    {
+      KernelCounters() : calls(0), nanoseconds(0), flops(0), bytes(0) { }
+
+      std::atomic<unsigned long> calls, nanoseconds, flops, bytes;
+    };
+
+
+    struct ProfileRegistry
+    {
+      std::mutex mutex;
+      // Elements of a std::map are never moved, so the references held by
+      // the call sites remain valid
+      std::map<std::string, KernelCounters> counters;
+    };
+
+
+    inline ProfileRegistry& profile_registry()
+    {
+      static ProfileRegistry ret;
+      return ret;
+    }
+
+
+    inline KernelCounters& kernel_counters(const std::string& name)
+    {
+      ProfileRegistry& registry = profile_registry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      return registry.counters[name];
+    }
+
+
+    class ScopedKernelTimer
+    {
+    public:
+      typedef std::chrono::steady_clock Clock;
+
+      ScopedKernelTimer(KernelCounters& counters, const unsigned long flops,
+                        const unsigned long bytes)
+        : counters_(counters), flops_(flops), bytes_(bytes),
+          start_(Clock::now())
+      { }
+      ScopedKernelTimer(const ScopedKernelTimer&) = delete;
+      ScopedKernelTimer& operator=(const ScopedKernelTimer&) = delete;
+
+      ~ScopedKernelTimer()
+      {
+        const auto elapsed = std::chrono::duration_cast<
+          std::chrono::nanoseconds>(Clock::now() - start_).count();
+        counters_.calls.fetch_add(1, std::memory_order_relaxed);
+        counters_.nanoseconds.fetch_add(elapsed, std::memory_order_relaxed);
+        counters_.flops.fetch_add(flops_, std::memory_order_relaxed);
+        counters_.bytes.fetch_add(bytes_, std::memory_order_relaxed);
+      }
+
+    private:
+      KernelCounters& counters_;
+      unsigned long flops_, bytes_;
+      Clock::time_point start_;
+    };
+  }
+
+
+  constexpr bool profiling_enabled()
+  {
+#ifdef PYQCD_ENABLE_PROFILING
+    return true;
+#else
+    return false;
+#endif
+  }
+
+
+  inline std::vector<KernelStats> profile_stats()
+  {
+    // The totals of each kernel that has been called, most expensive first
+    detail::ProfileRegistry& registry = detail::profile_registry();
+    std::vector<KernelStats> ret;
+    {
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      for (auto& entry : registry.counters) {
+        const detail::KernelCounters& counters = entry.second;
+        if (counters.calls.load() == 0) {
+          continue;
+        }
+        ret.push_back(KernelStats{entry.first, counters.calls.load(),
+                                  counters.nanoseconds.load() * 1.0e-9,
+                                  counters.flops.load(),
+                                  counters.bytes.load()});
+      }
+    }
+    std::stable_sort(ret.begin(), ret.end(),
+      [] (const KernelStats& a, const KernelStats& b) {
+        return a.seconds > b.seconds;
+      });
+    return ret;
+  }
+
+
+  inline void reset_profile()
+  {
+    // Counters are zeroed rather than removed, as call sites refer to them
+    detail::ProfileRegistry& registry = detail::profile_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto& entry : registry.counters) {
+      entry.second.calls = 0;
+      entry.second.nanoseconds = 0;
+      entry.second.flops = 0;
+      entry.second.bytes = 0;
+    }
+  }
+
+
+  inline std::string profile_report()
+  {
+    // A table of the totals of each kernel, most expensive first
+    std::ostringstream ss;
+    if (not profiling_enabled()) {
+      ss << "Profiling is disabled (compile with PYQCD_ENABLE_PROFILING)\n";
+      return ss.str();
+    }
+    ss << std::left << std::setw(32) << "kernel" << std::right
+       << std::setw(10) << "calls" << std::setw(12) << "time (s)"
+       << std::setw(14) << "per call (us)" << std::setw(10) << "Gflop/s"
+       << std::setw(10) << "GB/s" << "\n";
+    ss << std::fixed;
+    for (auto& stats : profile_stats()) {
+      const double seconds = std::max(stats.seconds, 1.0e-12);
+      ss << std::left << std::setw(32) << stats.name << std::right
+         << std::setw(10) << stats.calls
+         << std::setw(12) << std::setprecision(4) << stats.seconds
+         << std::setw(14) << std::setprecision(2)
+         << 1.0e6 * stats.seconds / stats.calls
+         << std::setw(10) << stats.flops / seconds / 1.0e9
+         << std::setw(10) << stats.bytes / seconds / 1.0e9 << "\n";
+    }
+    return ss.str();
+  }
+}
+
+
+#ifdef PYQCD_ENABLE_PROFILING
+
+#define PYQCD_PROFILE_CONCAT_IMPL(a, b) a ## b
+#define PYQCD_PROFILE_CONCAT(a, b) PYQCD_PROFILE_CONCAT_IMPL(a, b)
+
+#define PYQCD_PROFILE_SCOPE_COST(name, flops, bytes)                       \
+  static pyQCD::detail::KernelCounters&                                    \
+    PYQCD_PROFILE_CONCAT(pyqcd_profile_counters_, __LINE__)                \
+    = pyQCD::detail::kernel_counters(name);                                \
+  const pyQCD::detail::ScopedKernelTimer                                   \
+    PYQCD_PROFILE_CONCAT(pyqcd_profile_timer_, __LINE__)(                  \
+      PYQCD_PROFILE_CONCAT(pyqcd_profile_counters_, __LINE__),             \
+      flops, bytes)
+
+#else
+
+#define PYQCD_PROFILE_SCOPE_COST(name, flops, bytes) static_cast<void>(0)
+
+#endif
+
+#define PYQCD_PROFILE_SCOPE(name) PYQCD_PROFILE_SCOPE_COST(name, 0, 0)
+
+#endif
@@ -0,0 +1,34 @@
+#include <utils/simd_kernels.hpp>
+
+/* Implementation of the kernel selection in simd_kernels.hpp. The kernels
+ * themselves are in simd_kernels_impl.hpp. */
+
+namespace pyQCD
+{
+  const simd::Kernels& simd_kernels(const SimdLevel level)
+  {
+    static const simd::Kernels generic = {
+      &simd::generic::multiply_3x3, &simd::generic::multiply_adjoint_3x3,
+      &simd::generic::multiply_3x3_3x1, SimdLevel::generic};
+#if defined(PYQCD_SIMD_KERNEL_VARIANTS) and defined(PYQCD_DISPATCH_ENABLED)
+    static const simd::Kernels avx2 = {
+      &simd::avx2::multiply_3x3, &simd::avx2::multiply_adjoint_3x3,
+      &simd::avx2::multiply_3x3_3x1, SimdLevel::avx2};
+    static const simd::Kernels avx512 = {
+      &simd::avx512::multiply_3x3, &simd::avx512::multiply_adjoint_3x3,
+      &simd::avx512::multiply_3x3_3x1, SimdLevel::avx512};
+
+    switch (detail::min_simd_level(level, detected_simd_level())) {
+    case SimdLevel::avx512:
+      return avx512;
+    case SimdLevel::avx2:
+      return avx2;
+    default:
+      break;
+    }
+#else
+    (void) level;
+#endif
+    return generic;
+  }
+}
@@ -0,0 +1,78 @@
+#ifndef SIMD_KERNELS_HPP
+#define SIMD_KERNELS_HPP
+
+/* This file provides batched versions of the hottest small-matrix kernels,
+ * which apply the same operation to n consecutive matrices at a time. Each
+ * kernel is compiled in its own translation unit for each instruction set
+ * that dispatch supports (see cpu_dispatch.hpp), with the matching compiler
+ * flags (-mavx2 -mfma and -mavx512f etc.), rather than relying on the target
+ * attributes of the dispatch trampolines. Eigen chooses its packet size from
+ * the compiler flags, so code inlined into the trampolines still uses SSE2.
+ *
+ * The variants live in the namespaces simd::generic, simd::avx2 and
+ * simd::avx512 and are defined in utils/simd_kernels_*.cpp, so they never
+ * share a symbol. simd_kernels() returns the variant matching simd_level().
+ * The AVX variants are only built on x86 when the compiler accepts the flags
+ * (the PYQCD_SIMD_KERNEL_VARIANTS definition); otherwise every level gets the
+ * generic kernels.
+ *
+ * The matrices are stored as Eigen stores Eigen::Matrix<std::complex<double>,
+ * R, C>, i.e. column-major with interleaved real and imaginary parts, and are
+ * passed as arrays of doubles. Each output matrix may be the same as one of
+ * its inputs.
+ */
+
+#include "cpu_dispatch.hpp"
+
+
+namespace pyQCD
+{
+  namespace simd
+  {
+    typedef void (*BatchKernel)(const double*, const double*, double*,
+                                const unsigned long);
+
+    struct Kernels
+    {
+      // out[m] = lhs[m] * rhs[m] for 3x3 matrices
+      BatchKernel multiply_3x3;
+      // out[m] = lhs[m] * rhs[m]^dag for 3x3 matrices
+      BatchKernel multiply_adjoint_3x3;
+      // out[m] = lhs[m] * rhs[m] for 3x3 matrices and 3-component vectors
+      BatchKernel multiply_3x3_3x1;
+      // The instruction set the kernels were compiled for
+      SimdLevel level;
+    };
+
+#define PYQCD_DECLARE_SIMD_KERNELS(isa)                                 \
+    namespace isa                                                       \
+    {                                                                   \
+      void multiply_3x3(const double* lhs, const double* rhs,           \
+                        double* out, const unsigned long n);            \
+      void multiply_adjoint_3x3(const double* lhs, const double* rhs,   \
+                                double* out, const unsigned long n);    \
+      void multiply_3x3_3x1(const double* lhs, const double* rhs,       \
+                            double* out, const unsigned long n);        \
+      int compiled_simd_level();                                        \
+    }
+
+    PYQCD_DECLARE_SIMD_KERNELS(generic)
+#ifdef PYQCD_SIMD_KERNEL_VARIANTS
+    PYQCD_DECLARE_SIMD_KERNELS(avx2)
+    PYQCD_DECLARE_SIMD_KERNELS(avx512)
+#endif
+
+#undef PYQCD_DECLARE_SIMD_KERNELS
+  }
+
+
+  // The kernels for the specified instruction set, or the best one supported
+  // by the CPU and the build if that's lower
+  const simd::Kernels& simd_kernels(const SimdLevel level);
+
+
+  inline const simd::Kernels& simd_kernels()
+  { return simd_kernels(simd_level()); }
+}
+
+#endif
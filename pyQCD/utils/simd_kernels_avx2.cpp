@@ -0,0 +1,9 @@
+/* The batched kernels in simd_kernels.hpp, compiled for AVX2 + FMA. The build
+ * compiles this file with -mavx2 -mfma. */
+
+#if not defined(__AVX2__) or not defined(__FMA__)
+#error "simd_kernels_avx2.cpp must be compiled with -mavx2 -mfma"
+#endif
+
+#define PYQCD_SIMD_NAMESPACE avx2
+#include "simd_kernels_impl.hpp"
@@ -0,0 +1,10 @@
+/* The batched kernels in simd_kernels.hpp, compiled for AVX-512. The build
+ * compiles this file with -mavx512f and the other extensions checked for by
+ * detected_simd_level(). */
+
+#ifndef __AVX512F__
+#error "simd_kernels_avx512.cpp must be compiled with -mavx512f"
+#endif
+
+#define PYQCD_SIMD_NAMESPACE avx512
+#include "simd_kernels_impl.hpp"
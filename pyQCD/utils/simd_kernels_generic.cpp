@@ -0,0 +1,5 @@
+/* The batched kernels in simd_kernels.hpp, compiled for the baseline
+ * instruction set of the build. */
+
+#define PYQCD_SIMD_NAMESPACE generic
+#include "simd_kernels_impl.hpp"
@@ -0,0 +1,211 @@
+/* Implementation of the batched kernels declared in simd_kernels.hpp. This
+ * file is compiled once for each instruction set by the simd_kernels_*.cpp
+ * files, each of which defines PYQCD_SIMD_NAMESPACE before including it.
+ *
+ * Everything here is defined in that namespace, within an anonymous namespace
+ * where possible, and only the intrinsics headers are included, so no inline
+ * function or template instantiation is shared between the variants.
+ * Otherwise the linker would keep only one copy of it, which could then be
+ * code for an instruction set the CPU doesn't have.
+ *
+ * The matrices are column-major with interleaved real and imaginary parts,
+ * which is how Eigen stores them. A column of the result is accumulated as a
+ * sum of columns of the left-hand factor scaled by complex numbers. With
+ * AVX-512 a column of three complex numbers fits in one (masked) register;
+ * with AVX2 it takes one 256-bit and one 128-bit register. For each element
+ * (x + iy) of the right-hand factor, x times the column and y times the column
+ * with its real and imaginary parts swapped are accumulated separately, and
+ * the two sums are combined with the signs of the complex product at the end.
+ */
+
+#ifndef PYQCD_SIMD_NAMESPACE
+#error "PYQCD_SIMD_NAMESPACE must be defined before including this file"
+#endif
+
+#if defined(__AVX512F__) or (defined(__AVX2__) and defined(__FMA__))
+#include <immintrin.h>
+#endif
+
+
+namespace pyQCD
+{
+  namespace simd
+  {
+    namespace PYQCD_SIMD_NAMESPACE
+    {
+      namespace
+      {
+        // out = lhs * rhs if not Adjoint, otherwise out = lhs * rhs^dag, where
+        // lhs is Rows x Inner and out is Rows x Cols. The result is formed
+        // before any of it is stored, so out may be one of the operands.
+        template <int Rows, int Inner, int Cols, bool Adjoint>
+        struct Multiply
+        {
+          static void apply(const double* lhs, const double* rhs, double* out)
+          {
+            // lhs multiplied by i, so that lhs * (x + iy) = x lhs + y (i lhs)
+            double lhs_i[2 * Rows * Inner];
+            for (int e = 0; e < Rows * Inner; ++e) {
+              lhs_i[2 * e] = -lhs[2 * e + 1];
+              lhs_i[2 * e + 1] = lhs[2 * e];
+            }
+
+            double result[2 * Rows * Cols];
+            for (int j = 0; j < Cols; ++j) {
+              double* column = result + 2 * Rows * j;
+              for (int i = 0; i < 2 * Rows; ++i) {
+                column[i] = 0.0;
+              }
+              for (int k = 0; k < Inner; ++k) {
+                // rhs(k, j), or conj(rhs(j, k)) for the adjoint
+                const int index = Adjoint ? Cols * k + j : Inner * j + k;
+                const double re = rhs[2 * index];
+                const double im = Adjoint ? -rhs[2 * index + 1]
+                                          : rhs[2 * index + 1];
+                const double* lhs_column = lhs + 2 * Rows * k;
+                const double* lhs_i_column = lhs_i + 2 * Rows * k;
+                for (int i = 0; i < 2 * Rows; ++i) {
+                  column[i] += re * lhs_column[i] + im * lhs_i_column[i];
+                }
+              }
+            }
+            for (int i = 0; i < 2 * Rows * Cols; ++i) {
+              out[i] = result[i];
+            }
+          }
+        };
+
+
+#if defined(__AVX512F__)
+        template <int Inner, int Cols, bool Adjoint>
+        struct Multiply<3, Inner, Cols, Adjoint>
+        {
+          static void apply(const double* lhs, const double* rhs, double* out)
+          {
+            // Lanes 0-5 hold a column; the swap exchanges the real and
+            // imaginary parts of each element
+            const __mmask8 mask = 0x3f;
+            __m512d columns[Inner], swapped[Inner];
+            for (int k = 0; k < Inner; ++k) {
+              columns[k] = _mm512_maskz_loadu_pd(mask, lhs + 6 * k);
+              swapped[k] = _mm512_permute_pd(columns[k], 0x55);
+            }
+
+            __m512d result[Cols];
+            const __m512d one = _mm512_set1_pd(1.0);
+            for (int j = 0; j < Cols; ++j) {
+              __m512d re_sum = _mm512_setzero_pd();
+              __m512d im_sum = _mm512_setzero_pd();
+              for (int k = 0; k < Inner; ++k) {
+                const int index = Adjoint ? Cols * k + j : Inner * j + k;
+                re_sum = _mm512_fmadd_pd(
+                  columns[k], _mm512_set1_pd(rhs[2 * index]), re_sum);
+                im_sum = _mm512_fmadd_pd(
+                  swapped[k], _mm512_set1_pd(rhs[2 * index + 1]), im_sum);
+              }
+              // Subtract im_sum from the real parts and add it to the
+              // imaginary parts, or the reverse for the conjugate
+              result[j] = Adjoint ? _mm512_fmsubadd_pd(re_sum, one, im_sum)
+                                  : _mm512_fmaddsub_pd(re_sum, one, im_sum);
+            }
+            for (int j = 0; j < Cols; ++j) {
+              _mm512_mask_storeu_pd(out + 6 * j, mask, result[j]);
+            }
+          }
+        };
+#elif defined(__AVX2__) and defined(__FMA__)
+        template <int Inner, int Cols, bool Adjoint>
+        struct Multiply<3, Inner, Cols, Adjoint>
+        {
+          static void apply(const double* lhs, const double* rhs, double* out)
+          {
+            // Rows 0 and 1 of a column are held in a 256-bit register and
+            // row 2 in a 128-bit one, otherwise as the AVX-512 version
+            __m256d upper[Inner], upper_swapped[Inner];
+            __m128d lower[Inner], lower_swapped[Inner];
+            for (int k = 0; k < Inner; ++k) {
+              upper[k] = _mm256_loadu_pd(lhs + 6 * k);
+              upper_swapped[k] = _mm256_permute_pd(upper[k], 0x5);
+              lower[k] = _mm_loadu_pd(lhs + 6 * k + 4);
+              lower_swapped[k] = _mm_shuffle_pd(lower[k], lower[k], 0x1);
+            }
+
+            __m256d upper_result[Cols];
+            __m128d lower_result[Cols];
+            const __m256d one = _mm256_set1_pd(1.0);
+            const __m128d lower_one = _mm_set1_pd(1.0);
+            for (int j = 0; j < Cols; ++j) {
+              __m256d upper_re = _mm256_setzero_pd();
+              __m256d upper_im = _mm256_setzero_pd();
+              __m128d lower_re = _mm_setzero_pd();
+              __m128d lower_im = _mm_setzero_pd();
+              for (int k = 0; k < Inner; ++k) {
+                const int index = Adjoint ? Cols * k + j : Inner * j + k;
+                const __m256d re = _mm256_broadcast_sd(rhs + 2 * index);
+                const __m256d im = _mm256_broadcast_sd(rhs + 2 * index + 1);
+                upper_re = _mm256_fmadd_pd(upper[k], re, upper_re);
+                upper_im = _mm256_fmadd_pd(upper_swapped[k], im, upper_im);
+                lower_re = _mm_fmadd_pd(lower[k], _mm256_castpd256_pd128(re),
+                                        lower_re);
+                lower_im = _mm_fmadd_pd(lower_swapped[k],
+                                        _mm256_castpd256_pd128(im), lower_im);
+              }
+              upper_result[j]
+                = Adjoint ? _mm256_fmsubadd_pd(upper_re, one, upper_im)
+                          : _mm256_fmaddsub_pd(upper_re, one, upper_im);
+              lower_result[j]
+                = Adjoint ? _mm_fmsubadd_pd(lower_re, lower_one, lower_im)
+                          : _mm_fmaddsub_pd(lower_re, lower_one, lower_im);
+            }
+            for (int j = 0; j < Cols; ++j) {
+              _mm256_storeu_pd(out + 6 * j, upper_result[j]);
+              _mm_storeu_pd(out + 6 * j + 4, lower_result[j]);
+            }
+          }
+        };
+#endif
+
+
+        template <int Rows, int Inner, int Cols, bool Adjoint>
+        void multiply_batch(const double* lhs, const double* rhs,
+                            double* out, const unsigned long n)
+        {
+          const int lhs_size = 2 * Rows * Inner;
+          const int rhs_size = 2 * Inner * Cols;
+          const int out_size = 2 * Rows * Cols;
+          for (unsigned long m = 0; m < n; ++m) {
+            Multiply<Rows, Inner, Cols, Adjoint>::apply(
+              lhs + m * lhs_size, rhs + m * rhs_size, out + m * out_size);
+          }
+        }
+      }
+
+
+      void multiply_3x3(const double* lhs, const double* rhs, double* out,
+                        const unsigned long n)
+      { multiply_batch<3, 3, 3, false>(lhs, rhs, out, n); }
+
+
+      void multiply_adjoint_3x3(const double* lhs, const double* rhs,
+                                double* out, const unsigned long n)
+      { multiply_batch<3, 3, 3, true>(lhs, rhs, out, n); }
+
+
+      void multiply_3x3_3x1(const double* lhs, const double* rhs,
+                            double* out, const unsigned long n)
+      { multiply_batch<3, 3, 1, false>(lhs, rhs, out, n); }
+
+
+      int compiled_simd_level()
+      {
+#if defined(__AVX512F__)
+        return 2;
+#elif defined(__AVX2__) and defined(__FMA__)
+        return 1;
+#else
+        return 0;
+#endif
+      }
+    }
+  }
+}
@@ -0,0 +1,244 @@
+#ifndef TASK_GROUP_HPP
+#define TASK_GROUP_HPP
+
+/* This file provides a work-stealing task scheduler for workloads in which the
+ * cost of each item varies, e.g. Wilson loops of different sizes, eigensolves
+ * on individual timeslices or sparse sets of source sites. Dividing such work
+ * statically between threads (as parallel_for does) leaves some threads idle
+ * while others are still busy.
+ *
+ * A TaskGroup holds one queue of tasks per thread of the library's thread
+ * pool (see thread_pool.hpp). Tasks are added with spawn(), then wait() runs
+ * them on the pool. Each thread takes tasks from the back of its own queue,
+ * and when that's empty it steals from the front of another thread's queue.
+ * Tasks may spawn further tasks into the same group, which are added to the
+ * queue of the thread running them, so recursive divide-and-conquer work is
+ * also balanced.
+ *
+ * parallel_for_dynamic is the equivalent of parallel_for for irregular loops.
+ * The range is divided into chunks of grain indices, and each thread's queue
+ * starts with a contiguous run of chunks, so uniform loops behave much like a
+ * static partition.
+ *
+ * The queues are protected by mutexes. Tasks should therefore be much more
+ * expensive than a lock, which the grain size allows callers to arrange.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+
+namespace pyQCD
+{
+  class TaskGroup
+  {
+  public:
+    typedef std::function<void()> task_type;
+
+    TaskGroup();
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    // Add a task to the group. Tasks spawned from outside wait() are dealt
+    // out to the queues in turn, so should only be spawned from one thread.
+    void spawn(task_type task);
+    // Add a task to the queue of the specified thread
+    void spawn(const unsigned int thread, task_type task);
+    // Run the tasks of the group, including any they spawn, and wait for them
+    // to finish. Any exception thrown by a task is rethrown here, after the
+    // remaining tasks have been discarded.
+    void wait();
+
+    unsigned int num_queues() const { return queues_.size(); }
+
+  private:
+    struct Queue
+    {
+      std::mutex mutex;
+      std::deque<task_type> tasks;
+    };
+
+    bool pop(const unsigned int queue, task_type& task);
+    bool steal(const unsigned int thief, task_type& task);
+    void work(const unsigned int thread);
+
+    // The group and queue of the task running on the current thread, so that
+    // tasks spawned from within tasks go to the right queue
+    static TaskGroup*& current_group()
+    {
+      static thread_local TaskGroup* ret = nullptr;
+      return ret;
+    }
+    static unsigned int& current_queue()
+    {
+      static thread_local unsigned int ret = 0;
+      return ret;
+    }
+
+    std::vector<std::unique_ptr<Queue> > queues_;
+    unsigned int next_queue_;
+    // Tasks that have been spawned but haven't finished
+    std::atomic<unsigned long> pending_;
+    std::atomic<bool> failed_;
+    std::exception_ptr error_;
+    std::mutex error_mutex_;
+  };
+
+
+  inline TaskGroup::TaskGroup()
+    : next_queue_(0), pending_(0), failed_(false)
+  {
+    for (unsigned int i = 0; i < num_threads(); ++i) {
+      queues_.emplace_back(new Queue);
+    }
+  }
+
+
+  inline void TaskGroup::spawn(task_type task)
+  {
+    if (current_group() == this) {
+      spawn(current_queue(), std::move(task));
+    }
+    else {
+      spawn(next_queue_, std::move(task));
+      next_queue_ = (next_queue_ + 1) % queues_.size();
+    }
+  }
+
+
+  inline void TaskGroup::spawn(const unsigned int thread, task_type task)
+  {
+    Queue& queue = *queues_[thread % queues_.size()];
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+
+
+  inline bool TaskGroup::pop(const unsigned int queue, task_type& task)
+  {
+    // The owner takes the most recently added task, which for recursive work
+    // is the smallest and most likely to be in cache
+    Queue& q = *queues_[queue];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tasks.empty()) {
+      return false;
+    }
+    task = std::move(q.tasks.back());
+    q.tasks.pop_back();
+    return true;
+  }
+
+
+  inline bool TaskGroup::steal(const unsigned int thief, task_type& task)
+  {
+    // Thieves take the oldest task, which for recursive work is the largest
+    const unsigned int num_queues = queues_.size();
+    for (unsigned int i = 1; i < num_queues; ++i) {
+      Queue& q = *queues_[(thief + i) % num_queues];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      if (not q.tasks.empty()) {
+        task = std::move(q.tasks.front());
+        q.tasks.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+
+  inline void TaskGroup::work(const unsigned int queue)
+  {
+    TaskGroup* const outer_group = current_group();
+    const unsigned int outer_queue = current_queue();
+    current_group() = this;
+    current_queue() = queue;
+
+    task_type task;
+    while (pending_.load(std::memory_order_acquire) > 0) {
+      if (not pop(queue, task) and not steal(queue, task)) {
+        // The remaining tasks are running on other threads, and may yet
+        // spawn more
+        std::this_thread::yield();
+        continue;
+      }
+      if (not failed_.load(std::memory_order_relaxed)) {
+        try {
+          task();
+        }
+        catch (...) {
+          std::lock_guard<std::mutex> lock(error_mutex_);
+          if (not error_) {
+            error_ = std::current_exception();
+          }
+          failed_ = true;
+        }
+      }
+      task = nullptr;
+      pending_.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    current_group() = outer_group;
+    current_queue() = outer_queue;
+  }
+
+
+  inline void TaskGroup::wait()
+  {
+    // When the group is waited on from within a loop on the pool, the calling
+    // thread runs all the tasks, stealing from every queue
+    run_on_thread_pool(
+      [this] (const unsigned int thread, const unsigned int num_threads) {
+        work(thread);
+      }, queues_.size());
+
+    failed_ = false;
+    if (error_) {
+      std::exception_ptr error = error_;
+      error_ = nullptr;
+      std::rethrow_exception(error);
+    }
+  }
+
+
+  template <typename Fn>
+  void parallel_for_dynamic(const unsigned long begin, const unsigned long end,
+                            Fn fn, const unsigned long grain = 1)
+  {
+    // Call fn(i) for each index in [begin, end), balancing the load between
+    // threads by work stealing. Indices are handled in chunks of grain.
+    if (begin >= end) {
+      return;
+    }
+    const unsigned long chunk_size = std::max(grain, 1ul);
+    const unsigned long num_chunks
+      = (end - begin + chunk_size - 1) / chunk_size;
+
+    TaskGroup group;
+    const unsigned int num_queues = group.num_queues();
+    // Queue t holds the t-th contiguous run of chunks. The owner of a queue
+    // takes chunks from the back, so the chunks are added in reverse order for
+    // them to be processed in ascending order.
+    for (unsigned long chunk = num_chunks; chunk-- > 0;) {
+      const unsigned long chunk_begin = begin + chunk * chunk_size;
+      const unsigned long chunk_end = std::min(end, chunk_begin + chunk_size);
+      group.spawn(chunk * num_queues / num_chunks, [=, &fn] () {
+        for (unsigned long i = chunk_begin; i < chunk_end; ++i) {
+          fn(i);
+        }
+      });
+    }
+    group.wait();
+  }
+}
+
+#endif
@@ -10,6 +10,22 @@
 namespace pyQCD
 {
   class EmptyType { };
+
+
+  // Provides the additive identity of a type. Eigen matrices are left
+  // uninitialised by their default constructor, so Zero() is used for these.
+  template <typename T, typename Enable = void>
+  struct ZeroTraits
+  {
+    static T zero() { return T(0); }
+  };
+
+
+  template <typename T>
+  struct ZeroTraits<T, decltype(T::Zero(), void())>
+  {
+    static T zero() { return T::Zero(); }
+  };
 }
 
 #endif
@@ -0,0 +1,354 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+/* This file provides the ThreadPool class and the single pool that the
+ * library's parallel loops (see parallel.hpp) run on.
+ *
+ * The pool's worker threads are created once and then wait for work, so
+ * starting a parallel loop costs a wake-up rather than a thread creation.
+ * Workers spin briefly before sleeping, so back-to-back loops (e.g. the
+ * iterations of a solver) don't pay for a sleep and a wake-up each time.
+ *
+ * ThreadPool::run(fn) calls fn(thread) once on each thread of the pool, with
+ * thread 0 being the calling thread. Thread t is always the same worker, so a
+ * loop that gives the same range of sites to the same thread index each time
+ * accesses memory from the same core each time. Workers can optionally be
+ * pinned to cores, so that this is also true of the physical core. Worker t
+ * is pinned to the t-th CPU (modulo their number) of the affinity mask the
+ * process was started with, so restrictions such as taskset or a container's
+ * cpuset are respected. The calling thread isn't pinned. If any worker can't
+ * be pinned, pinned() returns false.
+ *
+ * The library-wide pool is created on first use. By default it has one thread
+ * per core and isn't pinned. This can be changed with the environment
+ * variables PYQCD_NUM_THREADS and PYQCD_PIN_THREADS (set to 1 to pin), or at
+ * run time using set_num_threads. Loops started from several threads at once
+ * take turns on the pool. Loops started from within a loop on the pool run on
+ * the thread that starts them.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "macros.hpp"
+
+
+namespace pyQCD
+{
+  class ThreadPool
+  {
+  public:
+    explicit ThreadPool(const unsigned int num_threads, const bool pin = false);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    // Call fn(thread) for thread = 0, ..., num_threads() - 1, one call per
+    // thread, and wait for them to finish. Any exception thrown by fn is
+    // rethrown here. Only one thread may call run at a time.
+    template <typename Fn>
+    void run(Fn& fn);
+
+    unsigned int num_threads() const { return workers_.size() + 1; }
+    // Whether the workers were pinned to cores successfully
+    bool pinned() const { return pinned_; }
+
+    // Whether the current thread is running a call made by run()
+    static bool& in_parallel_region()
+    {
+      static thread_local bool ret = false;
+      return ret;
+    }
+
+  private:
+    template <typename Fn>
+    static void call(void* fn, const unsigned int thread)
+    { (*static_cast<Fn*>(fn))(thread); }
+
+    void execute(const unsigned int thread);
+    void worker_loop(const unsigned int thread);
+
+    // Number of polls of the generation counter before a worker sleeps
+    static constexpr unsigned int spin_count = 4096;
+
+    std::vector<std::thread> workers_;
+    bool pinned_;
+
+    // The task is a type-erased pointer to the callable passed to run(). Each
+    // call of run() increments the generation, which starts the workers.
+    void (*task_)(void*, unsigned int);
+    void* task_fn_;
+    std::atomic<unsigned long> generation_;
+    std::atomic<unsigned int> remaining_;
+    bool stop_;
+
+    std::mutex mutex_;
+    std::condition_variable start_cv_, done_cv_;
+    std::exception_ptr error_;
+    std::mutex error_mutex_;
+  };
+
+
+  inline ThreadPool::ThreadPool(const unsigned int num_threads,
+                                const bool pin)
+    : pinned_(pin), task_(nullptr), task_fn_(nullptr), generation_(0),
+      remaining_(0), stop_(false)
+  {
+#ifdef __linux__
+    // The CPUs this process may run on, which the workers are pinned to
+    std::vector<int> cpus;
+    if (pin) {
+      cpu_set_t allowed;
+      CPU_ZERO(&allowed);
+      if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+          if (CPU_ISSET(cpu, &allowed)) {
+            cpus.push_back(cpu);
+          }
+        }
+      }
+      pinned_ = not cpus.empty();
+    }
+#else
+    pinned_ = false;
+#endif
+    for (unsigned int thread = 1; thread < std::max(num_threads, 1u);
+         ++thread) {
+      workers_.emplace_back(&ThreadPool::worker_loop, this, thread);
+#ifdef __linux__
+      if (pinned_) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpus[thread % cpus.size()], &cpu_set);
+        pinned_ = pthread_setaffinity_np(workers_.back().native_handle(),
+                                         sizeof(cpu_set_t), &cpu_set) == 0;
+      }
+#endif
+    }
+  }
+
+
+  inline ThreadPool::~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+      generation_.fetch_add(1, std::memory_order_release);
+    }
+    start_cv_.notify_all();
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+
+  template <typename Fn>
+  void ThreadPool::run(Fn& fn)
+  {
+    task_ = &ThreadPool::call<Fn>;
+    task_fn_ = static_cast<void*>(&fn);
+    error_ = nullptr;
+    remaining_.store(workers_.size(), std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      generation_.fetch_add(1, std::memory_order_release);
+    }
+    start_cv_.notify_all();
+
+    execute(0);
+
+    for (unsigned int i = 0; i < spin_count; ++i) {
+      if (remaining_.load(std::memory_order_acquire) == 0) {
+        break;
+      }
+      std::this_thread::yield();
+    }
+    if (remaining_.load(std::memory_order_acquire) != 0) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      done_cv_.wait(lock, [this] () {
+        return remaining_.load(std::memory_order_acquire) == 0;
+      });
+    }
+
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+  }
+
+
+  inline void ThreadPool::execute(const unsigned int thread)
+  {
+    in_parallel_region() = true;
+    try {
+      task_(task_fn_, thread);
+    }
+    catch (...) {
+      std::lock_guard<std::mutex> lock(error_mutex_);
+      if (not error_) {
+        error_ = std::current_exception();
+      }
+    }
+    in_parallel_region() = false;
+  }
+
+
+  inline void ThreadPool::worker_loop(const unsigned int thread)
+  {
+    unsigned long generation = 0;
+    while (true) {
+      for (unsigned int i = 0; i < spin_count; ++i) {
+        if (generation_.load(std::memory_order_acquire) != generation) {
+          break;
+        }
+        std::this_thread::yield();
+      }
+      if (generation_.load(std::memory_order_acquire) == generation) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_cv_.wait(lock, [&] () {
+          return generation_.load(std::memory_order_acquire) != generation;
+        });
+      }
+      generation = generation_.load(std::memory_order_acquire);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_) {
+          return;
+        }
+      }
+
+      execute(thread);
+      if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_cv_.notify_one();
+      }
+    }
+  }
+
+
+  namespace detail
+  {
+    struct ThreadPoolState
+    {
+      ThreadPoolState() : num_threads(0) { }
+
+      // The library-wide pool, and a mutex that's held while the pool is
+      // running a loop or being replaced
+      std::mutex mutex;
+      std::unique_ptr<ThreadPool> pool;
+      // The size of the pool, which can be read without taking the mutex,
+      // or zero if the pool hasn't been created yet
+      std::atomic<unsigned int> num_threads;
+    };
+
+
+    inline ThreadPoolState& thread_pool_state()
+    {
+      static ThreadPoolState ret;
+      return ret;
+    }
+
+
+    inline unsigned int default_num_threads()
+    {
+      const char* value = std::getenv("PYQCD_NUM_THREADS");
+      const int num_threads = value ? std::atoi(value) : 0;
+      if (num_threads > 0) {
+        return num_threads;
+      }
+      return std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+
+    inline bool default_pin_threads()
+    {
+      const char* value = std::getenv("PYQCD_PIN_THREADS");
+      return value and std::atoi(value) != 0;
+    }
+
+
+    // Must be called with the state's mutex held
+    inline ThreadPool& thread_pool(ThreadPoolState& state)
+    {
+      if (not state.pool) {
+        state.pool.reset(
+          new ThreadPool(default_num_threads(), default_pin_threads()));
+        state.num_threads = state.pool->num_threads();
+      }
+      return *state.pool;
+    }
+  }
+
+
+  template <typename Fn>
+  void run_on_thread_pool(Fn fn, const unsigned int max_threads)
+  {
+    // Call fn(thread, n) for thread = 0, ..., n - 1 on the library-wide pool,
+    // where n is the smaller of max_threads and the size of the pool. If this
+    // is called from within the pool then n = 1 and the call is made on the
+    // calling thread.
+    if (ThreadPool::in_parallel_region() or max_threads < 2) {
+      fn(0u, 1u);
+      return;
+    }
+    auto& state = detail::thread_pool_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    ThreadPool& pool = detail::thread_pool(state);
+    const unsigned int num_threads = std::min(max_threads, pool.num_threads());
+    if (num_threads < 2) {
+      fn(0u, 1u);
+      return;
+    }
+    auto bounded_fn = [&] (const unsigned int thread) {
+      if (thread < num_threads) {
+        fn(thread, num_threads);
+      }
+    };
+    pool.run(bounded_fn);
+  }
+
+
+  inline unsigned int num_threads()
+  {
+    // The pool is always created before a loop runs on it, so this doesn't
+    // block when called from within a loop
+    auto& state = detail::thread_pool_state();
+    const unsigned int ret = state.num_threads.load();
+    if (ret > 0) {
+      return ret;
+    }
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return detail::thread_pool(state).num_threads();
+  }
+
+
+  inline void set_num_threads(const unsigned int num_threads,
+                              const bool pin = false)
+  {
+    // Replace the library-wide pool with one with the specified number of
+    // threads (including the calling thread), waiting for any loop running on
+    // the current pool to finish. Must not be called from within a loop.
+    pyQCDassert ((not ThreadPool::in_parallel_region()),
+      std::logic_error("set_num_threads: called from within a parallel loop"));
+    auto& state = detail::thread_pool_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.pool.reset();
+    state.pool.reset(new ThreadPool(num_threads, pin));
+    state.num_threads = state.pool->num_threads();
+  }
+}
+
+#endif
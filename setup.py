@@ -1,4 +1,5 @@
 from itertools import product
+import os
 import sys
 
 from Cython.Build import cythonize
@@ -8,7 +9,8 @@ from setuptools import Extension, setup, find_packages
 from pyQCD.utils.codegen import CodeGen
 
 data_dirs = ["pyQCD", "pyQCD/templates"]
-include_subdirs = ["core",
+include_subdirs = ["algorithms",
+                   "core",
                    "core/detail",
                    "fermion_actions",
                    "gauge_actions",
@@ -25,9 +27,18 @@ with open("README.md") as f:
     long_description = f.read()
 
 
+# The small-matrix kernels written to pyQCD/core by codegen are used by every
+# translation unit (see pyQCD/core/detail/matrix_kernels.hpp). Kernel
+# instrumentation (see pyQCD/utils/profiling.hpp) is compiled in when
+# PYQCD_ENABLE_PROFILING is set in the environment.
+define_macros = [("PYQCD_GENERATED_KERNELS", None)]
+if os.environ.get("PYQCD_ENABLE_PROFILING"):
+    define_macros.append(("PYQCD_ENABLE_PROFILING", None))
+
 extensions = [Extension("pyQCD.core.core", ["pyQCD/core/core.pyx"],
                         language="c++",
                         include_dirs=["./pyQCD", "/usr/include/eigen3"],
+                        define_macros=define_macros,
                         extra_compile_args=["-std=c++11"])]
 
 # Do not rebuild on change of extension module in the case where we're